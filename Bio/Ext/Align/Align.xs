@@ -12,6 +12,120 @@ extern "C" {
 #include "sw.h"
 #include "dpalign.h"
 
+/*
+  sv_encoded returns the sequence sv if it is a
+  Bio::Ext::Align::EncodedSequence of type, or else the string sv
+  encoded as one in a mortal buffer, gone with the call.
+ */
+static dpAlign_EncodedSequence *
+sv_encoded(SV * sv, int type)
+{
+    dpAlign_EncodedSequence * e;
+    char * seq;
+    int len;
+    SV * buf;
+
+    if (sv_isobject(sv) && sv_derived_from(sv, "Bio::Ext::Align::EncodedSequence")) {
+        e = (dpAlign_EncodedSequence *) SvIV((SV *) SvRV(sv));
+        if (e->type != type)
+            croak("Sequence is not encoded as %s", type == DPALIGN_DNA ? "DNA" : "protein");
+        return e;
+    }
+    if (!SvOK(sv))
+        croak("Sequence is undefined");
+    seq = SvPV_nolen(sv);
+    len = strlen(seq);
+    buf = sv_2mortal(newSV(DPALIGN_ENCODED_SIZE(len)));
+    return dpAlign_Encode_Sequence(SvPVX(buf), seq, len, type);
+}
+
+/*
+  pairs_encoded checks that pairs is a list of [seq1, seq2] pairs of
+  sequences that aren't empty and puts the sequences, encoded by
+  sv_encoded, in mortal arrays *s1 and *s2. It returns the number of
+  pairs.
+ */
+static int
+pairs_encoded(AV * pairs, int type, dpAlign_EncodedSequence *** s1, dpAlign_EncodedSequence *** s2)
+{
+    int i, n;
+    SV ** svp, ** e1, ** e2;
+    AV * pair;
+
+    n = av_len(pairs) + 1;
+    *s1 = (dpAlign_EncodedSequence **) SvPVX(sv_2mortal(newSV((n+1)*sizeof(dpAlign_EncodedSequence *))));
+    *s2 = (dpAlign_EncodedSequence **) SvPVX(sv_2mortal(newSV((n+1)*sizeof(dpAlign_EncodedSequence *))));
+    for (i = 0; i < n; ++i) {
+        svp = av_fetch(pairs, i, 0);
+        if (svp == NULL || !SvROK(*svp) || SvTYPE(SvRV(*svp)) != SVt_PVAV)
+            croak("Pair %d of the batch is not an array reference", i);
+        pair = (AV *) SvRV(*svp);
+        e1 = av_fetch(pair, 0, 0);
+        e2 = av_fetch(pair, 1, 0);
+        if (e1 == NULL || e2 == NULL || !SvOK(*e1) || !SvOK(*e2))
+            croak("Pair %d of the batch has an undefined sequence", i);
+        (*s1)[i] = sv_encoded(*e1, type);
+        (*s2)[i] = sv_encoded(*e2, type);
+        if ((*s1)[i]->len == 0 || (*s2)[i]->len == 0)
+            croak("Pair %d of the batch has an empty sequence", i);
+    }
+    return n;
+}
+
+/*
+  pairs_results returns a hash of the n alignments out as parallel
+  arrays, one per field of an AlignOutput, and frees them. aln1 and
+  aln2, or cigar, are only there if output asked for them.
+ */
+static SV *
+pairs_results(dpAlign_AlignOutput ** out, int n, int output)
+{
+    static const char * names[] = { "score", "start1", "end1", "start2", "end2",
+                                    "matches", "mismatches", "gap_opens", "gap_exts" };
+    AV * av[9], * aln1 = NULL, * aln2 = NULL, * cigar = NULL;
+    HV * hv = newHV();
+    dpAlign_AlignOutput * o;
+    int i, k;
+
+    if (output == 0)
+        output = DPALIGN_OUTPUT_ALN;
+    for (k = 0; k < 9; ++k) {
+        av[k] = newAV();
+        av_extend(av[k], n);
+        hv_store(hv, names[k], strlen(names[k]), newRV_noinc((SV *) av[k]), 0);
+    }
+    if (output & DPALIGN_OUTPUT_ALN) {
+        aln1 = newAV();
+        aln2 = newAV();
+        hv_store(hv, "aln1", 4, newRV_noinc((SV *) aln1), 0);
+        hv_store(hv, "aln2", 4, newRV_noinc((SV *) aln2), 0);
+    }
+    if (output & DPALIGN_OUTPUT_CIGAR) {
+        cigar = newAV();
+        hv_store(hv, "cigar", 5, newRV_noinc((SV *) cigar), 0);
+    }
+    for (i = 0; i < n; ++i) {
+        o = out[i];
+        av_push(av[0], newSViv(o->score));
+        av_push(av[1], newSViv(o->start1));
+        av_push(av[2], newSViv(o->end1));
+        av_push(av[3], newSViv(o->start2));
+        av_push(av[4], newSViv(o->end2));
+        av_push(av[5], newSViv(o->matches));
+        av_push(av[6], newSViv(o->mismatches));
+        av_push(av[7], newSViv(o->gap_opens));
+        av_push(av[8], newSViv(o->gap_exts));
+        if (aln1 != NULL) {
+            av_push(aln1, o->aln1 != NULL ? newSVpv(o->aln1, 0) : newSV(0));
+            av_push(aln2, o->aln2 != NULL ? newSVpv(o->aln2, 0) : newSV(0));
+        }
+        if (cigar != NULL)
+            av_push(cigar, o->cigar != NULL ? newSVpv(o->cigar, 0) : newSV(0));
+        free_dpAlign_AlignOutput(o);
+    }
+    return newRV_noinc((SV *) hv);
+}
+
 static int
 not_here(s)
 char *s;
@@ -1330,6 +1444,24 @@ DESTROY(obj)
 
 MODULE = Bio::Ext::Align PACKAGE = Bio::Ext::Align
 
+bp_sw_ComplexSequence *
+new_ComplexSequence(seq,cses)
+	bp_sw_Sequence * seq
+	bp_sw_ComplexSequenceEvalSet * cses
+	CODE:
+	RETVAL = bp_sw_new_ComplexSequence(seq,cses);
+	OUTPUT:
+	RETVAL
+
+
+
+bp_sw_ComplexSequenceEvalSet *
+default_aminoacid_ComplexSequenceEvalSet()
+	CODE:
+	RETVAL = bp_sw_default_aminoacid_ComplexSequenceEvalSet();
+	OUTPUT:
+	RETVAL
+
 
 
 MODULE = Bio::Ext::Align PACKAGE = Bio::Ext::Align::CompMat
@@ -1724,6 +1856,17 @@ Hscore_alloc_std()
 
 
 
+bp_sw_Hscore *
+level_score_Hscore(cut_off,report_stagger)
+	int cut_off
+	int report_stagger
+	CODE:
+	RETVAL = bp_sw_level_score_Hscore(cut_off,report_stagger);
+	OUTPUT:
+	RETVAL
+
+
+
 
 bp_sw_Hscore *
 new(class)
@@ -2561,6 +2704,163 @@ new_ProteinDB(seqdb,cses)
 
 
 
+bp_sw_ProteinDB *
+load_ProteinDB(prodb)
+	bp_sw_ProteinDB * prodb
+	CODE:
+	RETVAL = bp_sw_load_ProteinDB(prodb);
+	OUTPUT:
+	RETVAL
+
+
+
+
+
+MODULE = Bio::Ext::Align PACKAGE = Bio::Ext::Align
+
+int
+search_ProteinSW(out,querydb,targetdb,comp,gap,ext)
+	bp_sw_Hscore * out
+	bp_sw_ProteinDB * querydb
+	bp_sw_ProteinDB * targetdb
+	bp_sw_CompMat * comp
+	int gap
+	int ext
+	CODE:
+	RETVAL = bp_sw_search_ProteinSW(out,querydb,targetdb,comp,gap,ext);
+	OUTPUT:
+	RETVAL
+
+
+
+int
+batch_search_ProteinSW(out,querydb,targetdb,comp,gap,ext,batch)
+	bp_sw_Hscore * out
+	bp_sw_ProteinDB * querydb
+	bp_sw_ProteinDB * targetdb
+	bp_sw_CompMat * comp
+	int gap
+	int ext
+	int batch
+	CODE:
+	RETVAL = bp_sw_batch_search_ProteinSW(out,querydb,targetdb,comp,gap,ext,batch);
+	OUTPUT:
+	RETVAL
+
+
+
+int
+thread_search_ProteinSW(out,querydb,targetdb,comp,gap,ext,number)
+	bp_sw_Hscore * out
+	bp_sw_ProteinDB * querydb
+	bp_sw_ProteinDB * targetdb
+	bp_sw_CompMat * comp
+	int gap
+	int ext
+	int number
+	CODE:
+	RETVAL = bp_sw_thread_search_ProteinSW(out,querydb,targetdb,comp,gap,ext,number);
+	OUTPUT:
+	RETVAL
+
+
+
+int
+score_only_ProteinSW(query,target,comp,gap,ext)
+	bp_sw_ComplexSequence * query
+	bp_sw_ComplexSequence * target
+	bp_sw_CompMat * comp
+	int gap
+	int ext
+	CODE:
+	RETVAL = bp_sw_score_only_ProteinSW(query,target,comp,gap,ext);
+	OUTPUT:
+	RETVAL
+
+
+
+int
+score_only_reuse_ProteinSW(mat,query,target,comp,gap,ext,cutoff = 0)
+	bp_sw_ProteinSW * mat
+	bp_sw_ComplexSequence * query
+	bp_sw_ComplexSequence * target
+	bp_sw_CompMat * comp
+	int gap
+	int ext
+	int cutoff
+	CODE:
+	RETVAL = bp_sw_score_only_reuse_ProteinSW(mat,query,target,comp,gap,ext,cutoff);
+	OUTPUT:
+	RETVAL
+
+
+
+bp_sw_ProteinSW_Striped *
+new_ProteinSW_Striped(query,comp,gap,ext)
+	bp_sw_ComplexSequence * query
+	bp_sw_CompMat * comp
+	int gap
+	int ext
+	CODE:
+	RETVAL = bp_sw_new_ProteinSW_Striped(query,comp,gap,ext);
+	OUTPUT:
+	RETVAL
+
+
+
+int
+score_only_striped_ProteinSW(st,mat,target,cutoff = 0)
+	bp_sw_ProteinSW_Striped * st
+	bp_sw_ProteinSW * mat
+	bp_sw_ComplexSequence * target
+	int cutoff
+	CODE:
+	RETVAL = bp_sw_score_only_striped_ProteinSW(st,mat,target,cutoff);
+	OUTPUT:
+	RETVAL
+
+
+
+MODULE = Bio::Ext::Align PACKAGE = Bio::Ext::Align::ProteinSW
+
+bp_sw_ProteinSW *
+alloc()
+	CODE:
+	RETVAL = bp_sw_ProteinSW_alloc();
+	OUTPUT:
+	RETVAL
+
+
+
+
+bp_sw_ProteinSW *
+new(class)
+	char * class
+	PPCODE:
+	bp_sw_ProteinSW * out;
+	out = bp_sw_ProteinSW_alloc();
+	ST(0) = sv_newmortal();
+	sv_setref_pv(ST(0),class,(void*)out);
+	XSRETURN(1);
+
+void
+DESTROY(obj)
+	bp_sw_ProteinSW * obj
+	CODE:
+	bp_sw_free_ProteinSW(obj);
+
+
+
+MODULE = Bio::Ext::Align PACKAGE = Bio::Ext::Align::ProteinSW_Striped
+
+void
+DESTROY(obj)
+	bp_sw_ProteinSW_Striped * obj
+	CODE:
+	bp_sw_free_ProteinSW_Striped(obj);
+
+
+
 
 
 MODULE = Bio::Ext::Align PACKAGE = Bio::Ext::Align
@@ -3318,14 +3618,15 @@ Align_strings_ProteinSmithWaterman(one,two,comp,gap,ext)
 
 
 bp_sw_AlnBlock *
-Align_Sequences_ProteinSmithWaterman(one,two,comp,gap,ext)
+Align_Sequences_ProteinSmithWaterman(one,two,comp,gap,ext,number = 1)
 	bp_sw_Sequence * one
 	bp_sw_Sequence * two
 	bp_sw_CompMat * comp
 	int gap
 	int ext
+	int number
 	CODE:
-	RETVAL = bp_sw_Align_Sequences_ProteinSmithWaterman(one,two,comp,gap,ext);
+	RETVAL = bp_sw_thread_Align_Sequences_ProteinSmithWaterman(one,two,comp,gap,ext,number);
 	OUTPUT:
 	RETVAL
 
@@ -3345,77 +3646,315 @@ Align_Proteins_SmithWaterman(one,two,comp,gap,ext)
 
 MODULE = Bio::Ext::Align PACKAGE = Bio::Ext::Align
 
+void
+set_threads(threads)
+        int threads
+        CODE:
+        dpAlign_set_threads(threads);
+
+int
+get_threads()
+        CODE:
+        RETVAL = dpAlign_get_threads();
+        OUTPUT:
+        RETVAL
+
+void
+set_quadratic_cells(cells)
+        long cells
+        CODE:
+        dpAlign_set_quadratic_cells(cells);
+
+long
+get_quadratic_cells()
+        CODE:
+        RETVAL = dpAlign_get_quadratic_cells();
+        OUTPUT:
+        RETVAL
+
 dpAlign_AlignOutput *
-Align_DNA_Sequences(seq1, seq2, match, mismatch, gap, ext, alg)
-        char * seq1
-        char * seq2
+Align_DNA_Sequences(seq1, seq2, match, mismatch, gap, ext, alg, threads = 0, ws = NULL)
+        SV * seq1
+        SV * seq2
         int match
         int mismatch
         int gap
         int ext
         int alg
+        int threads
+        dpAlign_Workspace * ws
         CODE:
+        dpAlign_EncodedSequence * e1, * e2;
+        e1 = sv_encoded(seq1, DPALIGN_DNA);
+        e2 = sv_encoded(seq2, DPALIGN_DNA);
         switch (alg) {
         case 1:
-            RETVAL = dpAlign_Local_DNA_MillerMyers(seq1, seq2, match, mismatch, gap, ext);
+            RETVAL = dpAlign_Local_DNA_MillerMyers(e1, e2, match, mismatch, gap, ext, threads, ws);
             break;
         case 2:
-            RETVAL = dpAlign_Global_DNA_MillerMyers(seq1, seq2, match, mismatch, gap, ext);
+            RETVAL = dpAlign_Global_DNA_MillerMyers(e1, e2, match, mismatch, gap, ext, threads, ws);
             break;
         case 3:
-            RETVAL = dpAlign_EndsFree_DNA_MillerMyers(seq1, seq2, match, mismatch, gap, ext);
+            RETVAL = dpAlign_EndsFree_DNA_MillerMyers(e1, e2, match, mismatch, gap, ext, threads, ws);
+            break;
+        case 4:
+            RETVAL = dpAlign_Global_DNA_MillerMyers_Banded(e1, e2, match, mismatch, gap, ext, ws);
+            break;
+        case 5:
+            RETVAL = dpAlign_DNA_Myers(e1, e2, DPALIGN_MYERS_GLOBAL, ws);
+            break;
+        case 6:
+            RETVAL = dpAlign_DNA_Myers(e1, e2, DPALIGN_MYERS_SEMIGLOBAL, ws);
+            break;
+        case 7:
+            RETVAL = dpAlign_DNA_Myers(e1, e2, DPALIGN_MYERS_PREFIX, ws);
             break;
         default:
-            RETVAL = dpAlign_Local_DNA_MillerMyers(seq1, seq2, match, mismatch, gap, ext);
+            RETVAL = dpAlign_Local_DNA_MillerMyers(e1, e2, match, mismatch, gap, ext, threads, ws);
             break;
         }
         OUTPUT:
         RETVAL
 
 dpAlign_AlignOutput *
-Align_Protein_Sequences(seq1, seq2, matrix, alg)
-        char * seq1
-        char * seq2
+Align_Protein_Sequences(seq1, seq2, matrix, alg, threads = 0, ws = NULL)
+        SV * seq1
+        SV * seq2
         dpAlign_ScoringMatrix * matrix
 	int alg
+	int threads
+	dpAlign_Workspace * ws
         CODE:
+        dpAlign_EncodedSequence * e1, * e2;
+        e1 = sv_encoded(seq1, DPALIGN_PROTEIN);
+        e2 = sv_encoded(seq2, DPALIGN_PROTEIN);
         switch (alg) {
         case 1:
-            RETVAL = dpAlign_Local_Protein_MillerMyers(seq1, seq2, matrix);
+            RETVAL = dpAlign_Local_Protein_MillerMyers(e1, e2, matrix, threads, ws);
             break;
         case 2:
-            RETVAL = dpAlign_Global_Protein_MillerMyers(seq1, seq2, matrix);
+            RETVAL = dpAlign_Global_Protein_MillerMyers(e1, e2, matrix, threads, ws);
             break;
         case 3:
-            RETVAL = dpAlign_EndsFree_Protein_MillerMyers(seq1, seq2, matrix);
+            RETVAL = dpAlign_EndsFree_Protein_MillerMyers(e1, e2, matrix, threads, ws);
+            break;
+        case 4:
+            RETVAL = dpAlign_Global_Protein_MillerMyers_Banded(e1, e2, matrix, ws);
             break;
         default:
-            RETVAL = dpAlign_Local_Protein_MillerMyers(seq1, seq2, matrix);
+            RETVAL = dpAlign_Local_Protein_MillerMyers(e1, e2, matrix, threads, ws);
             break;
         }
         OUTPUT:
         RETVAL
 
+void
+Align_DNA_Sequences_batch(pairs, match, mismatch, gap, ext, alg, threads = 0, output = 0)
+        AV * pairs
+        int match
+        int mismatch
+        int gap
+        int ext
+        int alg
+        int threads
+        int output
+        PPCODE:
+        dpAlign_EncodedSequence ** s1, ** s2;
+        dpAlign_AlignOutput ** out;
+        int n;
+        if (output < 0 || output > (DPALIGN_OUTPUT_ALN|DPALIGN_OUTPUT_CIGAR))
+            croak("Output must be 1 (gapped strings), 2 (CIGAR) or 3 (both)");
+        n = pairs_encoded(pairs, DPALIGN_DNA, &s1, &s2);
+        out = (dpAlign_AlignOutput **) SvPVX(sv_2mortal(newSV((n+1)*sizeof(dpAlign_AlignOutput *))));
+        dpAlign_DNA_MillerMyers_Batch(s1, s2, n, match, mismatch, gap, ext, alg, threads, output, out);
+        XPUSHs(sv_2mortal(pairs_results(out, n, output)));
+
+void
+Align_Protein_Sequences_batch(pairs, matrix, alg, threads = 0, output = 0)
+        AV * pairs
+        dpAlign_ScoringMatrix * matrix
+        int alg
+        int threads
+        int output
+        PPCODE:
+        dpAlign_EncodedSequence ** s1, ** s2;
+        dpAlign_AlignOutput ** out;
+        int n;
+        if (output < 0 || output > (DPALIGN_OUTPUT_ALN|DPALIGN_OUTPUT_CIGAR))
+            croak("Output must be 1 (gapped strings), 2 (CIGAR) or 3 (both)");
+        n = pairs_encoded(pairs, DPALIGN_PROTEIN, &s1, &s2);
+        out = (dpAlign_AlignOutput **) SvPVX(sv_2mortal(newSV((n+1)*sizeof(dpAlign_AlignOutput *))));
+        dpAlign_Protein_MillerMyers_Batch(s1, s2, n, matrix, alg, threads, output, out);
+        XPUSHs(sv_2mortal(pairs_results(out, n, output)));
+
+dpAlign_Job *
+Submit_DNA_Sequences(seq1, seq2, match, mismatch, gap, ext, alg, output = 0)
+        SV * seq1
+        SV * seq2
+        int match
+        int mismatch
+        int gap
+        int ext
+        int alg
+        int output
+        CODE:
+        dpAlign_EncodedSequence * e1, * e2;
+        if (output < 0 || output > (DPALIGN_OUTPUT_ALN|DPALIGN_OUTPUT_CIGAR))
+            croak("Output must be 1 (gapped strings), 2 (CIGAR) or 3 (both)");
+        e1 = sv_encoded(seq1, DPALIGN_DNA);
+        e2 = sv_encoded(seq2, DPALIGN_DNA);
+        if (e1->len == 0 || e2->len == 0)
+            croak("Can't submit an empty sequence");
+        RETVAL = dpAlign_DNA_MillerMyers_Submit(e1, e2, match, mismatch, gap, ext, alg, output);
+        OUTPUT:
+        RETVAL
+
+dpAlign_Job *
+Submit_Protein_Sequences(seq1, seq2, matrix, alg, output = 0)
+        SV * seq1
+        SV * seq2
+        dpAlign_ScoringMatrix * matrix
+        int alg
+        int output
+        CODE:
+        dpAlign_EncodedSequence * e1, * e2;
+        if (output < 0 || output > (DPALIGN_OUTPUT_ALN|DPALIGN_OUTPUT_CIGAR))
+            croak("Output must be 1 (gapped strings), 2 (CIGAR) or 3 (both)");
+        e1 = sv_encoded(seq1, DPALIGN_PROTEIN);
+        e2 = sv_encoded(seq2, DPALIGN_PROTEIN);
+        if (e1->len == 0 || e2->len == 0)
+            croak("Can't submit an empty sequence");
+        RETVAL = dpAlign_Protein_MillerMyers_Submit(e1, e2, matrix, alg, output);
+        OUTPUT:
+        RETVAL
+
+dpAlign_AlignOutput *
+XDrop_DNA_Sequences(seq1, seq2, pos1, pos2, match, mismatch, gap, ext, xdrop, ws = NULL)
+        SV * seq1
+        SV * seq2
+        int pos1
+        int pos2
+        int match
+        int mismatch
+        int gap
+        int ext
+        int xdrop
+        dpAlign_Workspace * ws
+        CODE:
+        dpAlign_EncodedSequence * e1, * e2;
+        e1 = sv_encoded(seq1, DPALIGN_DNA);
+        e2 = sv_encoded(seq2, DPALIGN_DNA);
+        if (pos1 < 1 || pos1 > e1->len || pos2 < 1 || pos2 > e2->len)
+            croak("Seed %d,%d is outside the sequences", pos1, pos2);
+        if (xdrop < 0)
+            croak("X-drop must not be negative");
+        RETVAL = dpAlign_Local_DNA_XDrop(e1, e2, pos1, pos2, match, mismatch, gap, ext, xdrop, ws);
+        OUTPUT:
+        RETVAL
+
+dpAlign_AlignOutput *
+XDrop_Protein_Sequences(seq1, seq2, pos1, pos2, matrix, xdrop, ws = NULL)
+        SV * seq1
+        SV * seq2
+        int pos1
+        int pos2
+        dpAlign_ScoringMatrix * matrix
+        int xdrop
+        dpAlign_Workspace * ws
+        CODE:
+        dpAlign_EncodedSequence * e1, * e2;
+        e1 = sv_encoded(seq1, DPALIGN_PROTEIN);
+        e2 = sv_encoded(seq2, DPALIGN_PROTEIN);
+        if (pos1 < 1 || pos1 > e1->len || pos2 < 1 || pos2 > e2->len)
+            croak("Seed %d,%d is outside the sequences", pos1, pos2);
+        if (xdrop < 0)
+            croak("X-drop must not be negative");
+        RETVAL = dpAlign_Local_Protein_XDrop(e1, e2, pos1, pos2, matrix, xdrop, ws);
+        OUTPUT:
+        RETVAL
+
 int
-Score_DNA_Sequences(sp, seq2)
+Score_DNA_Sequences(sp, seq2, ws = NULL)
         dpAlign_SequenceProfile * sp
-        char * seq2
+        SV * seq2
+        dpAlign_Workspace * ws
         CODE:
-        RETVAL = dpAlign_Local_DNA_PhilGreen(sp, seq2);
+        dpAlign_EncodedSequence * e2;
+        e2 = sv_encoded(seq2, DPALIGN_DNA);
+        RETVAL = dpAlign_Local_DNA_PhilGreen(sp, e2, ws);
         ST(0) = sv_newmortal();
         sv_setiv(ST(0), (IV)RETVAL);
         XSRETURN(1);
 
 int
-Score_Protein_Sequences(sp, seq2)
+Score_Protein_Sequences(sp, seq2, ws = NULL)
         dpAlign_SequenceProfile * sp
-        char * seq2
+        SV * seq2
+        dpAlign_Workspace * ws
         CODE:
-        RETVAL = dpAlign_Local_Protein_PhilGreen(sp, seq2);
+        dpAlign_EncodedSequence * e2;
+        e2 = sv_encoded(seq2, DPALIGN_PROTEIN);
+        RETVAL = dpAlign_Local_Protein_PhilGreen(sp, e2, ws);
         ST(0) = sv_newmortal();
         sv_setiv(ST(0), (IV)RETVAL);
         XSRETURN(1);
 
+void
+Score_DNA_Sequences_batch(profile, targets)
+        dpAlign_SequenceProfile * profile
+        AV * targets
+        ALIAS:
+        Score_Protein_Sequences_batch = 1
+        PPCODE:
+        int i, n;
+        char ** seqs;
+        int * scores;
+        if (profile->type != (ix == 1 ? DPALIGN_PROTEIN : DPALIGN_DNA))
+            croak("Score_%s_Sequences_batch needs a %s profile", ix == 1 ? "Protein" : "DNA", ix == 1 ? "protein" : "DNA");
+        n = av_len(targets) + 1;
+        seqs = (char **) SvPVX(sv_2mortal(newSV((n+1)*sizeof(char *))));
+        scores = (int *) SvPVX(sv_2mortal(newSV((n+1)*sizeof(int))));
+        for (i = 0; i < n; ++i) {
+            SV ** svp = av_fetch(targets, i, 0);
+            if (svp == NULL || !SvOK(*svp))
+                croak("Sequence %d of the batch is undefined", i);
+            if (sv_isobject(*svp) && sv_derived_from(*svp, "Bio::Ext::Align::EncodedSequence"))
+                seqs[i] = ((dpAlign_EncodedSequence *) SvIV((SV *) SvRV(*svp)))->seq;
+            else
+                seqs[i] = SvPV_nolen(*svp);
+        }
+        if (ix == 1)
+            dpAlign_Local_Protein_PhilGreen_Batch(profile, seqs, n, scores);
+        else
+            dpAlign_Local_DNA_PhilGreen_Batch(profile, seqs, n, scores);
+        EXTEND(SP, n);
+        for (i = 0; i < n; ++i)
+            PUSHs(sv_2mortal(newSViv(scores[i])));
+
+void
+Scan_Fasta(profile, path, k, threads = 0)
+        dpAlign_SequenceProfile * profile
+        char * path
+        int k
+        int threads
+        PPCODE:
+        int i, n;
+        dpAlign_ScanHit * hits;
+        AV * hit;
+        if (k < 1)
+            croak("Number of hits to keep must be positive");
+        n = dpAlign_Scan_Fasta(profile, path, k, threads, &hits);
+        if (n < 0)
+            croak("Can't open FASTA file %s", path);
+        EXTEND(SP, n);
+        for (i = 0; i < n; ++i) {
+            hit = newAV();
+            av_push(hit, newSVpv(hits[i].name, 0));
+            av_push(hit, newSViv(hits[i].score));
+            PUSHs(sv_2mortal(newRV_noinc((SV *) hit)));
+        }
+        free_dpAlign_ScanHits(hits, n);
+
 MODULE = Bio::Ext::Align PACKAGE = Bio::Ext::Align::ScoringMatrix
 
 dpAlign_ScoringMatrix *
@@ -3446,11 +3985,7 @@ void
 DESTROY(obj)
         dpAlign_ScoringMatrix * obj
         PPCODE:
-        int i;
-        for (i = 0; i < obj->sz; ++i)
-            free(obj->s[i]);
-        free(obj->s);
-        free(obj);
+        free_dpAlign_ScoringMatrix(obj);
 
 MODULE = Bio::Ext::Align PACKAGE = Bio::Ext::Align::SequenceProfile
 
@@ -3481,6 +4016,27 @@ protein_new(class, seq1, matrix)
         sv_setref_pv(ST(0), class, (void *) out);
         XSRETURN(1);
 
+dpAlign_SequenceProfile *
+load(class, path)
+        char * class
+        char * path
+        PPCODE:
+        dpAlign_SequenceProfile * out;
+        out = dpAlign_Load_Profile(path);
+        if (out == NULL)
+            croak("Can't load sequence profile from %s", path);
+        ST(0) = sv_newmortal();
+        sv_setref_pv(ST(0), class, (void *) out);
+        XSRETURN(1);
+
+void
+save(obj, path)
+        dpAlign_SequenceProfile * obj
+        char * path
+        CODE:
+        if (dpAlign_Save_Profile(obj, path) != 0)
+            croak("Can't save sequence profile to %s", path);
+
 char *
 alphabet(obj)
         dpAlign_SequenceProfile * obj
@@ -3505,8 +4061,118 @@ void
 DESTROY(obj)
         dpAlign_SequenceProfile * obj
         CODE:
-        free(obj->waa);
-        free(obj);
+        free_dpAlign_SequenceProfile(obj);
+
+MODULE = Bio::Ext::Align PACKAGE = Bio::Ext::Align::Workspace
+
+dpAlign_Workspace *
+new(class)
+        char * class
+        PPCODE:
+        dpAlign_Workspace * out;
+        out = new_dpAlign_Workspace();
+        ST(0) = sv_newmortal();
+        sv_setref_pv(ST(0), class, (void *) out);
+        XSRETURN(1);
+
+void
+set_output(obj, output)
+        dpAlign_Workspace * obj
+        int output
+        CODE:
+        if (output < 1 || output > (DPALIGN_OUTPUT_ALN|DPALIGN_OUTPUT_CIGAR))
+            croak("Output must be 1 (gapped strings), 2 (CIGAR) or 3 (both)");
+        obj->output = output;
+
+void
+DESTROY(obj)
+        dpAlign_Workspace * obj
+        CODE:
+        free_dpAlign_Workspace(obj);
+
+MODULE = Bio::Ext::Align PACKAGE = Bio::Ext::Align::EncodedSequence
+
+dpAlign_EncodedSequence *
+dna_new(class, seq)
+        char * class
+        char * seq
+        ALIAS:
+        protein_new = 1
+        PPCODE:
+        dpAlign_EncodedSequence * out;
+        out = new_dpAlign_EncodedSequence(seq, ix == 1 ? DPALIGN_PROTEIN : DPALIGN_DNA);
+        ST(0) = sv_newmortal();
+        sv_setref_pv(ST(0), class, (void *) out);
+        XSRETURN(1);
+
+char *
+seq(obj)
+        dpAlign_EncodedSequence * obj
+        CODE:
+        RETVAL = obj->seq;
+        OUTPUT:
+        RETVAL
+
+int
+length(obj)
+        dpAlign_EncodedSequence * obj
+        CODE:
+        RETVAL = obj->len;
+        OUTPUT:
+        RETVAL
+
+char *
+alphabet(obj)
+        dpAlign_EncodedSequence * obj
+        CODE:
+        RETVAL = obj->type == DPALIGN_DNA ? "dna" : "protein";
+        OUTPUT:
+        RETVAL
+
+void
+DESTROY(obj)
+        dpAlign_EncodedSequence * obj
+        CODE:
+        free_dpAlign_EncodedSequence(obj);
+
+MODULE = Bio::Ext::Align PACKAGE = Bio::Ext::Align::Job
+
+int
+ready(obj)
+        dpAlign_Job * obj
+        CODE:
+        RETVAL = dpAlign_Job_Ready(obj);
+        OUTPUT:
+        RETVAL
+
+void
+wait(obj)
+        dpAlign_Job * obj
+        CODE:
+        dpAlign_Job_Wait(obj);
+
+dpAlign_AlignOutput *
+result(obj)
+        dpAlign_Job * obj
+        CODE:
+        RETVAL = dpAlign_Job_Result(obj);
+        if (RETVAL == NULL)
+            croak("Result of the job has been taken already");
+        OUTPUT:
+        RETVAL
+
+int
+fd(...)
+        CODE:
+        RETVAL = dpAlign_Job_Fd();
+        OUTPUT:
+        RETVAL
+
+void
+DESTROY(obj)
+        dpAlign_Job * obj
+        CODE:
+        free_dpAlign_Job(obj);
 
 MODULE = Bio::Ext::Align PACKAGE = Bio::Ext::Align::AlignOutput
 
@@ -3566,11 +4232,49 @@ score(obj)
         OUTPUT:
         RETVAL
 
+char *
+cigar(obj)
+        dpAlign_AlignOutput * obj
+        CODE:
+        RETVAL = obj->cigar;
+        OUTPUT:
+        RETVAL
+
+int
+matches(obj)
+        dpAlign_AlignOutput * obj
+        CODE:
+        RETVAL = obj->matches;
+        OUTPUT:
+        RETVAL
+
+int
+mismatches(obj)
+        dpAlign_AlignOutput * obj
+        CODE:
+        RETVAL = obj->mismatches;
+        OUTPUT:
+        RETVAL
+
+int
+gap_opens(obj)
+        dpAlign_AlignOutput * obj
+        CODE:
+        RETVAL = obj->gap_opens;
+        OUTPUT:
+        RETVAL
+
+int
+gap_exts(obj)
+        dpAlign_AlignOutput * obj
+        CODE:
+        RETVAL = obj->gap_exts;
+        OUTPUT:
+        RETVAL
+
 void
 DESTROY(obj)
         dpAlign_AlignOutput * obj
         CODE:
-        free(obj->aln1);
-        free(obj->aln2);
-        free(obj);
+        free_dpAlign_AlignOutput(obj);
 
@@ -45,66 +45,61 @@ dpAlign_fatal(char * s)
 }
 
 /*
-  align is an implementation of Miller-Myers' dynamic programming alignment
-  algorithm using the gap array to represent the alignment result.
-  There are two gap arrays, one for each sequence. Each of them consists of
-  M+1 and N+1 cells where M is the length of sequence A and N is the length
-  of sequence B. In general, spc1[i] will contain an integer that indicates
-  how many gaps need to be inserted between A[i-1] and A[i]. For example, 
-  spc1[1] will represent the number of gaps inserted between residues A[0] 
-  and A[1]. s is the scoring matrix. g is the gap opening cost. e is the
-  gap extension cost. F is the forward Gotoh array. R is the backward
-  Gotoh array. Note that spc1 and spc2 gap arrays should be initilized to
-  all zeros when you first call this function.
-  align returns the score of the resulting alignment. At the end, the gap
-  arrays spc1 and spc2 will also be set to the proper values.
- */ 
-int
-align(unsigned char * A, unsigned char * B, int M, int N, int ** s, int g, int h, struct swstr * F, struct swstr * R, int * spc1, int * spc2)
+  align_base handles the problems align doesn't divide any further: one
+  of the sequences is empty, or A has a single residue.
+ */
+static int
+align_base(unsigned char * A, unsigned char * B, int M, int N, int ** s, int g, int h, int * spc1, int * spc2)
 {
-    int midi, midj, type;
-    int midc;
-    register struct swstr * swp;
-    register int i, j;
-    register int from, P, t;
-    int c; /* score of a cell */
-    int d; /* down value in Q array */
-    int * ss; 
+    int midc, midj, c, j;
+    int * ss;
     int m = g + h;
 
-/* if the mstrix to divide and conquer has size <= 1 */
     if (N <= 0) {
 	if (M > 0) *spc2 += M;
 	return -gap(M);
     }
 
-    if (M <= 1) {
-	if (M <= 0) {
-	    *spc1 += N;
-	    return -gap(N);
-	}
-	midc = -m - gap(N);
-	midj = 0;
-	ss = s[A[0]];
-	for (j = 1; j <= N; ++j) {
-	    c = -gap(j-1) + ss[B[j-1]] - gap(N-j);
-	    if (c > midc) {
-		midc = c;
-		midj = j;
-	    }
-	}
-	if (midj == 0) {
-	    *(spc1+1) += N;
-	    ++(*spc2);
-	}
-	else {
-	    if (midj > 1) *spc1 += (midj-1);
-	    if (midj < N) *(spc1+1) += (N-midj);
+    if (M <= 0) {
+	*spc1 += N;
+	return -gap(N);
+    }
+    midc = -m - gap(N);
+    midj = 0;
+    ss = s[A[0]];
+    for (j = 1; j <= N; ++j) {
+	c = -gap(j-1) + ss[B[j-1]] - gap(N-j);
+	if (c > midc) {
+	    midc = c;
+	    midj = j;
 	}
-	return midc;
     }
+    if (midj == 0) {
+	*(spc1+1) += N;
+	++(*spc2);
+    }
+    else {
+	if (midj > 1) *spc1 += (midj-1);
+	if (midj < N) *(spc1+1) += (N-midj);
+    }
+    return midc;
+}
+
+/*
+  align_forward fills F with the last of the first midi rows of the
+  Gotoh matrix of A against B.
+ */
+static void
+align_forward(unsigned char * A, unsigned char * B, int midi, int N, int ** s, int g, int h, struct swstr * F)
+{
+    register struct swstr * swp;
+    register int i, j;
+    register int from, P, t;
+    int c; /* score of a cell */
+    int d; /* down value in Q array */
+    int * ss; 
+    int m = g + h;
 
-    swp = F;
     F[0].H = 0;
     t = -g;
     for (swp = F+1; swp <= F+N; ++swp) { 
@@ -112,10 +107,7 @@ align(unsigned char * A, unsigned char * B, int M, int N, int ** s, int g, int h
          swp->E = swp->H - g; // Q[m][0]
     }
 
-/* Calculate forward matrix cost */
-
     t = -g;
-    midi = M/2;
     for (i = 0; i < midi; ++i) {
 	from = F[0].H;
 	F[0].H = c = t = t - h;
@@ -133,6 +125,22 @@ align(unsigned char * A, unsigned char * B, int M, int N, int ** s, int g, int h
 	}
     }
     F[0].E = F[0].H;
+}
+
+/*
+  align_backward fills R with rows M-1 down to midi of the Gotoh matrix
+  of the reversed A against the reversed B.
+ */
+static void
+align_backward(unsigned char * A, unsigned char * B, int M, int midi, int N, int ** s, int g, int h, struct swstr * R)
+{
+    register struct swstr * swp;
+    register int i, j;
+    register int from, P, t;
+    int c; /* score of a cell */
+    int d; /* down value in Q array */
+    int * ss; 
+    int m = g + h;
 
     R[0].H = 0;
     t = -g;
@@ -141,8 +149,6 @@ align(unsigned char * A, unsigned char * B, int M, int N, int ** s, int g, int h
          swp->E = swp->H - g; // P[m][0]
     }
 
-/* Calculate backward matrix cost */
-
     t = -g;
     for (i = M-1; i >=midi; --i) {
 	from = R[0].H;
@@ -161,10 +167,22 @@ align(unsigned char * A, unsigned char * B, int M, int N, int ** s, int g, int h
 	}
     }
     R[0].E = R[0].H;
+}
+
+/*
+  align_middle joins the forward row F and the backward row R and
+  returns the best score through the middle row, with the column it
+  crosses at in *midj and in *type whether it crosses at a match (1) or
+  in the middle of a gap in B (2).
+ */
+static int
+align_middle(struct swstr * F, struct swstr * R, int N, int g, int * midj, int * type)
+{
+    int midc, c, j;
 
     midc = F[N].H + R[0].H;
-    midj = N;
-    type = 1;
+    *midj = N;
+    *type = 1;
 /* see if it is type I or type II */
 
     for (j = N-1; j >= 0; --j) {
@@ -172,7 +190,7 @@ align(unsigned char * A, unsigned char * B, int M, int N, int ** s, int g, int h
 	if (c >= midc) {
             if (c > midc || F[j].H == F[j].E && R[N-j].H != R[N-j].E) {
 	       midc = c;
-	       midj = j;
+	       *midj = j;
             }
 	}
     }
@@ -181,23 +199,507 @@ align(unsigned char * A, unsigned char * B, int M, int N, int ** s, int g, int h
 	c = F[j].E + R[N-j].E + g;
 	if (c > midc) {
 	    midc = c;
-	    midj = j;
-	    type = 2;
+	    *midj = j;
+	    *type = 2;
+	}
+    }
+    return midc;
+}
+
+#define ALIGN_QUADRATIC_CELLS (1<<20) /* default cell budget of align_quadratic */
+
+/* the traceback bits align_quadratic keeps of a cell, 4 to a byte */
+#define QUAD_H_DIAG 0 /* H comes from the diagonal */
+#define QUAD_H_P 1 /* H ends a gap in A */
+#define QUAD_H_D 2 /* H ends a gap in B */
+#define QUAD_P_EXT 4 /* the gap in A extends the one to the left */
+#define QUAD_D_EXT 8 /* the gap in B extends the one above */
+
+static long quadratic_cells = ALIGN_QUADRATIC_CELLS;
+
+/*
+  dpAlign_set_quadratic_cells sets the size M*N up to which align fills
+  the whole Gotoh matrix of a problem and traces it back instead of
+  dividing it any further. 0 turns that off.
+ */
+void
+dpAlign_set_quadratic_cells(long cells)
+{
+    quadratic_cells = cells < 0 ? 0 : cells;
+}
+
+/*
+  dpAlign_get_quadratic_cells returns the size set with
+  dpAlign_set_quadratic_cells.
+ */
+long
+dpAlign_get_quadratic_cells(void)
+{
+    return quadratic_cells;
+}
+
+/*
+  align_quadratic returns what align does, filling all M rows of the
+  Gotoh matrix the same way align_forward does and keeping two bits of
+  where H came from and a bit each of whether the gaps in A and B are
+  extended, half a byte per cell, to trace the alignment back from
+  there. It takes 2*M*N passes less than align for the cost of M*N/2
+  bytes, which pays as long as those stay in the cache. The bytes are
+  kept in the workspace ws from one call to the next.
+ */
+static int
+align_quadratic(unsigned char * A, unsigned char * B, int M, int N, int ** s, int g, int h, struct swstr * F, int * spc1, int * spc2, dpAlign_Workspace * ws)
+{
+    register struct swstr * swp;
+    register int i, j;
+    register int from, P, t;
+    int c; /* score of a cell */
+    int d; /* down value in Q array */
+    int * ss;
+    int m = g + h;
+    int bits, state;
+    size_t cell;
+    unsigned char * tb;
+
+    tb = (unsigned char *) dpAlign_Workspace_Buffer(&ws->trace, &ws->tracesz, ((size_t) M*N + 1)/2);
+
+    F[0].H = 0;
+    t = -g;
+    for (swp = F+1; swp <= F+N; ++swp) {
+	swp->H = t = t - h;
+	swp->E = swp->H - g;
+    }
+
+    t = -g;
+    for (cell = 0, i = 0; i < M; ++i) {
+	from = F[0].H;
+	F[0].H = c = t = t - h;
+	P = c - g;
+	ss = s[A[i]];
+	for (swp = F+1, j = 0; j < N; ++swp, ++j, ++cell) {
+	    bits = QUAD_H_DIAG;
+	    if ((c = c - m) > (P = P - h)) P = c;
+	    else bits |= QUAD_P_EXT;
+	    if ((c = swp->H - m) > (d = swp->E - h)) d = c;
+	    else bits |= QUAD_D_EXT;
+	    c = from + ss[B[j]];
+	    if (P > c) {
+		c = P;
+		bits |= QUAD_H_P;
+	    }
+	    if (d > c) {
+		c = d;
+		bits = (bits & ~QUAD_H_P) | QUAD_H_D;
+	    }
+	    if (cell & 1)
+		tb[cell >> 1] |= bits << 4;
+	    else
+		tb[cell >> 1] = bits;
+	    swp->E = d;
+	    from = swp->H;
+	    swp->H = c;
+	}
+    }
+
+/* state is the matrix the path is in: H, P (QUAD_H_P) or Q (QUAD_H_D) */
+    i = M;
+    j = N;
+    state = QUAD_H_DIAG;
+    while (i > 0 && j > 0) {
+	cell = (size_t) (i-1)*N + j-1;
+	bits = tb[cell >> 1] >> ((cell & 1) << 2);
+	if (state == QUAD_H_DIAG && (state = bits & 3) == QUAD_H_DIAG) {
+	    --i;
+	    --j;
+	}
+	else if (state == QUAD_H_P) {
+	    ++spc1[i];
+	    --j;
+	    if (!(bits & QUAD_P_EXT))
+		state = QUAD_H_DIAG;
+	}
+	else {
+	    ++spc2[j];
+	    --i;
+	    if (!(bits & QUAD_D_EXT))
+		state = QUAD_H_DIAG;
+	}
+    }
+    if (i > 0) *spc2 += i;
+    if (j > 0) *spc1 += j;
+    return F[N].H;
+}
+
+/*
+  align is an implementation of Miller-Myers' dynamic programming alignment
+  algorithm using the gap array to represent the alignment result.
+  There are two gap arrays, one for each sequence. Each of them consists of
+  M+1 and N+1 cells where M is the length of sequence A and N is the length
+  of sequence B. In general, spc1[i] will contain an integer that indicates
+  how many gaps need to be inserted between A[i-1] and A[i]. For example, 
+  spc1[1] will represent the number of gaps inserted between residues A[0] 
+  and A[1]. s is the scoring matrix. g is the gap opening cost. e is the
+  gap extension cost. F is the forward Gotoh array. R is the backward
+  Gotoh array. Note that spc1 and spc2 gap arrays should be initilized to
+  all zeros when you first call this function.
+  align returns the score of the resulting alignment. At the end, the gap
+  arrays spc1 and spc2 will also be set to the proper values.
+  Problems of up to dpAlign_get_quadratic_cells() cells are handed to
+  align_quadratic rather than divided.
+ */ 
+int
+align(unsigned char * A, unsigned char * B, int M, int N, int ** s, int g, int h, struct swstr * F, struct swstr * R, int * spc1, int * spc2, dpAlign_Workspace * ws)
+{
+    int midi, midj, type;
+    int midc;
+
+/* if the mstrix to divide and conquer has size <= 1 */
+    if (N <= 0 || M <= 1)
+	return align_base(A, B, M, N, s, g, h, spc1, spc2);
+
+/* if it is small enough to fill the whole matrix */
+    if ((long long) M*N <= quadratic_cells)
+	return align_quadratic(A, B, M, N, s, g, h, F, spc1, spc2, ws);
+
+/* Calculate forward and backward matrix cost */
+    midi = M/2;
+    align_forward(A, B, midi, N, s, g, h, F);
+    align_backward(A, B, M, midi, N, s, g, h, R);
+    midc = align_middle(F, R, N, g, &midj, &type);
+
+    if (type == 1) {
+	align(A, B, midi, midj, s, g, h, F, R, spc1, spc2, ws);
+	align(A+midi, B+midj, M-midi, N-midj, s, g, h, F, R, spc1+midi, spc2+midj, ws);
+    }
+    else {
+	align(A, B, midi-1, midj, s, g, h, F, R, spc1, spc2, ws);
+	*(spc2+midj) += 2;
+	align(A+midi+1, B+midj, M-midi-1, N-midj, s, g, h, F, R, spc1+midi+1, spc2+midj, ws);
+    }
+    return midc;
+}
+
+#define ALIGN_TASK_CELLS (1 << 20) /* smallest subproblem worth a task of its own */
+
+typedef struct _align_Job {
+    dpAlign_Task task;
+    dpAlign_Pool * pool;
+    unsigned char * A;
+    unsigned char * B;
+    int M;
+    int N;
+    int ** s;
+    int g;
+    int h;
+    int * spc1;
+    int * spc2;
+} align_Job;
+
+typedef struct _align_Pass {
+    dpAlign_Task task;
+    unsigned char * A;
+    unsigned char * B;
+    int M;
+    int midi;
+    int N;
+    int ** s;
+    int g;
+    int h;
+    struct swstr * R;
+} align_Pass;
+
+static int align_split(dpAlign_Pool *, unsigned char *, unsigned char *, int, int, int **, int, int, struct swstr *, struct swstr *, int *, int *, dpAlign_Workspace *);
+
+static void *
+align_alloc(size_t sz)
+{
+    void * p = calloc(sz > 0 ? sz : 1, 1);
+
+    if (p == NULL)
+	dpAlign_fatal("Can't allocate memory for parallel alignment!\n");
+    return p;
+}
+
+/* a subproblem run as a task, with Gotoh rows and a workspace of its own */
+static void
+align_job(void * arg)
+{
+    align_Job * j = (align_Job *) arg;
+    dpAlign_Workspace ws;
+    struct swstr * F, * R;
+
+    memset(&ws, 0, sizeof(dpAlign_Workspace));
+    F = (struct swstr *) align_alloc(2*(j->N+1)*sizeof(struct swstr));
+    R = F + j->N+1;
+    align_split(j->pool, j->A, j->B, j->M, j->N, j->s, j->g, j->h, F, R, j->spc1, j->spc2, &ws);
+    free(ws.trace);
+    free(F);
+}
+
+/* the backward pass of a split, run as a task */
+static void
+align_pass(void * arg)
+{
+    align_Pass * p = (align_Pass *) arg;
+
+    align_backward(p->A, p->B, p->M, p->midi, p->N, p->s, p->g, p->h, p->R);
+}
+
+/*
+  align_split is align with the first of the two subproblems of every
+  split big enough spawned as a task of pool. The two subproblems share
+  one cell of each gap array, where the first one ends and the second
+  one starts, so the second one is traced into gap arrays of its own
+  which are added in once both are done. The forward and backward
+  passes of a split are independent until they are joined, so the
+  backward pass is a task of its own as well.
+ */
+static int
+align_split(dpAlign_Pool * pool, unsigned char * A, unsigned char * B, int M, int N, int ** s, int g, int h, struct swstr * F, struct swstr * R, int * spc1, int * spc2, dpAlign_Workspace * ws)
+{
+    align_Job job;
+    align_Pass pass;
+    int midi, midj, type;
+    int midc, i, j;
+    int M2, N2, * spc1b, * spc2b, * sp1, * sp2;
+
+    if ((long long) M*N < 2*(long long) ALIGN_TASK_CELLS || N <= 0 || M <= 1)
+	return align(A, B, M, N, s, g, h, F, R, spc1, spc2, ws);
+
+    midi = M/2;
+    pass.A = A;
+    pass.B = B;
+    pass.M = M;
+    pass.midi = midi;
+    pass.N = N;
+    pass.s = s;
+    pass.g = g;
+    pass.h = h;
+    pass.R = R;
+    pass.task.run = align_pass;
+    pass.task.arg = &pass;
+    dpAlign_Pool_Spawn(pool, &pass.task);
+    align_forward(A, B, midi, N, s, g, h, F);
+    dpAlign_Pool_Wait(pool, &pass.task);
+    midc = align_middle(F, R, N, g, &midj, &type);
+
+    job.pool = pool;
+    job.A = A;
+    job.B = B;
+    job.M = type == 1 ? midi : midi-1;
+    job.N = midj;
+    job.s = s;
+    job.g = g;
+    job.h = h;
+    job.spc1 = spc1;
+    job.spc2 = spc2;
+    i = type == 1 ? midi : midi+1;
+    M2 = M-i;
+    N2 = N-midj;
+    if (type == 2)
+	*(spc2+midj) += 2;
+
+    if ((long long) job.M*job.N < ALIGN_TASK_CELLS) {
+	align(job.A, job.B, job.M, job.N, s, g, h, F, R, spc1, spc2, ws);
+	align_split(pool, A+i, B+midj, M2, N2, s, g, h, F, R, spc1+i, spc2+midj, ws);
+	return midc;
+    }
+
+    job.task.run = align_job;
+    job.task.arg = &job;
+    dpAlign_Pool_Spawn(pool, &job.task);
+    spc1b = (int *) align_alloc((M2+N2+2)*sizeof(int));
+    spc2b = spc1b + M2+1;
+    align_split(pool, A+i, B+midj, M2, N2, s, g, h, F, R, spc1b, spc2b, ws);
+    dpAlign_Pool_Wait(pool, &job.task);
+    for (sp1 = spc1+i, j = 0; j <= M2; ++j)
+	sp1[j] += spc1b[j];
+    for (sp2 = spc2+midj, j = 0; j <= N2; ++j)
+	sp2[j] += spc2b[j];
+    free(spc1b);
+    return midc;
+}
+
+/*
+  align_threaded returns the same alignment as align, running the
+  passes and the subproblems of big enough problems at the same time on
+  up to threads threads of the shared pool (see dppool.c), or on
+  dpAlign_get_threads() threads if threads is 0.
+ */
+int
+align_threaded(unsigned char * A, unsigned char * B, int M, int N, int ** s, int g, int h, struct swstr * F, struct swstr * R, int * spc1, int * spc2, int threads, dpAlign_Workspace * ws)
+{
+    if (threads < 1)
+	threads = dpAlign_get_threads();
+    if (threads <= 1 || (long long) M*N < 2*(long long) ALIGN_TASK_CELLS)
+	return align(A, B, M, N, s, g, h, F, R, spc1, spc2, ws);
+    return align_split(dpAlign_Shared_Pool(threads), A, B, M, N, s, g, h, F, R, spc1, spc2, ws);
+}
+
+#define BAND_NEG (INT_MIN/4) /* score of a cell outside the band */
+#define BAND_START 16 /* half width of the first band tried by align_banded */
+
+/*
+  band_pass fills F with row rows of the Gotoh matrix of A against B the
+  same way the forward and backward passes of align do, but only for the
+  cells on diagonals klo <= j-i <= khi; every other cell of that row is
+  left at BAND_NEG. A and B are walked astep and bstep at a time, so the
+  backward pass is a call with both pointing at their last residue and
+  steps of -1.
+ */
+static void
+band_pass(unsigned char * A, int astep, unsigned char * B, int bstep, int N, int rows, int ** s, int g, int h, struct swstr * F, int klo, int khi)
+{
+    register struct swstr * swp;
+    register unsigned char * pb;
+    register int from, P, c, d;
+    int i, j, lo, hi, t;
+    int * ss;
+    int m = g + h;
+
+    hi = khi < N ? khi : N;
+    F[0].H = 0;
+    t = -g;
+    for (j = 1; j <= hi; ++j) {
+	F[j].H = t = t - h;
+	F[j].E = F[j].H - g;
+    }
+    for (; j <= N; ++j)
+	F[j].H = F[j].E = BAND_NEG;
+
+    t = -g;
+    for (i = 1; i <= rows; ++i, A += astep) {
+	lo = i + klo;
+	hi = i + khi < N ? i + khi : N;
+	ss = s[*A];
+	if (lo <= 0) {
+	    from = F[0].H;
+	    F[0].H = c = t = t - h;
+	    P = c - g;
+	    lo = 1;
+	}
+	else {
+/* the cell left of the band drops out of it in this row */
+	    from = F[lo-1].H;
+	    F[lo-1].H = F[lo-1].E = BAND_NEG;
+	    c = P = BAND_NEG;
+	}
+	for (swp = F+lo, pb = B+(lo-1)*bstep, j = lo; j <= hi; ++swp, pb += bstep, ++j) {
+	    if ((c = c - m) > (P = P - h)) P = c;
+	    if ((c = swp->H - m) > (d = swp->E - h)) d = c;
+	    c = from + ss[*pb];
+	    if (P > c) c = P;
+	    if (d > c) c = d;
+	    swp->E = d;
+	    from = swp->H;
+	    swp->H = c;
 	}
     }
+    if (rows + klo <= 0)
+	F[0].E = F[0].H;
+}
+
+/*
+  align_band is align restricted to the diagonals klo <= j-i <= khi of
+  the M x N problem, which must contain both (0,0) and (M,N). The
+  subproblems get the same band moved to their own origin. The base
+  cases are left to align: they are optimal without the band, so they
+  can't do worse than the band allows. Problems align would fill whole
+  are left to it as well, so both divide a problem the same way and
+  break ties between optimal alignments the same way.
+ */
+static int
+align_band(unsigned char * A, unsigned char * B, int M, int N, int ** s, int g, int h, struct swstr * F, struct swstr * R, int * spc1, int * spc2, int klo, int khi, dpAlign_Workspace * ws)
+{
+    int midi, midj, type;
+    int midc;
+
+    if (N <= 0 || M <= 1 || (long long) M*N <= quadratic_cells || (klo <= -M && khi >= N))
+	return align(A, B, M, N, s, g, h, F, R, spc1, spc2, ws);
+
+    midi = M/2;
+    band_pass(A, 1, B, 1, N, midi, s, g, h, F, klo, khi);
+    band_pass(A+M-1, -1, B+N-1, -1, N, M-midi, s, g, h, R, N-M-khi, N-M-klo);
+
+/* same choice of midpoint as align, cells outside the band never win */
+    midc = align_middle(F, R, N, g, &midj, &type);
 
     if (type == 1) {
-	align(A, B, midi, midj, s, g, h, F, R, spc1, spc2);
-	align(A+midi, B+midj, M-midi, N-midj, s, g, h, F, R, spc1+midi, spc2+midj);
+	align_band(A, B, midi, midj, s, g, h, F, R, spc1, spc2, klo, khi, ws);
+	align_band(A+midi, B+midj, M-midi, N-midj, s, g, h, F, R, spc1+midi, spc2+midj, klo-midj+midi, khi-midj+midi, ws);
     }
     else {
-	align(A, B, midi-1, midj, s, g, h, F, R, spc1, spc2);
+	align_band(A, B, midi-1, midj, s, g, h, F, R, spc1, spc2, klo, khi, ws);
 	*(spc2+midj) += 2;
-	align(A+midi+1, B+midj, M-midi-1, N-midj, s, g, h, F, R, spc1+midi+1, spc2+midj);
+	align_band(A+midi+1, B+midj, M-midi-1, N-midj, s, g, h, F, R, spc1+midi+1, spc2+midj, klo-midj+midi+1, khi-midj+midi+1, ws);
     }
     return midc;
 }
 
+/*
+  band_bound returns twice an upper bound of the score of any alignment
+  of an M x N problem that leaves the diagonals klo..khi, given smax, the
+  best score in the scoring matrix. Such an alignment has to go out and
+  come back, so it has at least two gaps with at least G spaces in total,
+  and at most (M+N-G)/2 aligned pairs. The bound is linear in the number
+  of spaces, so the worst case is at one end of the range.
+ */
+static long long
+band_bound(int M, int N, int klo, int khi, int smax, int g, int h)
+{
+    long long G, Gmax = (long long) M + N;
+    long long b1, b2;
+
+    G = Gmax + 1;
+    if (khi < N)
+	G = 2*((long long) khi+1) - (N-M);
+    if (klo > -M && (N-M) - 2*((long long) klo-1) < G)
+	G = (N-M) - 2*((long long) klo-1);
+    if (G > Gmax)
+	return LLONG_MIN; /* the band is the whole matrix */
+
+    b1 = smax*(Gmax-G) - 4*(long long) g - 2*h*G;
+    b2 = -4*(long long) g - 2*h*Gmax;
+    return b1 > b2 ? b1 : b2;
+}
+
+/*
+  align_banded returns the same optimal global alignment score as align
+  and fills the gap arrays spc1 and spc2 the same way, but only looks at
+  a band of diagonals around the corners of the matrix. The band starts
+  BAND_START diagonals wide on each side and is doubled until the best
+  score inside it is at least band_bound, i.e. no alignment leaving the
+  band can beat it, after which the alignment is traced within the band.
+  Where another alignment of the same score leaves the band, the one
+  traced may differ from that of align. For sequences that differ by d
+  edits this takes O((M+N)d) time instead of O(MN), plus the problems
+  small enough for align to fill whole. sz is the size of the alphabet
+  of the scoring matrix s.
+ */
+int
+align_banded(unsigned char * A, unsigned char * B, int M, int N, int ** s, int sz, int g, int h, struct swstr * F, struct swstr * R, int * spc1, int * spc2, dpAlign_Workspace * ws)
+{
+    int smax, klo, khi, w, i, j;
+
+    if (M <= 1 || N <= 0 || (long long) M*N <= quadratic_cells)
+	return align(A, B, M, N, s, g, h, F, R, spc1, spc2, ws);
+
+    smax = s[0][0];
+    for (i = 0; i < sz; ++i)
+	for (j = 0; j < sz; ++j)
+	    if (s[i][j] > smax) smax = s[i][j];
+
+    for (w = BAND_START; ; w *= 2) {
+	klo = (N < M ? N-M : 0) - w;
+	khi = (N > M ? N-M : 0) + w;
+	if (klo <= -M && khi >= N)
+	    return align(A, B, M, N, s, g, h, F, R, spc1, spc2, ws);
+	band_pass(A, 1, B, 1, N, M, s, g, h, F, klo, khi);
+	if (2*(long long) F[N].H >= band_bound(M, N, klo, khi, smax, g, h))
+	    return align_band(A, B, M, N, s, g, h, F, R, spc1, spc2, klo, khi, ws);
+    }
+}
+
 /*
     pgreen runs Phil Green's algorithm to calculate alignment score between
     two sequences. The argument waa is a sequence profile derived from
@@ -300,7 +802,6 @@ pgreen(int * waa, int M, unsigned char * B, int N, int gap, int ext, struct swst
     next_row:
 	;
     }
-	
-	free(waa);
+
     return score;
 }
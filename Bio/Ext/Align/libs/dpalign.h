@@ -6,6 +6,7 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <limits.h>
 
 /* global variables */
 extern int hoxd[4][4];
@@ -17,11 +18,15 @@ struct swstr {
 };
 
 #define gap(k) ((k) <= 0 ? 0 : g+h*(k)) /* gap cost */
+#define upper_case(c) ((c) >= 'a' && (c) <= 'z' ? (c) - 0x20 : (c))
 /* a naive macro to encode DNA nucleotide */
 #define dna_encode(c) (c == 'A' ? 0x00 : c == 'C' ? 0x01 : c == 'G' ? 0x02 : c == 'T' ? 0x03 : c == 'U' ? 0x04 : c == 'R' ? 0x05 : c == 'Y' ? 0x06 : c == 'M' ? 0x07 : c == 'W' ? 0x08 : c == 'S' ? 0x09 : c == 'K' ? 0x0a : c == 'D' ? 0x0b : c == 'H' ? 0x0c : c == 'V' ? 0x0d : c == 'B' ? 0x0e : c == 'N' ? 0x0f : c == 'X' ? 0x10 : -1)
 /* a naive macro to encode amino acids */
 #define prot_encode(c) (c == 'A' ? 0x00 : c == 'R' ? 0x01 : c == 'N' ? 0x02 : c == 'D' ? 0x03 : c == 'C' ? 0x04 : c == 'Q' ? 0x05 : c == 'E' ? 0x06 : c == 'G' ? 0x07 : c == 'H' ? 0x08 : c == 'I' ? 0x09 : c == 'L' ? 0x0a : c == 'K' ? 0x0b : c == 'M' ? 0x0c : c == 'F' ? 0x0d : c == 'P' ? 0x0e : c == 'S' ? 0x0f : c == 'T' ? 0x10 : c == 'W' ? 0x11 : c == 'Y' ? 0x12 : c == 'V' ? 0x13 : c == 'B' ? 0x14 : c == 'Z' ? 0x15 : c == 'X' ? 0x16 : c == '*' ? 0x17 : -1)
 
+#define DPALIGN_DNA 1 /* sequence types, as in dpAlign_SequenceProfile */
+#define DPALIGN_PROTEIN 2
+
 typedef struct _dpAlign_alnoutput {
    char * aln1; /* aligned subsequence of sequence 1 with space '-' inserted */
    int start1; /* start point of aligned subsequence 1 */
@@ -30,8 +35,24 @@ typedef struct _dpAlign_alnoutput {
    int start2; /* start point of aligned subsequence 2 */
    int end2; /* end point of aligned subsequence 2 */
    int score; /* score of this alignment */
+   char * cigar; /* run-length CIGAR of the alignment, NULL unless asked for */
+   int matches; /* aligned pairs of identical residues */
+   int mismatches; /* aligned pairs of different residues */
+   int gap_opens; /* runs of gaps in either sequence */
+   int gap_exts; /* columns with a gap, each charged the extension penalty */
 } dpAlign_AlignOutput;
 
+/* modes of dpAlign_DNA_Myers */
+#define DPALIGN_MYERS_GLOBAL 0 /* all of both sequences */
+#define DPALIGN_MYERS_SEMIGLOBAL 1 /* all of sequence 1 in any part of sequence 2 */
+#define DPALIGN_MYERS_PREFIX 2 /* all of sequence 1 against a prefix of sequence 2 */
+
+/* what the aligners put in a dpAlign_AlignOutput besides the statistics */
+#define DPALIGN_OUTPUT_ALN 1 /* the gapped strings aln1 and aln2 */
+#define DPALIGN_OUTPUT_CIGAR 2 /* the CIGAR string */
+
+struct _dpAlign_StripedProfile; /* private to dpstriped.c */
+
 typedef struct _dpAlign_SequenceProfile {
    int * waa; /* sequence profile */
    int gap;
@@ -39,30 +60,142 @@ typedef struct _dpAlign_SequenceProfile {
    int len; /* length of sequence */
    int type; /* 1 is DNA, 2 is Protein, 3 is RNA */
    int a[256]; /* alphabet array that maps a character in the alphabet to an integer index that indexes the columns and rows in the scoring matrix */
+   int sz; /* size of alphabet, i.e. number of rows of waa in use */
+   struct _dpAlign_StripedProfile * striped; /* waa rearranged for the SIMD kernels, NULL if unavailable */
+   void * map; /* profile file waa is mapped from by dpAlign_Load_Profile, NULL if waa is allocated */
+   size_t mapsz; /* size of the mapping */
 } dpAlign_SequenceProfile;
 
+typedef struct _dpAlign_ScanHit {
+   char * name; /* first word of the FASTA header */
+   int score; /* optimal local alignment score against the profile */
+   long index; /* position of the record in the file, from 0 */
+} dpAlign_ScanHit;
+
+typedef struct _dpAlign_EncodedSequence {
+   char * seq; /* the sequence in upper case, NULL-terminated */
+   unsigned char * code; /* the residues encoded, protein in the BLOSUM62 alphabet */
+   int len; /* length of the sequence */
+   int type; /* DPALIGN_DNA or DPALIGN_PROTEIN */
+} dpAlign_EncodedSequence;
+
+/* bytes of the block a sequence of n residues is encoded into */
+#define DPALIGN_ENCODED_SIZE(n) (sizeof(dpAlign_EncodedSequence) + 2*(size_t) (n) + 1)
+
+typedef struct _dpAlign_Matrix {
+   int ** s; /* rows of s32, for the kernels that index s[a][b] */
+   int * s32; /* scores, stride cells per row, each row 64 byte aligned */
+   int sz; /* size of alphabet */
+   int stride; /* cells per row, sz rounded up to a multiple of 16 */
+} dpAlign_Matrix;
+
+typedef struct _dpAlign_Workspace {
+   void * rows; /* forward and reverse Gotoh rows */
+   size_t rowsz;
+   void * seqs; /* encoded sequences */
+   size_t seqsz;
+   void * spcs; /* gap arrays */
+   size_t spcsz;
+   void * simd; /* rows of the striped kernels */
+   size_t simdsz;
+   void * bits; /* bit-vector columns of the edit distance aligner */
+   size_t bitsz;
+   void * orgs; /* start points of the cells of a Gotoh row */
+   size_t orgsz;
+   void * trace; /* traceback bits of the small problems of the Miller-Myers aligner */
+   size_t tracesz;
+   int output; /* DPALIGN_OUTPUT_* flags of the alignments, 0 is DPALIGN_OUTPUT_ALN */
+} dpAlign_Workspace;
+
+typedef struct _dpAlign_Pool dpAlign_Pool; /* private to dppool.c */
+
+typedef struct _dpAlign_Job dpAlign_Job; /* private to dppairs.c */
+
+typedef struct _dpAlign_Task {
+   void (*run)(void *); /* what the task does */
+   void * arg; /* argument of run */
+   int done; /* set once run has returned */
+   struct _dpAlign_Task * next; /* links of the deque the task is queued in */
+   struct _dpAlign_Task * prev;
+} dpAlign_Task;
+
 typedef struct _dpAlign_ScoringMatrix {
-   int ** s; /* scoring matrix pointer */
+   int ** s; /* scoring matrix pointer, the rows of m */
+   dpAlign_Matrix * m; /* the scores in one block */
    int a[256]; /* alphabet array that maps a character in the alphabet to an integer index that indexes the columns and rows in the scoring matrix */
    int gap; /* gap opening penalty for this matrix */
    int ext; /* gap extension penalty for this matrix */
    int sz; /* size of alphabet */
 } dpAlign_ScoringMatrix;
 
-dpAlign_AlignOutput * dpAlign_Local_DNA_MillerMyers(char *, char *, int, int, int, int);
-dpAlign_AlignOutput * dpAlign_Global_DNA_MillerMyers(char *, char *, int, int, int, int);
-dpAlign_AlignOutput * dpAlign_EndsFree_DNA_MillerMyers(char *, char *, int, int, int, int);
-dpAlign_AlignOutput * dpAlign_Local_Protein_MillerMyers(char *, char *, dpAlign_ScoringMatrix *);
-dpAlign_AlignOutput * dpAlign_Global_Protein_MillerMyers(char *, char *, dpAlign_ScoringMatrix *);
-dpAlign_AlignOutput * dpAlign_EndsFree_Protein_MillerMyers(char *, char *, dpAlign_ScoringMatrix *);
+dpAlign_AlignOutput * dpAlign_Local_DNA_MillerMyers(dpAlign_EncodedSequence *, dpAlign_EncodedSequence *, int, int, int, int, int, dpAlign_Workspace *);
+dpAlign_AlignOutput * dpAlign_Global_DNA_MillerMyers(dpAlign_EncodedSequence *, dpAlign_EncodedSequence *, int, int, int, int, int, dpAlign_Workspace *);
+dpAlign_AlignOutput * dpAlign_Global_DNA_MillerMyers_Banded(dpAlign_EncodedSequence *, dpAlign_EncodedSequence *, int, int, int, int, dpAlign_Workspace *);
+dpAlign_AlignOutput * dpAlign_EndsFree_DNA_MillerMyers(dpAlign_EncodedSequence *, dpAlign_EncodedSequence *, int, int, int, int, int, dpAlign_Workspace *);
+dpAlign_AlignOutput * dpAlign_Local_Protein_MillerMyers(dpAlign_EncodedSequence *, dpAlign_EncodedSequence *, dpAlign_ScoringMatrix *, int, dpAlign_Workspace *);
+dpAlign_AlignOutput * dpAlign_Global_Protein_MillerMyers(dpAlign_EncodedSequence *, dpAlign_EncodedSequence *, dpAlign_ScoringMatrix *, int, dpAlign_Workspace *);
+dpAlign_AlignOutput * dpAlign_Global_Protein_MillerMyers_Banded(dpAlign_EncodedSequence *, dpAlign_EncodedSequence *, dpAlign_ScoringMatrix *, dpAlign_Workspace *);
+dpAlign_AlignOutput * dpAlign_EndsFree_Protein_MillerMyers(dpAlign_EncodedSequence *, dpAlign_EncodedSequence *, dpAlign_ScoringMatrix *, int, dpAlign_Workspace *);
+dpAlign_AlignOutput * dpAlign_Local_DNA_XDrop(dpAlign_EncodedSequence *, dpAlign_EncodedSequence *, int, int, int, int, int, int, int, dpAlign_Workspace *);
+dpAlign_AlignOutput * dpAlign_Local_Protein_XDrop(dpAlign_EncodedSequence *, dpAlign_EncodedSequence *, int, int, dpAlign_ScoringMatrix *, int, dpAlign_Workspace *);
+dpAlign_AlignOutput * dpAlign_DNA_Myers(dpAlign_EncodedSequence *, dpAlign_EncodedSequence *, int, dpAlign_Workspace *);
+void dpAlign_DNA_MillerMyers_Batch(dpAlign_EncodedSequence **, dpAlign_EncodedSequence **, int, int, int, int, int, int, int, int, dpAlign_AlignOutput **);
+void dpAlign_Protein_MillerMyers_Batch(dpAlign_EncodedSequence **, dpAlign_EncodedSequence **, int, dpAlign_ScoringMatrix *, int, int, int, dpAlign_AlignOutput **);
+void free_dpAlign_AlignOutput(dpAlign_AlignOutput *);
+dpAlign_Job * dpAlign_DNA_MillerMyers_Submit(dpAlign_EncodedSequence *, dpAlign_EncodedSequence *, int, int, int, int, int, int);
+dpAlign_Job * dpAlign_Protein_MillerMyers_Submit(dpAlign_EncodedSequence *, dpAlign_EncodedSequence *, dpAlign_ScoringMatrix *, int, int);
+int dpAlign_Job_Ready(dpAlign_Job *);
+void dpAlign_Job_Wait(dpAlign_Job *);
+dpAlign_AlignOutput * dpAlign_Job_Result(dpAlign_Job *);
+int dpAlign_Job_Fd(void);
+void free_dpAlign_Job(dpAlign_Job *);
 dpAlign_SequenceProfile * dpAlign_Protein_Profile(char *, dpAlign_ScoringMatrix *);
-int dpAlign_Local_Protein_PhilGreen(dpAlign_SequenceProfile *, char *);
+int dpAlign_Local_Protein_PhilGreen(dpAlign_SequenceProfile *, dpAlign_EncodedSequence *, dpAlign_Workspace *);
 dpAlign_SequenceProfile * dpAlign_DNA_Profile(char *, int, int, int, int);
-int dpAlign_Local_DNA_PhilGreen(dpAlign_SequenceProfile *, char *);
+int dpAlign_Local_DNA_PhilGreen(dpAlign_SequenceProfile *, dpAlign_EncodedSequence *, dpAlign_Workspace *);
+void dpAlign_Local_Protein_PhilGreen_Batch(dpAlign_SequenceProfile *, char **, int, int *);
+void dpAlign_Local_DNA_PhilGreen_Batch(dpAlign_SequenceProfile *, char **, int, int *);
+void free_dpAlign_SequenceProfile(dpAlign_SequenceProfile *);
+int dpAlign_Scan_Fasta(dpAlign_SequenceProfile *, char *, int, int, dpAlign_ScanHit **);
+void free_dpAlign_ScanHits(dpAlign_ScanHit *, int);
 dpAlign_ScoringMatrix * new_dpAlign_ScoringMatrix(char *, int, int);
 void set_dpAlign_ScoringMatrix(dpAlign_ScoringMatrix *, char *, char *, int);
+dpAlign_ScoringMatrix * copy_dpAlign_ScoringMatrix(dpAlign_ScoringMatrix *);
+void free_dpAlign_ScoringMatrix(dpAlign_ScoringMatrix *);
+dpAlign_Matrix * new_dpAlign_Matrix(int);
+void free_dpAlign_Matrix(dpAlign_Matrix *);
+void dpAlign_Matrix_Set(dpAlign_Matrix *, int, int, int);
+dpAlign_Matrix * dpAlign_DNA_Matrix(int, int);
+dpAlign_Matrix * dpAlign_Blosum62_Matrix(void);
+dpAlign_EncodedSequence * dpAlign_Encode_Sequence(void *, char *, int, int);
+dpAlign_EncodedSequence * new_dpAlign_EncodedSequence(char *, int);
+void free_dpAlign_EncodedSequence(dpAlign_EncodedSequence *);
+unsigned char * dpAlign_Encode_Table(int);
+void dpAlign_Encode(char *, int, unsigned char *, unsigned char *, char *);
 dpAlign_AlignOutput * dpAlign_Local_DNA_Green(char *, char *, int, int, int, int);
 void dpAlign_fatal(char *);
-int align(unsigned char *, unsigned char *, int, int, int **, int, int, struct swstr *, struct swstr *, int *, int *);
+int align(unsigned char *, unsigned char *, int, int, int **, int, int, struct swstr *, struct swstr *, int *, int *, dpAlign_Workspace *);
+int align_threaded(unsigned char *, unsigned char *, int, int, int **, int, int, struct swstr *, struct swstr *, int *, int *, int, dpAlign_Workspace *);
+int align_banded(unsigned char *, unsigned char *, int, int, int **, int, int, int, struct swstr *, struct swstr *, int *, int *, dpAlign_Workspace *);
+int myers_align(unsigned char *, unsigned char *, int, int, int **, int, int *, int *, int *, int *, dpAlign_Workspace *);
 int pgreen(int *, int, unsigned char *, int, int, int, struct swstr *);
+void dpAlign_Striped_Profile(dpAlign_SequenceProfile *);
+void free_dpAlign_StripedProfile(struct _dpAlign_StripedProfile *);
+int dpAlign_Striped_Write(struct _dpAlign_StripedProfile *, FILE *);
+struct _dpAlign_StripedProfile * dpAlign_Striped_Map(dpAlign_SequenceProfile *, char *, size_t);
+int dpAlign_File_Pad(FILE *, int);
+int dpAlign_Save_Profile(dpAlign_SequenceProfile *, char *);
+dpAlign_SequenceProfile * dpAlign_Load_Profile(char *);
+int dpAlign_PhilGreen_Score(dpAlign_SequenceProfile *, unsigned char *, int, dpAlign_Workspace *);
+void dpAlign_PhilGreen_Batch(dpAlign_SequenceProfile *, unsigned char **, int *, int, int *);
+dpAlign_Pool * dpAlign_Shared_Pool(int);
+dpAlign_Workspace * new_dpAlign_Workspace(void);
+void free_dpAlign_Workspace(dpAlign_Workspace *);
+void * dpAlign_Workspace_Buffer(void **, size_t *, size_t);
+void dpAlign_Pool_Spawn(dpAlign_Pool *, dpAlign_Task *);
+void dpAlign_Pool_Wait(dpAlign_Pool *, dpAlign_Task *);
+void dpAlign_set_threads(int);
+int dpAlign_get_threads(void);
+void dpAlign_set_quadratic_cells(long);
+long dpAlign_get_quadratic_cells(void);
 #endif
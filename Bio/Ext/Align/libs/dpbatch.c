@@ -0,0 +1,287 @@
+#include "dpalign.h"
+
+/* $Id$ */
+
+/*
+  Inter-sequence batched score kernels, after Rognes' SWIPE ("Faster
+  Smith-Waterman database searches with inter-sequence SIMD
+  parallelisation", BMC Bioinformatics 12:221, 2011).
+
+  Instead of spreading the query over the lanes of a vector as the
+  striped kernels in dpstriped.c do, every lane holds a different target
+  and the query is walked one residue at a time, so there is no lazy F
+  loop and no dependency between the lanes. The scores for a column come
+  from a per query position table of the profile, indexed by the residues
+  of the targets in that column (a byte shuffle with AVX2, a table lookup
+  per lane with SSE2).
+
+  Targets are sorted by length and taken 32 (AVX2) or 16 (SSE2) at a
+  time; lanes whose target is finished are fed a padding residue that
+  scores as the worst possible match. Lanes are 8-bit unsigned and
+  saturated; a target whose score saturates, or that has a residue
+  outside the profile's alphabet, is rescored by itself with
+  dpAlign_PhilGreen_Score, so the scores always equal pgreen's.
+ */
+
+#if !defined(DPALIGN_NO_SIMD) && defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#define DPALIGN_SSE2
+#include <emmintrin.h>
+#if !defined(DPALIGN_NO_AVX2) && (__GNUC__ > 4 || defined(__clang__))
+#define DPALIGN_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+#ifdef DPALIGN_SSE2
+
+#define BATCH_ALPHABET 32 /* room for the alphabet plus the padding residue */
+
+typedef struct _batch_Table {
+    unsigned char * t; /* 64 bytes per query position, see batch_table */
+    int len; /* length of query */
+    int sz; /* padding residue, one past the alphabet */
+    int bias; /* added to every score so that none is negative */
+    int gapo; /* cost of the first residue of a gap */
+    int gape; /* cost of every further residue of a gap */
+} batch_Table;
+
+static void *
+batch_alloc(size_t sz)
+{
+    void * p = NULL;
+
+    if (posix_memalign(&p, 32, sz) != 0)
+	dpAlign_fatal("Can't allocate memory for batch scoring!\n");
+    memset(p, 0, sz);
+    return p;
+}
+
+/*
+  batch_table transposes the query profile of sp so that the biased
+  scores of all residues against query position i are contiguous. Each
+  position takes 64 bytes laid out as residues 0-15 twice followed by
+  residues 16-31 twice, which is what the AVX2 byte shuffle wants; the
+  SSE2 kernel only reads the first copy of each half. It returns 0 if
+  the profile scores or gap penalties don't fit in 8 bits.
+ */
+static int
+batch_table(dpAlign_SequenceProfile * sp, batch_Table * bt)
+{
+    int lo = 0, hi = 0;
+    int i, c;
+    unsigned char v;
+
+    bt->gapo = sp->gap + sp->ext;
+    bt->gape = sp->ext;
+    if (sp->sz >= BATCH_ALPHABET || sp->gap < 0 || bt->gape < 0 || bt->gapo > 255)
+	return 0;
+    for (i = 0; i < sp->sz*sp->len; ++i) {
+	if (sp->waa[i] < lo) lo = sp->waa[i];
+	if (sp->waa[i] > hi) hi = sp->waa[i];
+    }
+    if (hi - lo > 255)
+	return 0;
+
+    bt->len = sp->len;
+    bt->sz = sp->sz;
+    bt->bias = -lo;
+    bt->t = (unsigned char *) batch_alloc(64*sp->len);
+    for (i = 0; i < sp->len; ++i) {
+	for (c = 0; c < sp->sz; ++c) {
+	    v = sp->waa[c*sp->len + i] + bt->bias;
+	    bt->t[64*i + (c < 16 ? c : c + 16)] = v;
+	    bt->t[64*i + (c < 16 ? c + 16 : c + 32)] = v;
+	}
+    }
+    return 1;
+}
+
+/*
+  batch_sse2 scores the n <= 16 targets B (of lengths N, the longest
+  first) in the lanes of one vector and stores the raw 8-bit scores, or
+  -1 for a target that saturated, in scores.
+ */
+static void
+batch_sse2(batch_Table * bt, unsigned char ** B, int * N, int n, int * scores)
+{
+    int M = bt->len;
+    __m128i vZero = _mm_setzero_si128();
+    __m128i vBias = _mm_set1_epi8((char) bt->bias);
+    __m128i vGapO = _mm_set1_epi8((char) bt->gapo);
+    __m128i vGapE = _mm_set1_epi8((char) bt->gape);
+    __m128i vMax = vZero;
+    __m128i vH, vE, vF, vT, vDiag;
+    __m128i * pvH, * pvE;
+    unsigned char r[16];
+    unsigned char s[16] __attribute__((aligned(16)));
+    unsigned char * ti;
+    int i, j, k;
+
+    pvH = (__m128i *) batch_alloc(2*M*sizeof(__m128i));
+    pvE = pvH + M;
+    for (k = n; k < 16; ++k)
+	r[k] = bt->sz;
+
+    for (j = 0; j < N[0]; ++j) {
+	for (k = 0; k < n; ++k)
+	    r[k] = j < N[k] ? B[k][j] : bt->sz;
+	vF = vDiag = vZero;
+	for (i = 0, ti = bt->t; i < M; ++i, ti += 64) {
+	    for (k = 0; k < 16; ++k)
+		s[k] = ti[r[k] < 16 ? r[k] : r[k] + 16];
+	    vH = _mm_adds_epu8(vDiag, _mm_load_si128((__m128i *) s));
+	    vH = _mm_subs_epu8(vH, vBias);
+	    vE = pvE[i];
+	    vH = _mm_max_epu8(vH, vE);
+	    vH = _mm_max_epu8(vH, vF);
+	    vDiag = pvH[i];
+	    pvH[i] = vH;
+	    vMax = _mm_max_epu8(vMax, vH);
+	    vT = _mm_subs_epu8(vH, vGapO);
+	    pvE[i] = _mm_max_epu8(_mm_subs_epu8(vE, vGapE), vT);
+	    vF = _mm_max_epu8(_mm_subs_epu8(vF, vGapE), vT);
+	}
+    }
+    free(pvH);
+
+    _mm_storeu_si128((__m128i *) s, vMax);
+    for (k = 0; k < n; ++k)
+	scores[k] = s[k] + bt->bias >= 255 ? -1 : s[k];
+}
+
+#ifdef DPALIGN_AVX2
+__attribute__((target("avx2")))
+static void
+batch_avx2(batch_Table * bt, unsigned char ** B, int * N, int n, int * scores)
+{
+    int M = bt->len;
+    __m256i vZero = _mm256_setzero_si256();
+    __m256i vBias = _mm256_set1_epi8((char) bt->bias);
+    __m256i vGapO = _mm256_set1_epi8((char) bt->gapo);
+    __m256i vGapE = _mm256_set1_epi8((char) bt->gape);
+    __m256i v15 = _mm256_set1_epi8(15);
+    __m256i vMax = vZero;
+    __m256i vH, vE, vF, vT, vDiag, vR, vHigh, vS;
+    __m256i * pvH, * pvE, * pt;
+    unsigned char r[32] __attribute__((aligned(32)));
+    int i, j, k;
+
+    pvH = (__m256i *) batch_alloc(2*M*sizeof(__m256i));
+    pvE = pvH + M;
+    for (k = n; k < 32; ++k)
+	r[k] = bt->sz;
+
+    for (j = 0; j < N[0]; ++j) {
+	for (k = 0; k < n; ++k)
+	    r[k] = j < N[k] ? B[k][j] : bt->sz;
+	vR = _mm256_load_si256((__m256i *) r);
+	vHigh = _mm256_cmpgt_epi8(vR, v15);
+	vF = vDiag = vZero;
+	for (i = 0, pt = (__m256i *) bt->t; i < M; ++i, pt += 2) {
+	    vS = _mm256_blendv_epi8(_mm256_shuffle_epi8(pt[0], vR), _mm256_shuffle_epi8(pt[1], vR), vHigh);
+	    vH = _mm256_adds_epu8(vDiag, vS);
+	    vH = _mm256_subs_epu8(vH, vBias);
+	    vE = pvE[i];
+	    vH = _mm256_max_epu8(vH, vE);
+	    vH = _mm256_max_epu8(vH, vF);
+	    vDiag = pvH[i];
+	    pvH[i] = vH;
+	    vMax = _mm256_max_epu8(vMax, vH);
+	    vT = _mm256_subs_epu8(vH, vGapO);
+	    pvE[i] = _mm256_max_epu8(_mm256_subs_epu8(vE, vGapE), vT);
+	    vF = _mm256_max_epu8(_mm256_subs_epu8(vF, vGapE), vT);
+	}
+    }
+    free(pvH);
+
+    _mm256_store_si256((__m256i *) r, vMax);
+    for (k = 0; k < n; ++k)
+	scores[k] = r[k] + bt->bias >= 255 ? -1 : r[k];
+}
+#endif /* DPALIGN_AVX2 */
+
+typedef struct _batch_Order {
+    int len; /* length of target */
+    int t; /* index of target */
+} batch_Order;
+
+/* longest targets first, ties in input order */
+static int
+batch_cmp(const void * a, const void * b)
+{
+    const batch_Order * x = (const batch_Order *) a;
+    const batch_Order * y = (const batch_Order *) b;
+
+    return x->len != y->len ? y->len - x->len : x->t - y->t;
+}
+
+#endif /* DPALIGN_SSE2 */
+
+/*
+  dpAlign_PhilGreen_Batch scores the n encoded targets B, of lengths N,
+  against the sequence profile sp and puts the optimal local alignment
+  scores in scores, in the order of the targets. The scores are the
+  same as calling dpAlign_PhilGreen_Score on every target.
+ */
+void
+dpAlign_PhilGreen_Batch(dpAlign_SequenceProfile * sp, unsigned char ** B, int * N, int n, int * scores)
+{
+    int t;
+#ifdef DPALIGN_SSE2
+    batch_Table bt;
+    unsigned char * gB[32];
+    int gN[32], gS[32];
+    batch_Order * order;
+    int lanes = 16;
+    int g, i, k, c;
+
+    if (n > 1 && sp->len > 0 && batch_table(sp, &bt)) {
+#ifdef DPALIGN_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	    lanes = 32;
+#endif
+/* targets with residues outside the alphabet are scored one at a time */
+	order = (batch_Order *) malloc(n*sizeof(batch_Order));
+	if (order == NULL)
+	    dpAlign_fatal("Can't allocate memory for batch order!\n");
+	for (t = 0, k = 0; t < n; ++t) {
+	    for (i = 0; i < N[t]; ++i)
+		if (B[t][i] >= bt.sz) break;
+	    if (i < N[t] || N[t] <= 0)
+		scores[t] = dpAlign_PhilGreen_Score(sp, B[t], N[t], NULL);
+	    else {
+		order[k].len = N[t];
+		order[k++].t = t;
+	    }
+	}
+	qsort(order, k, sizeof(batch_Order), batch_cmp);
+
+	for (g = 0; g < k; g += lanes) {
+	    c = k - g < lanes ? k - g : lanes;
+	    for (i = 0; i < c; ++i) {
+		gB[i] = B[order[g+i].t];
+		gN[i] = order[g+i].len;
+	    }
+#ifdef DPALIGN_AVX2
+	    if (lanes == 32)
+		batch_avx2(&bt, gB, gN, c, gS);
+	    else
+#endif
+		batch_sse2(&bt, gB, gN, c, gS);
+	    for (i = 0; i < c; ++i) {
+		t = order[g+i].t;
+		if (gS[i] < 0)
+		    scores[t] = dpAlign_PhilGreen_Score(sp, B[t], N[t], NULL);
+		else
+		    scores[t] = gS[i] > bt.gapo ? gS[i] : 0;
+	    }
+	}
+	free(order);
+	free(bt.t);
+	return;
+    }
+#endif
+    for (t = 0; t < n; ++t)
+	scores[t] = dpAlign_PhilGreen_Score(sp, B[t], N[t], NULL);
+}
@@ -0,0 +1,120 @@
+#include "dpalign.h"
+#include <pthread.h>
+
+/* $Id$ */
+
+/*
+  Sequences are encoded through 256 entry tables that fold lower case
+  into upper case, built once from dna_encode and the BLOSUM62 alphabet,
+  so encoding a residue is one load whatever the residue. An encoded
+  sequence keeps its upper case copy next to the codes, which is what
+  the alignments print, and the string it was made from is left alone.
+ */
+
+static unsigned char dna_table[256];
+static unsigned char protein_table[256];
+static pthread_once_t table_once = PTHREAD_ONCE_INIT;
+
+static void
+encode_tables(void)
+{
+    static const char * aa = "ARNDCQEGHILKMFPSTWYVBZX*";
+    int c, u;
+
+    memset(protein_table, 0, sizeof(protein_table));
+    for (c = 0; c < 256; ++c) {
+	u = upper_case(c);
+	dna_table[c] = (unsigned char) dna_encode(u);
+    }
+    for (c = 0; aa[c] != '\0'; ++c) {
+	protein_table[(unsigned char) aa[c]] = c;
+	if (aa[c] >= 'A' && aa[c] <= 'Z')
+	    protein_table[aa[c] + 0x20] = c;
+    }
+}
+
+/*
+  dpAlign_Encode_Table returns the table that encodes residues of type
+  DPALIGN_DNA or DPALIGN_PROTEIN, lower or upper case.
+ */
+unsigned char *
+dpAlign_Encode_Table(int type)
+{
+    pthread_once(&table_once, encode_tables);
+    return type == DPALIGN_DNA ? dna_table : protein_table;
+}
+
+/*
+  dpAlign_Encode encodes the len residues of seq with the table t into
+  code, and if upper isn't NULL copies them into it in upper case.
+ */
+void
+dpAlign_Encode(char * seq, int len, unsigned char * t, unsigned char * code, char * upper)
+{
+    unsigned char c;
+    int i;
+
+    if (upper == NULL) {
+	for (i = 0; i < len; ++i)
+	    code[i] = t[(unsigned char) seq[i]];
+	return;
+    }
+    for (i = 0; i < len; ++i) {
+	c = seq[i];
+	code[i] = t[c];
+	upper[i] = upper_case(c);
+    }
+}
+
+/*
+  dpAlign_Encode_Sequence encodes the len residues of seq, of type
+  DPALIGN_DNA or DPALIGN_PROTEIN, into the block buf of at least
+  DPALIGN_ENCODED_SIZE(len) bytes and returns the encoded sequence
+  that starts it. Protein is encoded in the BLOSUM62 alphabet; the
+  aligners recode it from the upper case copy when they are given a
+  matrix of another alphabet.
+ */
+dpAlign_EncodedSequence *
+dpAlign_Encode_Sequence(void * buf, char * seq, int len, int type)
+{
+    dpAlign_EncodedSequence * e = (dpAlign_EncodedSequence *) buf;
+
+    if (type != DPALIGN_DNA && type != DPALIGN_PROTEIN)
+	dpAlign_fatal("Unknown sequence type!\n");
+    e->len = len;
+    e->type = type;
+    e->seq = (char *) (e + 1);
+    e->code = (unsigned char *) e->seq + len + 1;
+    dpAlign_Encode(seq, len, dpAlign_Encode_Table(type), e->code, e->seq);
+    e->seq[len] = '\0';
+    return e;
+}
+
+/*
+  new_dpAlign_EncodedSequence returns the sequence seq of type encoded
+  by dpAlign_Encode_Sequence into a block of its own.
+ */
+dpAlign_EncodedSequence *
+new_dpAlign_EncodedSequence(char * seq, int type)
+{
+    void * buf;
+    int len;
+
+    if (seq == NULL)
+	dpAlign_fatal("Sequence is a NULL pointer!\n");
+    len = strlen(seq);
+    buf = malloc(DPALIGN_ENCODED_SIZE(len));
+    if (buf == NULL)
+	dpAlign_fatal("Can't allocate memory for encoded sequence!\n");
+    return dpAlign_Encode_Sequence(buf, seq, len, type);
+}
+
+/*
+  free_dpAlign_EncodedSequence releases a sequence created by
+  new_dpAlign_EncodedSequence.
+ */
+void
+free_dpAlign_EncodedSequence(dpAlign_EncodedSequence * e)
+{
+    free(e);
+}
@@ -0,0 +1,149 @@
+#include "dpalign.h"
+#include <pthread.h>
+
+/* $Id$ */
+
+/*
+  Scoring matrices are kept as one block each: the scores and the row
+  pointers the Gotoh loops index with s[A[i]]. Every row is padded to a
+  multiple of 16 cells, a 64 byte cache line, and starts on a 64 byte
+  boundary.
+
+  The IUPAC DNA matrices are interned by match and mismatch and
+  BLOSUM62 by name, so an aligner call only looks its matrix up. Those
+  are built the first time they are asked for and live as long as the
+  process; there is one per distinct pair of scores, which in practice
+  is a handful.
+ */
+
+#define MATRIX_ALIGN 64
+
+typedef struct _matrix_Entry {
+    dpAlign_Matrix * m;
+    int match;
+    int mismatch;
+    struct _matrix_Entry * next;
+} matrix_Entry;
+
+static matrix_Entry * dna_matrices = NULL;
+static dpAlign_Matrix * blosum_matrix = NULL;
+static pthread_mutex_t matrix_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+  new_dpAlign_Matrix returns an all zero matrix for an alphabet of sz
+  residues.
+ */
+dpAlign_Matrix *
+new_dpAlign_Matrix(int sz)
+{
+    dpAlign_Matrix * m;
+    size_t cells, need;
+    char * p = NULL;
+    int i;
+
+    m = (dpAlign_Matrix *) malloc(sizeof(dpAlign_Matrix));
+    if (m == NULL)
+	dpAlign_fatal("Can't allocate memory for scoring matrix!\n");
+    m->sz = sz;
+    m->stride = (sz + 15) & ~15;
+    cells = (size_t) (sz > 0 ? sz : 1) * m->stride;
+    need = cells*sizeof(int) + (sz + 1)*sizeof(int *);
+    if (posix_memalign((void **) &p, MATRIX_ALIGN, need) != 0)
+	dpAlign_fatal("Can't allocate memory for scoring matrix!\n");
+    memset(p, 0, need);
+    m->s32 = (int *) p;
+    m->s = (int **) (m->s32 + cells);
+    for (i = 0; i < sz; ++i)
+	m->s[i] = m->s32 + (size_t) i*m->stride;
+    return m;
+}
+
+/* free_dpAlign_Matrix releases a matrix from new_dpAlign_Matrix */
+void
+free_dpAlign_Matrix(dpAlign_Matrix * m)
+{
+    if (m == NULL)
+	return;
+    free(m->s32);
+    free(m);
+}
+
+/*
+  dpAlign_Matrix_Set sets the score of residue i against residue j to
+  val in the matrix m.
+ */
+void
+dpAlign_Matrix_Set(dpAlign_Matrix * m, int i, int j, int val)
+{
+    m->s32[(size_t) i*m->stride + j] = val;
+}
+
+/* dna_score is the IUPAC score of code i against code j of dna_encode */
+static int
+dna_score(int i, int j, int match, int mismatch)
+{
+    if (i == 16 || j == 16) return mismatch; /* X mismatches all */
+    else if (i == 15 || j == 15) return match; /* N matches all but X */
+    else if (i == 14 && j != 0 || i != 0 && j == 14) return match; /* B is not A */
+    else if (i == 13 && j != 3 && j != 4 || i != 3 && i != 4 && j == 13) return match; /* V is not T/U */
+    else if (i == 12 && j != 2 || i != 2 && j == 12) return match; /* H is not G */
+    else if (i == 11 && j != 1 || i != 1 && j == 11) return match; /* D is not C */
+    else if (i == 10 && j != 0 && j != 1 && j != 7 || i != 0 && i != 1 && i != 7 && j == 10) return match; /* K is not A/C/M */
+    else if (i == 9 && j != 0 && j != 3 && j != 4 && j != 8 || i != 0 && i != 3 && i != 4 && i != 8 && j == 9) return match; /* S is not T/U/A/W */
+    else if (i == 8 && j != 1 && j != 2 && j != 9 || i != 1 && i != 2 && i != 9 && j == 10) return match; /* W is not G/C/S */
+    else if (i == 7 && j != 2 && j != 3 && j != 4 && j != 10 || i != 2 && i != 3 && i != 4 && i != 10 && j == 7) return match; /* M is not T/U/G/K */
+    else if (i == 3 && j == 4 || i == 4 && j == 3) return match; /* T matches U */
+    else if (i == j) return match;
+    return mismatch;
+}
+
+/*
+  dpAlign_DNA_Matrix returns the IUPAC DNA scoring matrix for match and
+  mismatch. It is shared; don't change or free it.
+ */
+dpAlign_Matrix *
+dpAlign_DNA_Matrix(int match, int mismatch)
+{
+    matrix_Entry * e;
+    int i, j;
+
+    pthread_mutex_lock(&matrix_lock);
+    for (e = dna_matrices; e != NULL; e = e->next)
+	if (e->match == match && e->mismatch == mismatch)
+	    break;
+    if (e == NULL) {
+	e = (matrix_Entry *) malloc(sizeof(matrix_Entry));
+	if (e == NULL)
+	    dpAlign_fatal("Can't allocate memory for scoring matrix!\n");
+	e->m = new_dpAlign_Matrix(17);
+	for (i = 0; i < 17; ++i)
+	    for (j = 0; j < 17; ++j)
+		dpAlign_Matrix_Set(e->m, i, j, dna_score(i, j, match, mismatch));
+	e->match = match;
+	e->mismatch = mismatch;
+	e->next = dna_matrices;
+	dna_matrices = e;
+    }
+    pthread_mutex_unlock(&matrix_lock);
+    return e->m;
+}
+
+/*
+  dpAlign_Blosum62_Matrix returns the BLOSUM62 scoring matrix used when
+  no matrix is given. It is shared; don't change or free it.
+ */
+dpAlign_Matrix *
+dpAlign_Blosum62_Matrix(void)
+{
+    int i, j;
+
+    pthread_mutex_lock(&matrix_lock);
+    if (blosum_matrix == NULL) {
+	blosum_matrix = new_dpAlign_Matrix(24);
+	for (i = 0; i < 24; ++i)
+	    for (j = 0; j < 24; ++j)
+		dpAlign_Matrix_Set(blosum_matrix, i, j, blosum62[i][j]);
+    }
+    pthread_mutex_unlock(&matrix_lock);
+    return blosum_matrix;
+}
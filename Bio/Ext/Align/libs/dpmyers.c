@@ -0,0 +1,188 @@
+#include "dpalign.h"
+#include <stdint.h>
+
+/* $Id$ */
+
+/*
+  Unit cost (edit distance) alignment of DNA with Myers' bit-vector
+  algorithm, "A fast bit-vector algorithm for approximate string
+  matching based on dynamic programming" (JACM 46:395, 1999), in the
+  block form of Hyyro's "A bit-vector algorithm for computing
+  Levenshtein and Damerau edit distances" (2003).
+
+  Sequence 1 is the pattern and runs down the columns of the dynamic
+  programming matrix in blocks of 64 rows, each column of a block being
+  held as two words: Pv has bit r set if the cell in row r+1 is one
+  more than the cell above it, Mv if it is one less. A column is worked
+  out from the previous one with a dozen word operations per block, the
+  horizontal difference at the bottom of a block carrying into the next
+  one.
+
+  Which residues match is taken from the IUPAC DNA scoring matrix of the
+  Gotoh aligners: pattern position i matches text symbol c if
+  s[A[i]][c] is positive. Eq[c] holds those positions as a bit mask, so
+  ambiguity codes cost nothing extra.
+
+  For the traceback every column is kept, which takes about 20 bytes
+  per 64 cells of the matrix. That is fine for the barcodes, primers and
+  reads this is meant for, but long sequences are better aligned with
+  the affine Miller-Myers aligners, which need linear space.
+ */
+
+#define MYERS_SYMBOLS 18 /* the 17 codes of dna_encode and one for anything else */
+
+typedef struct _myers_Matrix {
+    uint64_t * pv; /* pv[j*blocks+b] is Pv of block b in column j */
+    uint64_t * mv; /* likewise Mv */
+    int * bot; /* bot[j*blocks+b] is the cell below the last row of block b */
+    uint64_t * eq; /* eq[c*blocks+b] is Eq of symbol c in block b */
+    int blocks;
+    int mode;
+} myers_Matrix;
+
+/* the symbol of code c of dna_encode, anything unknown is one symbol */
+#define myers_symbol(c) ((c) < MYERS_SYMBOLS - 1 ? (c) : MYERS_SYMBOLS - 1)
+
+/*
+  myers_block works out block (pv, mv) of the next column, given the
+  block's match mask eq and the difference hin in {-1, 0, 1} between
+  the cell above the block and the one to its left. It returns the
+  difference at the bottom row of the block.
+ */
+static int
+myers_block(uint64_t * pv, uint64_t * mv, uint64_t eq, int hin)
+{
+    uint64_t Pv = *pv, Mv = *mv;
+    uint64_t Xv, Xh, Ph, Mh;
+    int hout;
+
+    Xv = eq | Mv;
+    if (hin < 0)
+	eq |= 1;
+    Xh = (((eq & Pv) + Pv) ^ Pv) | eq;
+    Ph = Mv | ~(Xh | Pv);
+    Mh = Pv & Xh;
+    hout = (int) (Ph >> 63) - (int) (Mh >> 63);
+    Ph <<= 1;
+    Mh <<= 1;
+    if (hin < 0)
+	Mh |= 1;
+    else if (hin > 0)
+	Ph |= 1;
+    *pv = Mh | ~(Xv | Ph);
+    *mv = Ph & Xv;
+    return hout;
+}
+
+/* the cell in row i and column j of the matrix mx */
+static int
+myers_cell(myers_Matrix * mx, int i, int j)
+{
+    int b, r;
+    uint64_t below;
+
+    if (i == 0)
+	return mx->mode == DPALIGN_MYERS_SEMIGLOBAL ? 0 : j;
+    b = (i - 1) / 64;
+    r = (i - 1) % 64;
+    below = r == 63 ? 0 : ~(uint64_t) 0 << (r + 1);
+    return mx->bot[j*mx->blocks + b]
+	- __builtin_popcountll(mx->pv[j*mx->blocks + b] & below)
+	+ __builtin_popcountll(mx->mv[j*mx->blocks + b] & below);
+}
+
+/*
+  myers_align aligns the M codes of A against the N codes of B at unit
+  cost, a residue of A matching one of B where the scoring matrix s is
+  positive. With DPALIGN_MYERS_GLOBAL all of both sequences are
+  aligned; with DPALIGN_MYERS_SEMIGLOBAL all of A is aligned to any
+  stretch of B; with DPALIGN_MYERS_PREFIX all of A is aligned to a
+  prefix of B. The gaps are put in spc1 and spc2 as align does, with
+  spc2 counting from the start of B, and *start2 and *end2 are set to
+  the stretch of B aligned. It returns the edit distance.
+ */
+int
+myers_align(unsigned char * A, unsigned char * B, int M, int N, int ** s, int mode, int * spc1, int * spc2, int * start2, int * end2, dpAlign_Workspace * ws)
+{
+    myers_Matrix matrix, * mx = &matrix;
+    int blocks = (M + 63) / 64;
+    size_t cols = (size_t) (N + 1) * blocks;
+    size_t need;
+    char * buf;
+    int i, j, b, c, hin, cost, d, best, jbest;
+    int top = mode == DPALIGN_MYERS_SEMIGLOBAL ? 0 : 1;
+
+/* the columns, the bottom cells and the match masks in one buffer */
+    need = 2*cols*sizeof(uint64_t) + MYERS_SYMBOLS*blocks*sizeof(uint64_t) + cols*sizeof(int);
+    buf = (char *) dpAlign_Workspace_Buffer(&ws->bits, &ws->bitsz, need);
+    mx->pv = (uint64_t *) buf;
+    mx->mv = mx->pv + cols;
+    mx->eq = mx->mv + cols;
+    mx->bot = (int *) (mx->eq + MYERS_SYMBOLS*blocks);
+    mx->blocks = blocks;
+    mx->mode = mode;
+
+    memset(mx->eq, 0, MYERS_SYMBOLS*blocks*sizeof(uint64_t));
+    for (i = 0; i < M; ++i) {
+	if (A[i] >= MYERS_SYMBOLS - 1)
+	    continue;
+	for (c = 0; c < MYERS_SYMBOLS - 1; ++c)
+	    if (s[A[i]][c] > 0)
+		mx->eq[c*blocks + i/64] |= (uint64_t) 1 << (i % 64);
+    }
+
+/* column 0 goes up by one every row */
+    for (b = 0; b < blocks; ++b) {
+	mx->pv[b] = ~(uint64_t) 0;
+	mx->mv[b] = 0;
+	mx->bot[b] = 64*(b + 1);
+    }
+    best = M;
+    jbest = 0;
+    for (j = 1; j <= N; ++j) {
+	c = myers_symbol(B[j-1]);
+	hin = top;
+	for (b = 0; b < blocks; ++b) {
+	    mx->pv[j*blocks + b] = mx->pv[(j-1)*blocks + b];
+	    mx->mv[j*blocks + b] = mx->mv[(j-1)*blocks + b];
+	    hin = myers_block(&mx->pv[j*blocks + b], &mx->mv[j*blocks + b], mx->eq[c*blocks + b], hin);
+	    mx->bot[j*blocks + b] = mx->bot[(j-1)*blocks + b] + hin;
+	}
+	if (mode != DPALIGN_MYERS_GLOBAL && (d = myers_cell(mx, M, j)) < best) {
+	    best = d;
+	    jbest = j;
+	}
+    }
+    if (mode == DPALIGN_MYERS_GLOBAL) {
+	best = myers_cell(mx, M, N);
+	jbest = N;
+    }
+
+/* trace the path back, taking a diagonal step whenever it is optimal */
+    i = M;
+    j = jbest;
+    d = best;
+    while (i > 0 || (j > 0 && mode != DPALIGN_MYERS_SEMIGLOBAL)) {
+	if (i > 0 && j > 0) {
+	    c = myers_symbol(B[j-1]);
+	    cost = mx->eq[c*blocks + (i-1)/64] >> ((i-1) % 64) & 1 ? 0 : 1;
+	    if (myers_cell(mx, i-1, j-1) + cost == d) {
+		d -= cost;
+		--i;
+		--j;
+		continue;
+	    }
+	}
+	if (i > 0 && myers_cell(mx, i-1, j) + 1 == d) {
+	    ++spc2[j];
+	    --i;
+	} else {
+	    ++spc1[i];
+	    --j;
+	}
+	--d;
+    }
+    *start2 = j + 1;
+    *end2 = jbest;
+    return best;
+}
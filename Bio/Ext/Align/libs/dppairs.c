@@ -0,0 +1,365 @@
+#include "dpalign.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/* $Id$ */
+
+/*
+  Many pairs aligned in one call. The pairs are cut into chunks that
+  are spawned as tasks of the shared pool (see dppool.c), every chunk
+  aligning its pairs one after the other through one workspace of its
+  own, so a batch of short pairs costs one allocation of rows per chunk
+  rather than per pair. Every pair is aligned serially by the same
+  aligner a single call would use; the parallelism is across the pairs.
+
+  A pair can also be submitted as a job that is aligned by the pool in
+  the background while the caller goes on, who later polls or waits for
+  it. Every finished job writes a byte to a pipe shared by all jobs, so
+  an event loop can watch one file descriptor instead of polling.
+ */
+
+#define PAIRS_CHUNKS 8 /* chunks per thread, so that uneven pairs even out */
+
+typedef struct _pairs_Batch {
+    dpAlign_EncodedSequence ** s1;
+    dpAlign_EncodedSequence ** s2;
+    int type; /* DPALIGN_DNA or DPALIGN_PROTEIN */
+    int match, mismatch, gap, ext; /* DNA scores */
+    dpAlign_ScoringMatrix * matrix; /* protein scores */
+    int alg; /* as the alg of Align_DNA_Sequences or Align_Protein_Sequences */
+    int output; /* DPALIGN_OUTPUT_* flags */
+    dpAlign_AlignOutput ** out;
+} pairs_Batch;
+
+typedef struct _pairs_Chunk {
+    dpAlign_Task task;
+    pairs_Batch * b;
+    int from; /* first pair of the chunk */
+    int to; /* one past its last pair */
+} pairs_Chunk;
+
+/* pairs_align aligns pair i of b through the workspace ws */
+static dpAlign_AlignOutput *
+pairs_align(pairs_Batch * b, int i, dpAlign_Workspace * ws)
+{
+    dpAlign_EncodedSequence * e1 = b->s1[i], * e2 = b->s2[i];
+
+    if (b->type == DPALIGN_DNA) {
+	switch (b->alg) {
+	case 2:
+	    return dpAlign_Global_DNA_MillerMyers(e1, e2, b->match, b->mismatch, b->gap, b->ext, 1, ws);
+	case 3:
+	    return dpAlign_EndsFree_DNA_MillerMyers(e1, e2, b->match, b->mismatch, b->gap, b->ext, 1, ws);
+	case 4:
+	    return dpAlign_Global_DNA_MillerMyers_Banded(e1, e2, b->match, b->mismatch, b->gap, b->ext, ws);
+	case 5:
+	    return dpAlign_DNA_Myers(e1, e2, DPALIGN_MYERS_GLOBAL, ws);
+	case 6:
+	    return dpAlign_DNA_Myers(e1, e2, DPALIGN_MYERS_SEMIGLOBAL, ws);
+	case 7:
+	    return dpAlign_DNA_Myers(e1, e2, DPALIGN_MYERS_PREFIX, ws);
+	default:
+	    return dpAlign_Local_DNA_MillerMyers(e1, e2, b->match, b->mismatch, b->gap, b->ext, 1, ws);
+	}
+    }
+    switch (b->alg) {
+    case 2:
+	return dpAlign_Global_Protein_MillerMyers(e1, e2, b->matrix, 1, ws);
+    case 3:
+	return dpAlign_EndsFree_Protein_MillerMyers(e1, e2, b->matrix, 1, ws);
+    case 4:
+	return dpAlign_Global_Protein_MillerMyers_Banded(e1, e2, b->matrix, ws);
+    default:
+	return dpAlign_Local_Protein_MillerMyers(e1, e2, b->matrix, 1, ws);
+    }
+}
+
+static void
+pairs_run(void * arg)
+{
+    pairs_Chunk * c = (pairs_Chunk *) arg;
+    dpAlign_Workspace * ws;
+    int i;
+
+    ws = new_dpAlign_Workspace();
+    ws->output = c->b->output;
+    for (i = c->from; i < c->to; ++i)
+	c->b->out[i] = pairs_align(c->b, i, ws);
+    free_dpAlign_Workspace(ws);
+}
+
+/*
+  pairs_batch aligns the n pairs of b, on threads threads of the shared
+  pool, or dpAlign_get_threads() of them if threads is 0.
+ */
+static void
+pairs_batch(pairs_Batch * b, int n, int threads)
+{
+    pairs_Chunk one, * c;
+    int chunks, size, i;
+
+    if (threads < 1)
+	threads = dpAlign_get_threads();
+    if (threads <= 1 || n <= 1) {
+	one.b = b;
+	one.from = 0;
+	one.to = n;
+	pairs_run(&one);
+	return;
+    }
+    chunks = threads*PAIRS_CHUNKS < n ? threads*PAIRS_CHUNKS : n;
+    size = (n + chunks - 1)/chunks;
+    chunks = (n + size - 1)/size;
+    c = (pairs_Chunk *) malloc(chunks*sizeof(pairs_Chunk));
+    if (c == NULL)
+	dpAlign_fatal("Can't allocate memory for batch of alignments!\n");
+    for (i = 0; i < chunks; ++i) {
+	c[i].b = b;
+	c[i].from = i*size;
+	c[i].to = c[i].from + size < n ? c[i].from + size : n;
+	c[i].task.run = pairs_run;
+	c[i].task.arg = &c[i];
+	dpAlign_Pool_Spawn(dpAlign_Shared_Pool(threads), &c[i].task);
+    }
+    for (i = 0; i < chunks; ++i)
+	dpAlign_Pool_Wait(dpAlign_Shared_Pool(threads), &c[i].task);
+    free(c);
+}
+
+/*
+  dpAlign_DNA_MillerMyers_Batch aligns the encoded DNA sequences s1[i]
+  and s2[i] for i from 0 to n-1 with the algorithm alg, numbered as
+  for Align_DNA_Sequences, and puts the alignments in out[i]. The
+  alignments have the parts of output (DPALIGN_OUTPUT_* flags, 0 for
+  the gapped strings) and are the same as aligning the pairs one by one.
+  The pairs are spread over threads threads, or dpAlign_get_threads()
+  of them if threads is 0.
+ */
+void
+dpAlign_DNA_MillerMyers_Batch(dpAlign_EncodedSequence ** s1, dpAlign_EncodedSequence ** s2, int n, int match, int mismatch, int gap, int ext, int alg, int threads, int output, dpAlign_AlignOutput ** out)
+{
+    pairs_Batch b;
+
+    memset(&b, 0, sizeof(b));
+    b.s1 = s1;
+    b.s2 = s2;
+    b.type = DPALIGN_DNA;
+    b.match = match;
+    b.mismatch = mismatch;
+    b.gap = gap;
+    b.ext = ext;
+    b.alg = alg;
+    b.output = output;
+    b.out = out;
+    pairs_batch(&b, n, threads);
+}
+
+/*
+  dpAlign_Protein_MillerMyers_Batch is dpAlign_DNA_MillerMyers_Batch
+  for protein sequences scored with matrix, or BLOSUM62 if it is NULL,
+  with alg numbered as for Align_Protein_Sequences.
+ */
+void
+dpAlign_Protein_MillerMyers_Batch(dpAlign_EncodedSequence ** s1, dpAlign_EncodedSequence ** s2, int n, dpAlign_ScoringMatrix * matrix, int alg, int threads, int output, dpAlign_AlignOutput ** out)
+{
+    pairs_Batch b;
+
+    memset(&b, 0, sizeof(b));
+    b.s1 = s1;
+    b.s2 = s2;
+    b.type = DPALIGN_PROTEIN;
+    b.matrix = matrix;
+    b.alg = alg;
+    b.output = output;
+    b.out = out;
+    pairs_batch(&b, n, threads);
+}
+
+struct _dpAlign_Job {
+    dpAlign_Task task;
+    pairs_Batch b;
+    dpAlign_EncodedSequence * s1; /* copies of the pair, owned by the job */
+    dpAlign_EncodedSequence * s2;
+    dpAlign_ScoringMatrix * matrix; /* copy of the protein matrix, NULL for BLOSUM62 */
+    dpAlign_AlignOutput * out; /* the alignment, until it is taken */
+    dpAlign_Pool * pool;
+    int finished; /* set under job_lock once out is there */
+};
+
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t job_once = PTHREAD_ONCE_INIT;
+static int job_pipe[2] = { -1, -1 };
+
+static void
+job_pipe_open(void)
+{
+    int i;
+
+    if (pipe(job_pipe) != 0)
+	dpAlign_fatal("Can't create pipe of alignment jobs!\n");
+    for (i = 0; i < 2; ++i) {
+	fcntl(job_pipe[i], F_SETFL, fcntl(job_pipe[i], F_GETFL) | O_NONBLOCK);
+	fcntl(job_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+}
+
+static void
+job_run(void * arg)
+{
+    dpAlign_Job * job = (dpAlign_Job *) arg;
+    dpAlign_Workspace * ws;
+    char c = 0;
+
+    ws = new_dpAlign_Workspace();
+    ws->output = job->b.output;
+    job->out = pairs_align(&job->b, 0, ws);
+    free_dpAlign_Workspace(ws);
+    pthread_mutex_lock(&job_lock);
+    job->finished = 1;
+    pthread_mutex_unlock(&job_lock);
+/* a full pipe is readable already, so a byte that doesn't fit is no loss */
+    while (write(job_pipe[1], &c, 1) < 0 && errno == EINTR)
+	;
+}
+
+/* job_submit copies the pair e1, e2 into job and queues it on the pool */
+static dpAlign_Job *
+job_submit(dpAlign_Job * job, dpAlign_EncodedSequence * e1, dpAlign_EncodedSequence * e2)
+{
+    int threads = dpAlign_get_threads();
+
+    pthread_once(&job_once, job_pipe_open);
+    job->s1 = new_dpAlign_EncodedSequence(e1->seq, e1->type);
+    job->s2 = new_dpAlign_EncodedSequence(e2->seq, e2->type);
+    job->b.s1 = &job->s1;
+    job->b.s2 = &job->s2;
+    job->out = NULL;
+    job->finished = 0;
+/* at least one pool thread, or nothing would run until the job is waited for */
+    job->pool = dpAlign_Shared_Pool(threads > 1 ? threads : 2);
+    job->task.run = job_run;
+    job->task.arg = job;
+    dpAlign_Pool_Spawn(job->pool, &job->task);
+    return job;
+}
+
+static dpAlign_Job *
+new_Job(void)
+{
+    dpAlign_Job * job;
+
+    job = (dpAlign_Job *) calloc(1, sizeof(dpAlign_Job));
+    if (job == NULL)
+	dpAlign_fatal("Can't allocate memory for alignment job!\n");
+    return job;
+}
+
+/*
+  dpAlign_DNA_MillerMyers_Submit queues the alignment of the encoded DNA
+  sequences e1 and e2, with the arguments of
+  dpAlign_DNA_MillerMyers_Batch, on the shared pool and returns the job
+  at once. The job keeps copies of the sequences, so they can go as soon
+  as this returns.
+ */
+dpAlign_Job *
+dpAlign_DNA_MillerMyers_Submit(dpAlign_EncodedSequence * e1, dpAlign_EncodedSequence * e2, int match, int mismatch, int gap, int ext, int alg, int output)
+{
+    dpAlign_Job * job = new_Job();
+
+    job->b.type = DPALIGN_DNA;
+    job->b.match = match;
+    job->b.mismatch = mismatch;
+    job->b.gap = gap;
+    job->b.ext = ext;
+    job->b.alg = alg;
+    job->b.output = output;
+    job->b.out = &job->out;
+    return job_submit(job, e1, e2);
+}
+
+/*
+  dpAlign_Protein_MillerMyers_Submit is dpAlign_DNA_MillerMyers_Submit
+  for protein sequences scored with matrix, or BLOSUM62 if it is NULL.
+  The job keeps a copy of the matrix too.
+ */
+dpAlign_Job *
+dpAlign_Protein_MillerMyers_Submit(dpAlign_EncodedSequence * e1, dpAlign_EncodedSequence * e2, dpAlign_ScoringMatrix * matrix, int alg, int output)
+{
+    dpAlign_Job * job = new_Job();
+
+    job->b.type = DPALIGN_PROTEIN;
+    job->matrix = matrix != NULL ? copy_dpAlign_ScoringMatrix(matrix) : NULL;
+    job->b.matrix = job->matrix;
+    job->b.alg = alg;
+    job->b.output = output;
+    job->b.out = &job->out;
+    return job_submit(job, e1, e2);
+}
+
+/* dpAlign_Job_Ready returns 1 if the alignment of job is done, or else 0 */
+int
+dpAlign_Job_Ready(dpAlign_Job * job)
+{
+    int ready;
+
+    pthread_mutex_lock(&job_lock);
+    ready = job->finished;
+    pthread_mutex_unlock(&job_lock);
+    return ready;
+}
+
+/*
+  dpAlign_Job_Wait returns once the alignment of job is done, running
+  queued tasks of the pool while it waits.
+ */
+void
+dpAlign_Job_Wait(dpAlign_Job * job)
+{
+    dpAlign_Pool_Wait(job->pool, &job->task);
+}
+
+/*
+  dpAlign_Job_Result waits for job and returns its alignment, which the
+  caller then owns, or NULL if it has been taken already.
+ */
+dpAlign_AlignOutput *
+dpAlign_Job_Result(dpAlign_Job * job)
+{
+    dpAlign_AlignOutput * out;
+
+    dpAlign_Job_Wait(job);
+    out = job->out;
+    job->out = NULL;
+    return out;
+}
+
+/*
+  dpAlign_Job_Fd returns the read end of the pipe every finished job
+  writes a byte to. It is non-blocking; a caller woken by it reads and
+  drops what is there, then asks its jobs whether they are ready.
+ */
+int
+dpAlign_Job_Fd(void)
+{
+    pthread_once(&job_once, job_pipe_open);
+    return job_pipe[0];
+}
+
+/*
+  free_dpAlign_Job waits for job, then releases it together with its
+  alignment if that hasn't been taken.
+ */
+void
+free_dpAlign_Job(dpAlign_Job * job)
+{
+    dpAlign_Job_Wait(job);
+    if (job->out != NULL)
+	free_dpAlign_AlignOutput(job->out);
+    free_dpAlign_EncodedSequence(job->s1);
+    free_dpAlign_EncodedSequence(job->s2);
+    if (job->matrix != NULL)
+	free_dpAlign_ScoringMatrix(job->matrix);
+    free(job);
+}
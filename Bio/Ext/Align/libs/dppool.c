@@ -0,0 +1,212 @@
+#include "dpalign.h"
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+
+/* $Id$ */
+
+/*
+  A small work-stealing task pool for the divide-and-conquer aligners.
+
+  Every thread of the pool, and every outside thread that spawns into
+  it, has a deque of tasks. A thread pushes the tasks it spawns onto the
+  bottom of its own deque and takes work from the bottom as well, so it
+  keeps working on the most recently split (and smallest, still cache
+  warm) subproblems, while idle threads steal from the top of the other
+  deques, where the oldest and biggest tasks are. A thread waiting for
+  a task to finish runs other tasks meanwhile instead of blocking, so
+  waiting never ties up a thread and nested waits can't deadlock.
+
+  The tasks spawned by the aligners are large (see ALIGN_TASK_CELLS in
+  dpalign.c), so all the deques share one lock.
+ */
+
+#define POOL_MAX_THREADS 256
+
+typedef struct _pool_Deque {
+    dpAlign_Task * top; /* oldest task, stolen first */
+    dpAlign_Task * bottom; /* newest task, taken first by the owner */
+} pool_Deque;
+
+struct _dpAlign_Pool {
+    pthread_mutex_t lock;
+    pthread_cond_t wake; /* a task was spawned or finished */
+    pool_Deque dq[POOL_MAX_THREADS+1]; /* dq[0] is shared by outside threads */
+    int started; /* number of pool threads created */
+    int threads; /* number of pool threads running */
+};
+
+static int pool_threads = 1; /* default number of threads of the aligners */
+static dpAlign_Pool * shared_pool = NULL;
+static pthread_mutex_t shared_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread int pool_self = 0; /* deque of this thread */
+
+/* take the newest task of deque self, or else steal the oldest of another */
+static dpAlign_Task *
+pool_take(dpAlign_Pool * pool, int self)
+{
+    pool_Deque * q;
+    dpAlign_Task * t;
+    int i;
+
+    q = &pool->dq[self];
+    if ((t = q->bottom) != NULL) {
+	q->bottom = t->prev;
+	if (q->bottom == NULL)
+	    q->top = NULL;
+	else
+	    q->bottom->next = NULL;
+	return t;
+    }
+    for (i = 1; i <= pool->threads + 1; ++i) {
+	q = &pool->dq[(self + i) % (pool->threads + 1)];
+	if ((t = q->top) != NULL) {
+	    q->top = t->next;
+	    if (q->top == NULL)
+		q->bottom = NULL;
+	    else
+		q->top->prev = NULL;
+	    return t;
+	}
+    }
+    return NULL;
+}
+
+/* run task t with the pool unlocked, then mark it done */
+static void
+pool_run(dpAlign_Pool * pool, dpAlign_Task * t)
+{
+    pthread_mutex_unlock(&pool->lock);
+    t->run(t->arg);
+    pthread_mutex_lock(&pool->lock);
+    t->done = 1;
+    pthread_cond_broadcast(&pool->wake);
+}
+
+static void *
+pool_work(void * arg)
+{
+    dpAlign_Pool * pool = (dpAlign_Pool *) arg;
+    dpAlign_Task * t;
+
+    pthread_mutex_lock(&pool->lock);
+    pool_self = ++pool->threads;
+    for (;;) {
+	if ((t = pool_take(pool, pool_self)) != NULL)
+	    pool_run(pool, t);
+	else
+	    pthread_cond_wait(&pool->wake, &pool->lock);
+    }
+    return NULL;
+}
+
+/*
+  dpAlign_Pool_Spawn queues task t, whose run and arg must be set, to
+  be run by any thread of pool. The caller must wait for it with
+  dpAlign_Pool_Wait.
+ */
+void
+dpAlign_Pool_Spawn(dpAlign_Pool * pool, dpAlign_Task * t)
+{
+    pool_Deque * q;
+
+    pthread_mutex_lock(&pool->lock);
+    q = &pool->dq[pool_self];
+    t->done = 0;
+    t->next = NULL;
+    t->prev = q->bottom;
+    if (q->bottom == NULL)
+	q->top = t;
+    else
+	q->bottom->next = t;
+    q->bottom = t;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+  dpAlign_Pool_Wait returns once task t has been run, running other
+  tasks of pool, quite possibly t itself, while it waits.
+ */
+void
+dpAlign_Pool_Wait(dpAlign_Pool * pool, dpAlign_Task * t)
+{
+    dpAlign_Task * u;
+
+    pthread_mutex_lock(&pool->lock);
+    while (!t->done) {
+	if ((u = pool_take(pool, pool_self)) != NULL)
+	    pool_run(pool, u);
+	else
+	    pthread_cond_wait(&pool->wake, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+  dpAlign_Shared_Pool returns the pool shared by the aligners, started
+  or grown so that it can run threads tasks at once, counting the thread
+  that waits for them. The pool threads live until the process exits.
+ */
+dpAlign_Pool *
+dpAlign_Shared_Pool(int threads)
+{
+    dpAlign_Pool * pool;
+    pthread_t tid;
+
+    if (threads > POOL_MAX_THREADS)
+	threads = POOL_MAX_THREADS;
+    pthread_mutex_lock(&shared_lock);
+    if (shared_pool == NULL) {
+	pool = (dpAlign_Pool *) calloc(1, sizeof(dpAlign_Pool));
+	if (pool == NULL)
+	    dpAlign_fatal("Can't allocate memory for thread pool!\n");
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	shared_pool = pool;
+    }
+    pool = shared_pool;
+    for (; pool->started < threads - 1; ++pool->started) {
+	if (pthread_create(&tid, NULL, pool_work, pool) != 0)
+	    dpAlign_fatal("Can't create thread of thread pool!\n");
+	pthread_detach(tid);
+    }
+/* wait for the new threads to register their deques */
+    pthread_mutex_lock(&pool->lock);
+    while (pool->threads < pool->started) {
+	pthread_mutex_unlock(&pool->lock);
+	sched_yield();
+	pthread_mutex_lock(&pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&shared_lock);
+    return pool;
+}
+
+/*
+  dpAlign_set_threads sets how many threads the aligners may use. A
+  value below 1 means one per online processor. The default is 1, i.e.
+  the aligners run in the calling thread only.
+ */
+void
+dpAlign_set_threads(int threads)
+{
+    if (threads < 1) {
+	threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads < 1)
+	    threads = 1;
+    }
+    if (threads > POOL_MAX_THREADS)
+	threads = POOL_MAX_THREADS;
+    pool_threads = threads;
+}
+
+/*
+  dpAlign_get_threads returns the number of threads set with
+  dpAlign_set_threads.
+ */
+int
+dpAlign_get_threads(void)
+{
+    return pool_threads;
+}
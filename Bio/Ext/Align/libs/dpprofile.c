@@ -0,0 +1,176 @@
+#include "dpalign.h"
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* $Id$ */
+
+/*
+  Sequence profiles saved to a file and mapped back read-only, so that
+  processes scoring against the same long query share one copy of it
+  in the page cache instead of each building their own.
+
+  A file is a profile_Header, the sz rows of len ints of waa and, if
+  the profile has one, its striped copy as written by
+  dpAlign_Striped_Write, each part starting on a 64 byte boundary.
+  It is in the byte order and int size of the machine that saved it;
+  a file from another kind of machine, or with another version of the
+  layout, is refused rather than converted. The striped copy is only
+  used if it was made for the vector width of this CPU, otherwise it is
+  built again from waa.
+ */
+
+#define PROFILE_MAGIC "dpAlign\n" /* first 8 bytes of a profile file */
+#define PROFILE_VERSION 1 /* version of the layout */
+#define PROFILE_ORDER 0x01020304 /* reads back the same on a like machine only */
+
+typedef struct _profile_Header {
+    char magic[8];
+    int version;
+    int order;
+    int type;
+    int len;
+    int sz;
+    int gap;
+    int ext;
+    int a[256];
+    long long waa; /* offset of waa in the file */
+    long long striped; /* offset of the striped copy, 0 if none */
+    long long size; /* size of the file */
+} profile_Header;
+
+/*
+  dpAlign_File_Pad writes zeros to fp up to the next multiple of align
+  bytes from the start of the file. It returns 0, or -1 if writing
+  fails.
+ */
+int
+dpAlign_File_Pad(FILE * fp, int align)
+{
+    long off = ftell(fp);
+
+    if (off < 0)
+	return -1;
+    for (; off % align != 0; ++off)
+	if (putc(0, fp) == EOF)
+	    return -1;
+    return 0;
+}
+
+/*
+  dpAlign_Save_Profile writes the sequence profile sp to the file path
+  for dpAlign_Load_Profile. It returns 0, or -1 if the file can't be
+  written.
+ */
+int
+dpAlign_Save_Profile(dpAlign_SequenceProfile * sp, char * path)
+{
+    profile_Header h;
+    FILE * fp;
+    size_t n = (size_t) sp->sz*sp->len;
+    int err;
+
+    fp = fopen(path, "wb");
+    if (fp == NULL)
+	return -1;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, PROFILE_MAGIC, sizeof(h.magic));
+    h.version = PROFILE_VERSION;
+    h.order = PROFILE_ORDER;
+    h.type = sp->type;
+    h.len = sp->len;
+    h.sz = sp->sz;
+    h.gap = sp->gap;
+    h.ext = sp->ext;
+    memcpy(h.a, sp->a, sizeof(h.a));
+
+/* the header goes in twice, the second time with the offsets */
+    err = fwrite(&h, sizeof(h), 1, fp) != 1 || dpAlign_File_Pad(fp, 64) != 0;
+    if (!err) {
+	h.waa = ftell(fp);
+	err = fwrite(sp->waa, sizeof(int), n, fp) != n;
+    }
+    if (!err && sp->striped != NULL) {
+	err = dpAlign_File_Pad(fp, 64) != 0;
+	if (!err) {
+	    h.striped = ftell(fp);
+	    err = dpAlign_Striped_Write(sp->striped, fp) != 0;
+	}
+    }
+    if (!err) {
+	h.size = ftell(fp);
+	err = fseek(fp, 0, SEEK_SET) != 0 || fwrite(&h, sizeof(h), 1, fp) != 1;
+    }
+    if (fclose(fp) != 0)
+	err = 1;
+    if (err) {
+	unlink(path);
+	return -1;
+    }
+    return 0;
+}
+
+/*
+  dpAlign_Load_Profile maps the sequence profile saved in the file path
+  read-only and returns it, or NULL if the file can't be read or isn't
+  a profile saved by dpAlign_Save_Profile on this kind of machine,
+  including one whose type or alphabet is out of range. It is released
+  with free_dpAlign_SequenceProfile like any other.
+ */
+dpAlign_SequenceProfile *
+dpAlign_Load_Profile(char * path)
+{
+    dpAlign_SequenceProfile * sp;
+    profile_Header * h;
+    struct stat st;
+    char * map;
+    int fd, c;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+	return NULL;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(profile_Header)) {
+	close(fd);
+	return NULL;
+    }
+    map = (char *) mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+	return NULL;
+
+    h = (profile_Header *) map;
+    if (memcmp(h->magic, PROFILE_MAGIC, sizeof(h->magic)) != 0 || h->version != PROFILE_VERSION
+	|| h->order != PROFILE_ORDER || h->size != st.st_size || h->len < 0 || h->sz <= 0 || h->sz > 256
+	|| h->waa < (long long) sizeof(profile_Header) || h->waa % 64 != 0
+	|| h->waa + (long long) h->sz*h->len*sizeof(int) > h->size
+	|| h->striped < 0 || h->striped >= h->size
+	|| (h->type != DPALIGN_DNA && h->type != DPALIGN_PROTEIN)) {
+	munmap(map, st.st_size);
+	return NULL;
+    }
+/* every residue has to index a row of waa */
+    for (c = 0; c < 256; ++c)
+	if (h->a[c] < 0 || h->a[c] >= h->sz) {
+	    munmap(map, st.st_size);
+	    return NULL;
+	}
+
+    sp = (dpAlign_SequenceProfile *) malloc(sizeof(dpAlign_SequenceProfile));
+    if (sp == NULL)
+	dpAlign_fatal("Can't allocate memory for Sequence Profile!\n");
+    sp->waa = (int *) (map + h->waa);
+    sp->gap = h->gap;
+    sp->ext = h->ext;
+    sp->len = h->len;
+    sp->type = h->type;
+    sp->sz = h->sz;
+    memcpy(sp->a, h->a, sizeof(sp->a));
+    sp->map = map;
+    sp->mapsz = st.st_size;
+    sp->striped = NULL;
+    if (h->striped != 0)
+	sp->striped = dpAlign_Striped_Map(sp, map + h->striped, h->size - h->striped);
+    if (sp->striped == NULL)
+	dpAlign_Striped_Profile(sp);
+    return sp;
+}
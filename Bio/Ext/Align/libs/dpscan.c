@@ -0,0 +1,388 @@
+#include "dpalign.h"
+#include <ctype.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/* $Id$ */
+
+/*
+  Database scan of a sequence profile against a FASTA file.
+
+  The calling thread reads the file and cuts it into chunks of records
+  which it hands to a pool of worker threads through a bounded queue, so
+  parsing overlaps with scoring and the memory in use stays bounded
+  however large the file is. Each worker scores its chunks with
+  dpAlign_Local_*_PhilGreen_Batch and keeps the best k hits it has seen
+  in a heap of its own, which grows as hits come in so that a large k
+  costs nothing a small file doesn't fill; the heaps are merged once
+  the file is done.
+
+  Hits are ranked by score and then by their position in the file, so
+  the result doesn't depend on how the chunks were shared out.
+ */
+
+#define SCAN_HEAP_START 64 /* hits a worker's heap starts with room for */
+#define SCAN_CHUNK_SEQS 256 /* most records in a chunk */
+#define SCAN_CHUNK_RESIDUES (1 << 18) /* a chunk is full past this many residues */
+
+typedef struct _scan_Chunk {
+    char ** names; /* record names */
+    char ** seqs; /* record sequences, whitespace removed */
+    int n; /* number of records */
+    long first; /* index in the file of the first record */
+    struct _scan_Chunk * next;
+} scan_Chunk;
+
+typedef struct _scan_Heap {
+    dpAlign_ScanHit * h; /* h[0] is the worst hit kept */
+    int n;
+    int max; /* hits h has room for, grown up to k */
+    int k;
+} scan_Heap;
+
+typedef struct _scan_Queue {
+    pthread_mutex_t lock;
+    pthread_cond_t nonempty;
+    pthread_cond_t nonfull;
+    scan_Chunk * head;
+    scan_Chunk * tail;
+    int n; /* chunks in the queue */
+    int max; /* most chunks queued before the reader waits */
+    int done; /* the reader has reached the end of the file */
+    dpAlign_SequenceProfile * sp;
+} scan_Queue;
+
+typedef struct _scan_Worker {
+    pthread_t tid;
+    scan_Queue * q;
+    scan_Heap heap;
+} scan_Worker;
+
+static void *
+scan_alloc(size_t sz)
+{
+    void * p = malloc(sz > 0 ? sz : 1);
+
+    if (p == NULL)
+	dpAlign_fatal("Can't allocate memory for database scan!\n");
+    return p;
+}
+
+/* is hit x better than hit y? */
+static int
+scan_better(dpAlign_ScanHit * x, dpAlign_ScanHit * y)
+{
+    return x->score != y->score ? x->score > y->score : x->index < y->index;
+}
+
+/* sift the hit at i down a heap ordered worst first */
+static void
+scan_sift(scan_Heap * hp, int i)
+{
+    dpAlign_ScanHit t;
+    int c;
+
+    while ((c = 2*i + 1) < hp->n) {
+	if (c + 1 < hp->n && scan_better(&hp->h[c], &hp->h[c+1]))
+	    ++c;
+	if (!scan_better(&hp->h[i], &hp->h[c]))
+	    break;
+	t = hp->h[i]; hp->h[i] = hp->h[c]; hp->h[c] = t;
+	i = c;
+    }
+}
+
+/*
+  scan_offer keeps hit in the heap if it is among the best k seen so far
+  and returns 1, otherwise it returns 0 and the caller keeps the name.
+ */
+static int
+scan_offer(scan_Heap * hp, dpAlign_ScanHit * hit)
+{
+    int i, p;
+
+    if (hp->n < hp->k) {
+	if (hp->n == hp->max) {
+	    hp->max = hp->max < hp->k/2 ? 2*hp->max : hp->k;
+	    hp->h = (dpAlign_ScanHit *) realloc(hp->h, hp->max*sizeof(dpAlign_ScanHit));
+	    if (hp->h == NULL)
+		dpAlign_fatal("Can't allocate memory for database scan!\n");
+	}
+	i = hp->n++;
+	while (i > 0 && scan_better(&hp->h[p = (i - 1)/2], hit)) {
+	    hp->h[i] = hp->h[p];
+	    i = p;
+	}
+	hp->h[i] = *hit;
+	return 1;
+    }
+    if (!scan_better(hit, &hp->h[0]))
+	return 0;
+    free(hp->h[0].name);
+    hp->h[0] = *hit;
+    scan_sift(hp, 0);
+    return 1;
+}
+
+static void
+free_scan_Chunk(scan_Chunk * c)
+{
+    int i;
+
+    for (i = 0; i < c->n; ++i)
+	free(c->seqs[i]);
+    free(c->names);
+    free(c->seqs);
+    free(c);
+}
+
+static scan_Chunk *
+new_scan_Chunk(long first)
+{
+    scan_Chunk * c = (scan_Chunk *) scan_alloc(sizeof(scan_Chunk));
+
+    c->names = (char **) scan_alloc(SCAN_CHUNK_SEQS*sizeof(char *));
+    c->seqs = (char **) scan_alloc(SCAN_CHUNK_SEQS*sizeof(char *));
+    c->n = 0;
+    c->first = first;
+    c->next = NULL;
+    return c;
+}
+
+static void
+scan_push(scan_Queue * q, scan_Chunk * c)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->n >= q->max)
+	pthread_cond_wait(&q->nonfull, &q->lock);
+    if (q->tail == NULL)
+	q->head = c;
+    else
+	q->tail->next = c;
+    q->tail = c;
+    ++q->n;
+    pthread_cond_signal(&q->nonempty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/* returns NULL once the queue is empty and the reader is done */
+static scan_Chunk *
+scan_pop(scan_Queue * q)
+{
+    scan_Chunk * c;
+
+    pthread_mutex_lock(&q->lock);
+    while (q->head == NULL && !q->done)
+	pthread_cond_wait(&q->nonempty, &q->lock);
+    c = q->head;
+    if (c != NULL) {
+	q->head = c->next;
+	if (q->head == NULL)
+	    q->tail = NULL;
+	--q->n;
+	pthread_cond_signal(&q->nonfull);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return c;
+}
+
+static void *
+scan_work(void * arg)
+{
+    scan_Worker * w = (scan_Worker *) arg;
+    scan_Chunk * c;
+    dpAlign_ScanHit hit;
+    int scores[SCAN_CHUNK_SEQS];
+    int i;
+
+    while ((c = scan_pop(w->q)) != NULL) {
+	if (w->q->sp->type == DPALIGN_DNA)
+	    dpAlign_Local_DNA_PhilGreen_Batch(w->q->sp, c->seqs, c->n, scores);
+	else
+	    dpAlign_Local_Protein_PhilGreen_Batch(w->q->sp, c->seqs, c->n, scores);
+	for (i = 0; i < c->n; ++i) {
+	    hit.name = c->names[i];
+	    hit.score = scores[i];
+	    hit.index = c->first + i;
+	    if (!scan_offer(&w->heap, &hit))
+		free(c->names[i]);
+	}
+	free_scan_Chunk(c);
+    }
+    return NULL;
+}
+
+/* best first */
+static int
+scan_cmp(const void * a, const void * b)
+{
+    dpAlign_ScanHit * x = (dpAlign_ScanHit *) a;
+    dpAlign_ScanHit * y = (dpAlign_ScanHit *) b;
+
+    return scan_better(x, y) ? -1 : scan_better(y, x) ? 1 : 0;
+}
+
+/* the name of a record is the first word of its header line */
+static char *
+scan_name(char * line)
+{
+    char * p, * name;
+    size_t n;
+
+    for (p = line + 1; *p != '\0' && isspace((unsigned char) *p); ++p)
+	;
+    for (n = 0; p[n] != '\0' && !isspace((unsigned char) p[n]); ++n)
+	;
+    name = (char *) scan_alloc(n + 1);
+    memcpy(name, p, n);
+    name[n] = '\0';
+    return name;
+}
+
+/*
+  dpAlign_Scan_Fasta scores every record of the FASTA file path against
+  the sequence profile sp with threads worker threads (one per online
+  processor if threads < 1) and puts the k best hits, best first, in a
+  newly allocated array in *hits. It returns the number of hits, or -1
+  if the file can't be opened. The hits are released with
+  free_dpAlign_ScanHits.
+ */
+int
+dpAlign_Scan_Fasta(dpAlign_SequenceProfile * sp, char * path, int k, int threads, dpAlign_ScanHit ** hits)
+{
+    FILE * fp;
+    scan_Queue q;
+    scan_Worker * w;
+    scan_Chunk * c;
+    char * line = NULL;
+    size_t linecap = 0;
+    ssize_t linelen;
+    char * seq = NULL;
+    size_t seqlen = 0, seqcap = 0;
+    char * name = NULL;
+    long nrec = 0;
+    long residues = 0;
+    int i, j, n;
+    dpAlign_ScanHit * out;
+
+    if (sp == NULL)
+	dpAlign_fatal("Sequence profile is a NULL pointer!\n");
+    if (k < 1)
+	dpAlign_fatal("Number of hits to keep must be positive!\n");
+    if ((fp = fopen(path, "r")) == NULL)
+	return -1;
+    if (threads < 1) {
+	threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads < 1)
+	    threads = 1;
+    }
+
+    pthread_mutex_init(&q.lock, NULL);
+    pthread_cond_init(&q.nonempty, NULL);
+    pthread_cond_init(&q.nonfull, NULL);
+    q.head = q.tail = NULL;
+    q.n = 0;
+    q.max = 2*threads;
+    q.done = 0;
+    q.sp = sp;
+
+    w = (scan_Worker *) scan_alloc(threads*sizeof(scan_Worker));
+    for (i = 0; i < threads; ++i) {
+	w[i].q = &q;
+	w[i].heap.max = k < SCAN_HEAP_START ? k : SCAN_HEAP_START;
+	w[i].heap.h = (dpAlign_ScanHit *) scan_alloc(w[i].heap.max*sizeof(dpAlign_ScanHit));
+	w[i].heap.n = 0;
+	w[i].heap.k = k;
+	if (pthread_create(&w[i].tid, NULL, scan_work, &w[i]) != 0)
+	    dpAlign_fatal("Can't create database scan thread!\n");
+    }
+
+    c = new_scan_Chunk(0);
+    for (;;) {
+	linelen = getline(&line, &linecap, fp);
+	if (linelen < 0 || line[0] == '>') {
+/* finish the previous record */
+	    if (name != NULL) {
+		seq = (char *) realloc(seq, seqlen + 1);
+		if (seq == NULL)
+		    dpAlign_fatal("Can't allocate memory for database scan!\n");
+		seq[seqlen] = '\0';
+		c->names[c->n] = name;
+		c->seqs[c->n++] = seq;
+		residues += seqlen;
+		++nrec;
+		if (c->n == SCAN_CHUNK_SEQS || residues >= SCAN_CHUNK_RESIDUES) {
+		    scan_push(&q, c);
+		    c = new_scan_Chunk(nrec);
+		    residues = 0;
+		}
+		seq = NULL;
+		seqlen = seqcap = 0;
+		name = NULL;
+	    }
+	    if (linelen < 0)
+		break;
+	    name = scan_name(line);
+	    continue;
+	}
+	if (name == NULL)
+	    continue; /* text before the first header */
+	if (seqlen + linelen + 1 > seqcap) {
+	    seqcap = 2*(seqlen + linelen + 1);
+	    seq = (char *) realloc(seq, seqcap);
+	    if (seq == NULL)
+		dpAlign_fatal("Can't allocate memory for database scan!\n");
+	}
+	for (i = 0; i < linelen; ++i)
+	    if (!isspace((unsigned char) line[i]))
+		seq[seqlen++] = line[i];
+    }
+    free(line);
+    fclose(fp);
+    if (c->n > 0)
+	scan_push(&q, c);
+    else
+	free_scan_Chunk(c);
+
+    pthread_mutex_lock(&q.lock);
+    q.done = 1;
+    pthread_cond_broadcast(&q.nonempty);
+    pthread_mutex_unlock(&q.lock);
+
+/* merge the workers' heaps */
+    for (i = 0, n = 0; i < threads; ++i) {
+	pthread_join(w[i].tid, NULL);
+	n += w[i].heap.n;
+    }
+    out = (dpAlign_ScanHit *) scan_alloc(n*sizeof(dpAlign_ScanHit));
+    for (i = 0, n = 0; i < threads; ++i) {
+	for (j = 0; j < w[i].heap.n; ++j)
+	    out[n++] = w[i].heap.h[j];
+	free(w[i].heap.h);
+    }
+    free(w);
+    qsort(out, n, sizeof(dpAlign_ScanHit), scan_cmp);
+    for (i = k; i < n; ++i)
+	free(out[i].name);
+
+    pthread_mutex_destroy(&q.lock);
+    pthread_cond_destroy(&q.nonempty);
+    pthread_cond_destroy(&q.nonfull);
+
+    *hits = out;
+    return n < k ? n : k;
+}
+
+/*
+  free_dpAlign_ScanHits releases the n hits returned by
+  dpAlign_Scan_Fasta.
+ */
+void
+free_dpAlign_ScanHits(dpAlign_ScanHit * hits, int n)
+{
+    int i;
+
+    for (i = 0; i < n; ++i)
+	free(hits[i].name);
+    free(hits);
+}
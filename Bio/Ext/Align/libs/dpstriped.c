@@ -0,0 +1,588 @@
+#include "dpalign.h"
+#include <limits.h>
+
+/* $Id$ */
+
+/*
+  Striped Smith-Waterman score kernels, after Farrar's "Striped
+  Smith-Waterman speeds database searches six times over other SIMD
+  implementations" (Bioinformatics 23:156, 2007).
+
+  The query profile waa of a dpAlign_SequenceProfile is rearranged so that
+  a vector holds query positions i, i+seg, i+2*seg, ... where seg is the
+  number of vectors needed to cover the query. The F (vertical gap) values
+  that cross a segment boundary are fixed up afterwards by the "lazy F"
+  loop, which almost never runs more than once.
+
+  Every target is first scored with 8-bit unsigned saturated lanes. If
+  the score saturates, it is redone with 16-bit signed lanes, and if that
+  saturates too, the scalar pgreen is used. The scores returned are
+  always the same as pgreen's, which remains the reference
+  implementation. The SSE2 and AVX2 kernels are both compiled on x86
+  with gcc or clang and the one to use is picked at run time. Define
+  DPALIGN_NO_SIMD to only build the scalar path, or DPALIGN_NO_AVX2 to
+  leave the AVX2 kernels out.
+ */
+
+#if !defined(DPALIGN_NO_SIMD) && defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#define DPALIGN_SSE2
+#include <emmintrin.h>
+#if !defined(DPALIGN_NO_AVX2) && (__GNUC__ > 4 || defined(__clang__))
+#define DPALIGN_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+typedef struct _dpAlign_StripedProfile {
+    int lanes; /* number of bytes in a vector, 16 for SSE2, 32 for AVX2 */
+    int sz; /* size of alphabet */
+    int len; /* length of query */
+    int gapo; /* cost of the first residue of a gap */
+    int gape; /* cost of every further residue of a gap */
+    int bias; /* added to the 8-bit scores so that none is negative */
+    int seg8; /* vectors per alphabet row of p8 */
+    int seg16; /* vectors per alphabet row of p16 */
+    unsigned char * p8; /* biased 8-bit profile, NULL if it doesn't fit */
+    short * p16; /* 16-bit profile, NULL if it doesn't fit */
+    int mapped; /* p8 and p16 point into a mapped profile file */
+} dpAlign_StripedProfile;
+
+/* a striped profile as saved by dpAlign_Striped_Write */
+typedef struct _striped_Saved {
+    int lanes, sz, len, gapo, gape, bias, seg8, seg16;
+    long long p8; /* offset of p8 from the start of the section, 0 if none */
+    long long p16; /* likewise p16 */
+} striped_Saved;
+
+#ifdef DPALIGN_SSE2
+
+static void *
+striped_alloc(size_t sz)
+{
+    void * p = NULL;
+
+    if (posix_memalign(&p, 32, sz) != 0)
+	dpAlign_fatal("Can't allocate memory for striped profile!\n");
+    memset(p, 0, sz);
+    return p;
+}
+
+/*
+  striped_lanes returns the vector width in bytes of the best kernel
+  this CPU can run.
+ */
+static int
+striped_lanes(void)
+{
+#ifdef DPALIGN_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+	return 32;
+#endif
+    return 16;
+}
+
+static int
+striped_sse2_8(dpAlign_StripedProfile * p, unsigned char * B, int N, void * scratch)
+{
+    int seg = p->seg8;
+    __m128i * prof = (__m128i *) p->p8;
+    __m128i vZero = _mm_setzero_si128();
+    __m128i vBias = _mm_set1_epi8((char) p->bias);
+    __m128i vGapO = _mm_set1_epi8((char) p->gapo);
+    __m128i vGapE = _mm_set1_epi8((char) p->gape);
+    __m128i vMax = vZero;
+    __m128i vH, vE, vF, vT;
+    __m128i * pvHStore, * pvHLoad, * pvE, * pvP, * mem, * tmp;
+    unsigned char m[16];
+    int i, j, k, score;
+
+    mem = (__m128i *) scratch;
+    memset(mem, 0, 3*seg*sizeof(__m128i));
+    pvHStore = mem;
+    pvHLoad = mem + seg;
+    pvE = mem + 2*seg;
+
+    for (j = 0; j < N; ++j) {
+	pvP = prof + B[j]*seg;
+	vF = vZero;
+	vH = _mm_slli_si128(pvHStore[seg-1], 1);
+	tmp = pvHLoad; pvHLoad = pvHStore; pvHStore = tmp;
+	for (i = 0; i < seg; ++i) {
+	    vH = _mm_adds_epu8(vH, pvP[i]);
+	    vH = _mm_subs_epu8(vH, vBias);
+	    vE = pvE[i];
+	    vH = _mm_max_epu8(vH, vE);
+	    vH = _mm_max_epu8(vH, vF);
+	    vMax = _mm_max_epu8(vMax, vH);
+	    pvHStore[i] = vH;
+	    vH = _mm_subs_epu8(vH, vGapO);
+	    vE = _mm_subs_epu8(vE, vGapE);
+	    pvE[i] = _mm_max_epu8(vE, vH);
+	    vF = _mm_subs_epu8(vF, vGapE);
+	    vF = _mm_max_epu8(vF, vH);
+	    vH = pvHLoad[i];
+	}
+/* lazy F: carry the vertical gaps across the segment boundaries */
+	for (k = 0; k < 16; ++k) {
+	    vF = _mm_slli_si128(vF, 1);
+	    for (i = 0; i < seg; ++i) {
+		vH = pvHStore[i];
+		vT = _mm_subs_epu8(vH, vGapO);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(vF, vT), vZero)) == 0xffff)
+		    goto next_column;
+		vH = _mm_max_epu8(vH, vF);
+		vMax = _mm_max_epu8(vMax, vH);
+		pvHStore[i] = vH;
+		pvE[i] = _mm_max_epu8(pvE[i], _mm_subs_epu8(vH, vGapO));
+		vF = _mm_subs_epu8(vF, vGapE);
+	    }
+	}
+    next_column:
+	;
+    }
+
+    _mm_storeu_si128((__m128i *) m, vMax);
+    for (score = 0, i = 0; i < 16; ++i)
+	if (m[i] > score) score = m[i];
+    return score + p->bias >= 255 ? -1 : score;
+}
+
+static int
+striped_sse2_16(dpAlign_StripedProfile * p, unsigned char * B, int N, void * scratch)
+{
+    int seg = p->seg16;
+    __m128i * prof = (__m128i *) p->p16;
+    __m128i vZero = _mm_setzero_si128();
+    __m128i vGapO = _mm_set1_epi16((short) p->gapo);
+    __m128i vGapE = _mm_set1_epi16((short) p->gape);
+    __m128i vMax = vZero;
+    __m128i vH, vE, vF, vT;
+    __m128i * pvHStore, * pvHLoad, * pvE, * pvP, * mem, * tmp;
+    short m[8];
+    int i, j, k, score;
+
+    mem = (__m128i *) scratch;
+    memset(mem, 0, 3*seg*sizeof(__m128i));
+    pvHStore = mem;
+    pvHLoad = mem + seg;
+    pvE = mem + 2*seg;
+
+    for (j = 0; j < N; ++j) {
+	pvP = prof + B[j]*seg;
+	vF = vZero;
+	vH = _mm_slli_si128(pvHStore[seg-1], 2);
+	tmp = pvHLoad; pvHLoad = pvHStore; pvHStore = tmp;
+	for (i = 0; i < seg; ++i) {
+	    vH = _mm_adds_epi16(vH, pvP[i]);
+	    vH = _mm_max_epi16(vH, vZero);
+	    vE = pvE[i];
+	    vH = _mm_max_epi16(vH, vE);
+	    vH = _mm_max_epi16(vH, vF);
+	    vMax = _mm_max_epi16(vMax, vH);
+	    pvHStore[i] = vH;
+	    vH = _mm_subs_epi16(vH, vGapO);
+	    vE = _mm_subs_epi16(vE, vGapE);
+	    pvE[i] = _mm_max_epi16(vE, vH);
+	    vF = _mm_subs_epi16(vF, vGapE);
+	    vF = _mm_max_epi16(vF, vH);
+	    vH = pvHLoad[i];
+	}
+	for (k = 0; k < 8; ++k) {
+	    vF = _mm_slli_si128(vF, 2);
+	    for (i = 0; i < seg; ++i) {
+		vH = pvHStore[i];
+		vT = _mm_subs_epi16(vH, vGapO);
+		if (_mm_movemask_epi8(_mm_cmpgt_epi16(vF, vT)) == 0)
+		    goto next_column;
+		vH = _mm_max_epi16(vH, vF);
+		vMax = _mm_max_epi16(vMax, vH);
+		pvHStore[i] = vH;
+		pvE[i] = _mm_max_epi16(pvE[i], _mm_subs_epi16(vH, vGapO));
+		vF = _mm_subs_epi16(vF, vGapE);
+	    }
+	}
+    next_column:
+	;
+    }
+
+    _mm_storeu_si128((__m128i *) m, vMax);
+    for (score = 0, i = 0; i < 8; ++i)
+	if (m[i] > score) score = m[i];
+    return score >= SHRT_MAX ? -1 : score;
+}
+
+#ifdef DPALIGN_AVX2
+
+/* shift a 256-bit vector left by n bytes across the 128-bit lanes */
+#define avx2_shift(v, n) _mm256_alignr_epi8((v), _mm256_permute2x128_si256((v), (v), 0x08), 16-(n))
+
+__attribute__((target("avx2")))
+static int
+striped_avx2_8(dpAlign_StripedProfile * p, unsigned char * B, int N, void * scratch)
+{
+    int seg = p->seg8;
+    __m256i * prof = (__m256i *) p->p8;
+    __m256i vZero = _mm256_setzero_si256();
+    __m256i vBias = _mm256_set1_epi8((char) p->bias);
+    __m256i vGapO = _mm256_set1_epi8((char) p->gapo);
+    __m256i vGapE = _mm256_set1_epi8((char) p->gape);
+    __m256i vMax = vZero;
+    __m256i vH, vE, vF, vT;
+    __m256i * pvHStore, * pvHLoad, * pvE, * pvP, * mem, * tmp;
+    unsigned char m[32];
+    int i, j, k, score;
+
+    mem = (__m256i *) scratch;
+    memset(mem, 0, 3*seg*sizeof(__m256i));
+    pvHStore = mem;
+    pvHLoad = mem + seg;
+    pvE = mem + 2*seg;
+
+    for (j = 0; j < N; ++j) {
+	pvP = prof + B[j]*seg;
+	vF = vZero;
+	vH = avx2_shift(pvHStore[seg-1], 1);
+	tmp = pvHLoad; pvHLoad = pvHStore; pvHStore = tmp;
+	for (i = 0; i < seg; ++i) {
+	    vH = _mm256_adds_epu8(vH, pvP[i]);
+	    vH = _mm256_subs_epu8(vH, vBias);
+	    vE = pvE[i];
+	    vH = _mm256_max_epu8(vH, vE);
+	    vH = _mm256_max_epu8(vH, vF);
+	    vMax = _mm256_max_epu8(vMax, vH);
+	    pvHStore[i] = vH;
+	    vH = _mm256_subs_epu8(vH, vGapO);
+	    vE = _mm256_subs_epu8(vE, vGapE);
+	    pvE[i] = _mm256_max_epu8(vE, vH);
+	    vF = _mm256_subs_epu8(vF, vGapE);
+	    vF = _mm256_max_epu8(vF, vH);
+	    vH = pvHLoad[i];
+	}
+	for (k = 0; k < 32; ++k) {
+	    vF = avx2_shift(vF, 1);
+	    for (i = 0; i < seg; ++i) {
+		vH = pvHStore[i];
+		vT = _mm256_subs_epu8(vH, vGapO);
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_subs_epu8(vF, vT), vZero)) == -1)
+		    goto next_column;
+		vH = _mm256_max_epu8(vH, vF);
+		vMax = _mm256_max_epu8(vMax, vH);
+		pvHStore[i] = vH;
+		pvE[i] = _mm256_max_epu8(pvE[i], _mm256_subs_epu8(vH, vGapO));
+		vF = _mm256_subs_epu8(vF, vGapE);
+	    }
+	}
+    next_column:
+	;
+    }
+
+    _mm256_storeu_si256((__m256i *) m, vMax);
+    for (score = 0, i = 0; i < 32; ++i)
+	if (m[i] > score) score = m[i];
+    return score + p->bias >= 255 ? -1 : score;
+}
+
+__attribute__((target("avx2")))
+static int
+striped_avx2_16(dpAlign_StripedProfile * p, unsigned char * B, int N, void * scratch)
+{
+    int seg = p->seg16;
+    __m256i * prof = (__m256i *) p->p16;
+    __m256i vZero = _mm256_setzero_si256();
+    __m256i vGapO = _mm256_set1_epi16((short) p->gapo);
+    __m256i vGapE = _mm256_set1_epi16((short) p->gape);
+    __m256i vMax = vZero;
+    __m256i vH, vE, vF, vT;
+    __m256i * pvHStore, * pvHLoad, * pvE, * pvP, * mem, * tmp;
+    short m[16];
+    int i, j, k, score;
+
+    mem = (__m256i *) scratch;
+    memset(mem, 0, 3*seg*sizeof(__m256i));
+    pvHStore = mem;
+    pvHLoad = mem + seg;
+    pvE = mem + 2*seg;
+
+    for (j = 0; j < N; ++j) {
+	pvP = prof + B[j]*seg;
+	vF = vZero;
+	vH = avx2_shift(pvHStore[seg-1], 2);
+	tmp = pvHLoad; pvHLoad = pvHStore; pvHStore = tmp;
+	for (i = 0; i < seg; ++i) {
+	    vH = _mm256_adds_epi16(vH, pvP[i]);
+	    vH = _mm256_max_epi16(vH, vZero);
+	    vE = pvE[i];
+	    vH = _mm256_max_epi16(vH, vE);
+	    vH = _mm256_max_epi16(vH, vF);
+	    vMax = _mm256_max_epi16(vMax, vH);
+	    pvHStore[i] = vH;
+	    vH = _mm256_subs_epi16(vH, vGapO);
+	    vE = _mm256_subs_epi16(vE, vGapE);
+	    pvE[i] = _mm256_max_epi16(vE, vH);
+	    vF = _mm256_subs_epi16(vF, vGapE);
+	    vF = _mm256_max_epi16(vF, vH);
+	    vH = pvHLoad[i];
+	}
+	for (k = 0; k < 16; ++k) {
+	    vF = avx2_shift(vF, 2);
+	    for (i = 0; i < seg; ++i) {
+		vH = pvHStore[i];
+		vT = _mm256_subs_epi16(vH, vGapO);
+		if (_mm256_movemask_epi8(_mm256_cmpgt_epi16(vF, vT)) == 0)
+		    goto next_column;
+		vH = _mm256_max_epi16(vH, vF);
+		vMax = _mm256_max_epi16(vMax, vH);
+		pvHStore[i] = vH;
+		pvE[i] = _mm256_max_epi16(pvE[i], _mm256_subs_epi16(vH, vGapO));
+		vF = _mm256_subs_epi16(vF, vGapE);
+	    }
+	}
+    next_column:
+	;
+    }
+
+    _mm256_storeu_si256((__m256i *) m, vMax);
+    for (score = 0, i = 0; i < 16; ++i)
+	if (m[i] > score) score = m[i];
+    return score >= SHRT_MAX ? -1 : score;
+}
+#endif /* DPALIGN_AVX2 */
+
+#endif /* DPALIGN_SSE2 */
+
+/*
+  dpAlign_Striped_Profile builds the striped 8-bit and 16-bit copies of
+  the query profile of sp for the widest kernel the CPU supports. The
+  8-bit (16-bit) copy is left out if the profile scores or the gap
+  penalties don't fit in 8 (16) bits, and if neither fits sp->striped
+  stays NULL so that only pgreen is used.
+ */
+void
+dpAlign_Striped_Profile(dpAlign_SequenceProfile * sp)
+{
+#ifdef DPALIGN_SSE2
+    dpAlign_StripedProfile * p;
+    int lo, hi, gapo, gape;
+    int r, i, k, seg, lanes;
+    int * row;
+
+    sp->striped = NULL;
+    gapo = sp->gap + sp->ext;
+    gape = sp->ext;
+    if (sp->len <= 0 || sp->gap < 0 || gape < 0 || gapo > SHRT_MAX)
+	return;
+
+    lo = hi = 0;
+    for (i = 0; i < sp->sz*sp->len; ++i) {
+	if (sp->waa[i] < lo) lo = sp->waa[i];
+	if (sp->waa[i] > hi) hi = sp->waa[i];
+    }
+    if (lo < SHRT_MIN || hi > SHRT_MAX)
+	return;
+
+    p = (dpAlign_StripedProfile *) calloc(1, sizeof(dpAlign_StripedProfile));
+    if (p == NULL)
+	dpAlign_fatal("Can't allocate memory for striped profile!\n");
+    p->lanes = lanes = striped_lanes();
+    p->sz = sp->sz;
+    p->len = sp->len;
+    p->gapo = gapo;
+    p->gape = gape;
+    p->bias = -lo;
+
+/* 8-bit profile, query position k*seg+i goes to byte k of vector i */
+    if (hi - lo <= 255 && gapo <= 255) {
+	seg = p->seg8 = (sp->len + lanes - 1)/lanes;
+	p->p8 = (unsigned char *) striped_alloc(sp->sz*seg*lanes);
+	for (r = 0; r < sp->sz; ++r) {
+	    row = sp->waa + r*sp->len;
+	    for (i = 0; i < seg; ++i)
+		for (k = 0; k < lanes; ++k)
+		    p->p8[(r*seg + i)*lanes + k] = k*seg + i < sp->len ? row[k*seg + i] + p->bias : p->bias;
+	}
+    }
+
+/* 16-bit profile, with half as many lanes */
+    lanes /= 2;
+    seg = p->seg16 = (sp->len + lanes - 1)/lanes;
+    p->p16 = (short *) striped_alloc(sp->sz*seg*lanes*sizeof(short));
+    for (r = 0; r < sp->sz; ++r) {
+	row = sp->waa + r*sp->len;
+	for (i = 0; i < seg; ++i)
+	    for (k = 0; k < lanes; ++k)
+		p->p16[(r*seg + i)*lanes + k] = k*seg + i < sp->len ? row[k*seg + i] : 0;
+    }
+    sp->striped = p;
+#else
+    sp->striped = NULL;
+#endif
+}
+
+void
+free_dpAlign_StripedProfile(dpAlign_StripedProfile * p)
+{
+    if (p == NULL)
+	return;
+    if (!p->mapped) {
+	free(p->p8);
+	free(p->p16);
+    }
+    free(p);
+}
+
+/*
+  dpAlign_Striped_Write writes the striped profile p to fp, which must
+  be at a 64 byte boundary of the file, as a striped_Saved followed by
+  the 8-bit and 16-bit profiles, each 64 byte aligned too. It returns 0,
+  or -1 if writing fails.
+ */
+int
+dpAlign_Striped_Write(dpAlign_StripedProfile * p, FILE * fp)
+{
+    striped_Saved h;
+    long start = ftell(fp);
+    size_t n8 = (size_t) p->sz*p->seg8*p->lanes;
+    size_t n16 = (size_t) p->sz*p->seg16*(p->lanes/2);
+
+    memset(&h, 0, sizeof(h));
+    h.lanes = p->lanes;
+    h.sz = p->sz;
+    h.len = p->len;
+    h.gapo = p->gapo;
+    h.gape = p->gape;
+    h.bias = p->bias;
+    h.seg8 = p->seg8;
+    h.seg16 = p->seg16;
+    if (start < 0 || fwrite(&h, sizeof(h), 1, fp) != 1)
+	return -1;
+    if (p->p8 != NULL) {
+	if (dpAlign_File_Pad(fp, 64) != 0)
+	    return -1;
+	h.p8 = ftell(fp) - start;
+	if (fwrite(p->p8, 1, n8, fp) != n8)
+	    return -1;
+    }
+    if (dpAlign_File_Pad(fp, 64) != 0)
+	return -1;
+    h.p16 = ftell(fp) - start;
+    if (fwrite(p->p16, sizeof(short), n16, fp) != n16)
+	return -1;
+/* now that the offsets are known */
+    if (fseek(fp, start, SEEK_SET) != 0 || fwrite(&h, sizeof(h), 1, fp) != 1)
+	return -1;
+    return fseek(fp, 0, SEEK_END);
+}
+
+/*
+  dpAlign_Striped_Map returns the striped copy of the profile sp written
+  by dpAlign_Striped_Write into the size bytes at mem, with its profiles
+  used in place, or NULL if it doesn't fit in size bytes, isn't a copy
+  of sp or is for kernels of another width than this CPU runs.
+ */
+dpAlign_StripedProfile *
+dpAlign_Striped_Map(dpAlign_SequenceProfile * sp, char * mem, size_t size)
+{
+#ifdef DPALIGN_SSE2
+    striped_Saved * h = (striped_Saved *) mem;
+    dpAlign_StripedProfile * p;
+    size_t n8, n16;
+    int lanes = striped_lanes();
+
+    if (size < sizeof(striped_Saved) || h->lanes != lanes || h->sz != sp->sz || h->len != sp->len
+	|| h->gapo != sp->gap + sp->ext || h->gape != sp->ext || h->seg16 != (sp->len + lanes/2 - 1)/(lanes/2)
+	|| (h->p8 != 0 && h->seg8 != (sp->len + lanes - 1)/lanes))
+	return NULL;
+    n8 = (size_t) h->sz*h->seg8*h->lanes;
+    n16 = (size_t) h->sz*h->seg16*(h->lanes/2)*sizeof(short);
+    if (h->p8 != 0 && (h->p8 < (long long) sizeof(striped_Saved) || h->p8 + n8 > size))
+	return NULL;
+    if (h->p16 < (long long) sizeof(striped_Saved) || h->p16 + n16 > size)
+	return NULL;
+    p = (dpAlign_StripedProfile *) calloc(1, sizeof(dpAlign_StripedProfile));
+    if (p == NULL)
+	dpAlign_fatal("Can't allocate memory for striped profile!\n");
+    p->lanes = h->lanes;
+    p->sz = h->sz;
+    p->len = h->len;
+    p->gapo = h->gapo;
+    p->gape = h->gape;
+    p->bias = h->bias;
+    p->seg8 = h->seg8;
+    p->seg16 = h->seg16;
+    p->p8 = h->p8 != 0 ? (unsigned char *) (mem + h->p8) : NULL;
+    p->p16 = (short *) (mem + h->p16);
+    p->mapped = 1;
+    return p;
+#else
+    return NULL;
+#endif
+}
+
+/*
+  dpAlign_PhilGreen_Score returns the optimal local alignment score
+  between the query of the sequence profile sp and the encoded target
+  sequence B of length N. The striped kernels are tried first, widest
+  lanes last; pgreen is used when they saturate, when sp has no striped
+  profile or when B contains a residue outside the profile's alphabet.
+  As with pgreen, a best score that doesn't exceed gap+ext is reported as 0.
+  The rows of the kernels come from the workspace ws, or are allocated
+  for this call if it is NULL.
+ */
+int
+dpAlign_PhilGreen_Score(dpAlign_SequenceProfile * sp, unsigned char * B, int N, dpAlign_Workspace * ws)
+{
+    dpAlign_Workspace tmp;
+    struct swstr * ss;
+    int score = -1;
+#ifdef DPALIGN_SSE2
+    dpAlign_StripedProfile * p = sp->striped;
+    void * scratch;
+    int i;
+#endif
+
+    if (ws == NULL) {
+	memset(&tmp, 0, sizeof(dpAlign_Workspace));
+	ws = &tmp;
+    }
+#ifdef DPALIGN_SSE2
+    if (p != NULL) {
+	for (i = 0; i < N; ++i)
+	    if (B[i] >= p->sz) break;
+	if (i < N)
+	    p = NULL;
+    }
+    if (p != NULL && N > 0) {
+/* room for the 16-bit rows, which are the longer ones */
+	scratch = dpAlign_Workspace_Buffer(&ws->simd, &ws->simdsz, 3*p->seg16*p->lanes);
+#ifdef DPALIGN_AVX2
+	if (p->lanes == 32) {
+	    if (p->p8 != NULL)
+		score = striped_avx2_8(p, B, N, scratch);
+	    if (score < 0)
+		score = striped_avx2_16(p, B, N, scratch);
+	}
+	else
+#endif
+	{
+	    if (p->p8 != NULL)
+		score = striped_sse2_8(p, B, N, scratch);
+	    if (score < 0)
+		score = striped_sse2_16(p, B, N, scratch);
+	}
+/* like FASTA, pgreen only records scores above the gap opening cost */
+	if (score >= 0) {
+	    if (ws == &tmp)
+		free(tmp.simd);
+	    return score > p->gapo ? score : 0;
+	}
+    }
+#endif
+    ss = (struct swstr *) dpAlign_Workspace_Buffer(&ws->rows, &ws->rowsz, sizeof(struct swstr)*(sp->len+1));
+    score = pgreen(sp->waa, sp->len, B, N, sp->gap, sp->ext, ss);
+    if (ws == &tmp) {
+	free(tmp.simd);
+	free(tmp.rows);
+    }
+    return score;
+}
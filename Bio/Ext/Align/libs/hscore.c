@@ -2,6 +2,7 @@
 extern "C" {
 #endif
 #include "hscore.h"
+#include "probability.h"
 
 
 /* Function:  should_store_Hscore(hs,score)
@@ -39,6 +40,87 @@ boolean should_store_Hscore(Hscore * hs,int score)
 }
 
  
+/* Function:  level_should_store_Hscore(given_score,internal_score_level)
+ *
+ * Descrip:    The usual should_store function of a Hscore,
+ *             storing the scores of at least the score_level.
+ *
+ *             Searches can tell from /store_cutoff_Hscore
+ *             that lower scores will not be stored when a Hscore
+ *             uses this function, and give up early on targets
+ *             which can't reach it.
+ *
+ *
+ * Arg:                 given_score [UNKN ] score of the comparison [int]
+ * Arg:        internal_score_level [UNKN ] score_level of the Hscore [double]
+ *
+ * Return [UNKN ]  Undocumented return value [boolean]
+ *
+ */
+boolean level_should_store_Hscore(int given_score,double internal_score_level)
+{
+  if( given_score >= internal_score_level ) {
+    return TRUE;
+  }
+  return FALSE;
+}
+
+/* Function:  level_score_Hscore(cut_off,report_stagger)
+ *
+ * Descrip:    Makes a Hscore which stores the scores of
+ *             at least cut_off, reporting progress every
+ *             report_stagger comparisons, or never if it is -1
+ *
+ *
+ * Arg:               cut_off [UNKN ] lowest score to store [int]
+ * Arg:        report_stagger [UNKN ] comparisons between reports [int]
+ *
+ * Return [UNKN ]  Undocumented return value [Hscore *]
+ *
+ */
+Hscore * level_score_Hscore(int cut_off,int report_stagger)
+{
+  Hscore * out;
+
+  if( (out = Hscore_alloc_std()) == NULL ) {
+    return NULL;
+  }
+  out->should_store = level_should_store_Hscore;
+  out->score_level = cut_off;
+  out->report_level = report_stagger;
+  return out;
+}
+
+/* Function:  store_cutoff_Hscore(hs)
+ *
+ * Descrip:    Returns the lowest score hs will store, so
+ *             that a search may give any lower score in its
+ *             place, or NEGI if every score has to be exact:
+ *             when hs keeps a Histogram of the scores, or
+ *             decides what to store with some other function
+ *             than /level_should_store_Hscore
+ *
+ *
+ * Arg:        hs [READ ] Hscore object [Hscore *]
+ *
+ * Return [UNKN ]  Undocumented return value [int]
+ *
+ */
+int store_cutoff_Hscore(Hscore * hs)
+{
+  if( hs->his != NULL && hs->score_to_his != NULL ) {
+    return NEGI;
+  }
+  if( hs->should_store != level_should_store_Hscore ) {
+    return NEGI;
+  }
+  if( hs->score_level <= NEGI ) {
+    return NEGI;
+  }
+  return (int) ceil(hs->score_level);
+}
+
+ 
 /* Function:  length_datascore_Hscore(obj)
  *
  * Descrip:    Returns the number of datascores in the hscore
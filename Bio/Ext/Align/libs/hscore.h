@@ -146,6 +146,63 @@ boolean bp_sw_should_store_Hscore(Hscore * hs,int score);
 #define should_store_Hscore bp_sw_should_store_Hscore
 
 
+/* Function:  level_should_store_Hscore(given_score,internal_score_level)
+ *
+ * Descrip:    The usual should_store function of a Hscore,
+ *             storing the scores of at least the score_level.
+ *
+ *             Searches can tell from /store_cutoff_Hscore
+ *             that lower scores will not be stored when a Hscore
+ *             uses this function, and give up early on targets
+ *             which can't reach it.
+ *
+ *
+ * Arg:                 given_score [UNKN ] score of the comparison [int]
+ * Arg:        internal_score_level [UNKN ] score_level of the Hscore [double]
+ *
+ * Return [UNKN ]  Undocumented return value [boolean]
+ *
+ */
+boolean bp_sw_level_should_store_Hscore(int given_score,double internal_score_level);
+#define level_should_store_Hscore bp_sw_level_should_store_Hscore
+
+
+/* Function:  level_score_Hscore(cut_off,report_stagger)
+ *
+ * Descrip:    Makes a Hscore which stores the scores of
+ *             at least cut_off, reporting progress every
+ *             report_stagger comparisons, or never if it is -1
+ *
+ *
+ * Arg:               cut_off [UNKN ] lowest score to store [int]
+ * Arg:        report_stagger [UNKN ] comparisons between reports [int]
+ *
+ * Return [UNKN ]  Undocumented return value [Hscore *]
+ *
+ */
+Hscore * bp_sw_level_score_Hscore(int cut_off,int report_stagger);
+#define level_score_Hscore bp_sw_level_score_Hscore
+
+
+/* Function:  store_cutoff_Hscore(hs)
+ *
+ * Descrip:    Returns the lowest score hs will store, so
+ *             that a search may give any lower score in its
+ *             place, or NEGI if every score has to be exact:
+ *             when hs keeps a Histogram of the scores, or
+ *             decides what to store with some other function
+ *             than /level_should_store_Hscore
+ *
+ *
+ * Arg:        hs [READ ] Hscore object [Hscore *]
+ *
+ * Return [UNKN ]  Undocumented return value [int]
+ *
+ */
+int bp_sw_store_cutoff_Hscore(Hscore * hs);
+#define store_cutoff_Hscore bp_sw_store_cutoff_Hscore
+
+
 /* Function:  length_datascore_Hscore(obj)
  *
  * Descrip:    Returns the number of datascores in the hscore
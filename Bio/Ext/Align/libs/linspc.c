@@ -1,5 +1,6 @@
 #include "dpalign.h"
 #include <sys/time.h>
+#include <sys/mman.h>
 
 /* $Id$ */
 
@@ -22,13 +23,36 @@ typedef struct sw_alignstruct {
     struct swstr * RR; /* reverse Gotoh arrays */
     int * spc1; /* gap array for sequence 1 */
     int * spc2; /* gap array for sequence 2 */
+    dpAlign_Workspace * ws; /* where the arrays above are kept */
 } sw_AlignStruct;
 
+struct swstart {
+    long long H; /* start point of the alignment giving H in struct swstr */
+    long long E; /* likewise for E */
+};
+
+/* a start point (i, j) packed so that start points compare by i, then j */
+#define start_point(i, j) (((long long) (i) << 32) | (long long) (j))
+#define start_i(o) ((int) ((o) >> 32))
+#define start_j(o) ((int) ((o) & 0xffffffffLL))
+
+/*
+  better_start tells whether value v with start point o beats value w
+  with start point p: it is higher, or as high and starts later.
+ */
+#define better_start(v, o, w, p) ((v) > (w) || ((v) == (w) && (o) > (p)))
+
 /* static functions */
-static sw_AlignStruct * init_AlignStruct(char *, char *, int **, int, int);
+static void init_AlignStruct(sw_AlignStruct *, dpAlign_EncodedSequence *, dpAlign_EncodedSequence *, int, int *, int **, int, int, dpAlign_Workspace *);
+static void init_spaces(sw_AlignStruct *, int, int);
+static dpAlign_Workspace * use_Workspace(dpAlign_Workspace *, dpAlign_Workspace *);
+static void done_Workspace(dpAlign_Workspace *, dpAlign_Workspace *);
 static void find_ends(sw_AlignStruct *);
 static void find_endsfree(sw_AlignStruct *);
+static void find_ends_xdrop(sw_AlignStruct *, int, int, int);
 static dpAlign_AlignOutput * traceback(sw_AlignStruct *);
+static dpAlign_AlignOutput * global_DNA(dpAlign_EncodedSequence *, dpAlign_EncodedSequence *, int, int, int, int, int, int, dpAlign_Workspace *);
+static dpAlign_AlignOutput * global_Protein(dpAlign_EncodedSequence *, dpAlign_EncodedSequence *, dpAlign_ScoringMatrix *, int, int, dpAlign_Workspace *);
 
 /*
   dpAlign_Local_DNA_MillerMyers uses Gotoh algorithm to find the 
@@ -41,13 +65,16 @@ static dpAlign_AlignOutput * traceback(sw_AlignStruct *);
   gap extension as arguments. At the end, it returns the 
   dpAlign_AlignOutput data structure which can be translated into a 
   Bio::SimpleAlign object pretty easily.
+  It aligns with threads threads, or with dpAlign_get_threads() of
+  them if threads is 0.
  */
 dpAlign_AlignOutput *
-dpAlign_Local_DNA_MillerMyers(char * seq1, char * seq2, int match, int mismatch, int gap, int ext)
+dpAlign_Local_DNA_MillerMyers(dpAlign_EncodedSequence * seq1, dpAlign_EncodedSequence * seq2, int match, int mismatch, int gap, int ext, int threads, dpAlign_Workspace * ws)
 {
-    sw_AlignStruct * as;
+    sw_AlignStruct alignstruct, * as = &alignstruct;
+    dpAlign_Workspace tmp;
+    dpAlign_AlignOutput * ao;
     int ** s;
-    int i, j;
 
     if (seq1 == NULL)
 	dpAlign_fatal("Sequence 1 is a NULL pointer!\n");
@@ -55,53 +82,27 @@ dpAlign_Local_DNA_MillerMyers(char * seq1, char * seq2, int match, int mismatch,
 	dpAlign_fatal("Sequence 2 is a NULL pointer!\n");
 
 /* initialize DNA scoring matrix */
-    s = (int **) malloc(17*sizeof(int *));
-    if (s == NULL)
-        dpAlign_fatal("Cannot allocate memory for scoring matrix row!\n");
-    for (i = 0; i < 17; ++i) {
-	s[i] = (int *) malloc(17*sizeof(int));
-	if (s[i] == NULL)
-	    dpAlign_fatal("Cannot allocate memory for scoring matrix col!\n");
-        for (j = 0; j < 17; ++j) {
-            if (i == 16 || j == 16) s[i][j] = mismatch; /* X mismatches all */
-            else if (i == 15 || j == 15) s[i][j] = match; /* N matches all but X */
-            else if (i == 14 && j != 0 || i != 0 && j == 14) s[i][j] = match; /* B is not A */
-            else if (i == 13 && j != 3 && j != 4 || i != 3 && i != 4 && j == 13) s[i][j] = match; /* V is not T/U */
-            else if (i == 12 && j != 2 || i != 2 && j == 12) s[i][j] = match; /* H is not G */
-            else if (i == 11 && j != 1 || i != 1 && j == 11) s[i][j] = match; /* D is not C */
-            else if (i == 10 && j != 0 && j != 1 && j != 7 || i != 0 && i != 1 && i != 7 && j == 10) s[i][j] = match; /* K is not A/C/M */
-            else if (i == 9 && j != 0 && j != 3 && j != 4 && j != 8 || i != 0 && i != 3 && i != 4 && i != 8 && j == 9) s[i][j] = match; /* S is not T/U/A/W */
-            else if (i == 8 && j != 1 && j != 2 && j != 9 || i != 1 && i != 2 && i != 9 && j == 10) s[i][j] = match; /* W is not G/C/S */
-            else if (i == 7 && j != 2 && j != 3 && j != 4 && j != 10 || i != 2 && i != 3 && i != 4 && i != 10 && j == 7) s[i][j] = match; /* M is not T/U/G/K */
-            else if (i == 3 && j == 4 || i == 4 && j == 3) s[i][j] = match; /* T matches U */ 
-	    else if (i == j) s[i][j] = match;
-            else s[i][j] = mismatch;
-        }
-    }
+    ws = use_Workspace(ws, &tmp);
+    s = dpAlign_DNA_Matrix(match, mismatch)->s;
 
 /* initialize the alignment data structure */
-    as = init_AlignStruct(seq1, seq2, s, gap, ext);
-
-/* uppercase the sequence and then encode it */
-    for (i = 0; i < as->len1; ++i) {
-	if (as->seq1[i] >= 'a' && as->seq1[i] <= 'z') as->seq1[i] -= 0x20;
-        as->s1[i] = dna_encode(as->seq1[i]);
-    }
-    for (i = 0; i < as->len2; ++i) {
-	if (as->seq2[i] >= 'a' && as->seq2[i] <= 'z') as->seq2[i] -= 0x20;
-        as->s2[i] = dna_encode(as->seq2[i]);
-    }
+    init_AlignStruct(as, seq1, seq2, DPALIGN_DNA, NULL, s, gap, ext, ws);
 
 /* locate the end points of the subsequences that gives you the maximal 
    score */
     find_ends(as);
 
-    if (as->score < 0)
+    if (as->score < 0) {
+	done_Workspace(ws, &tmp);
 	return NULL;
+    }
 
 /* align the subsequences bounded by the end points */
-    as->score = align(as->s1 + as->start1 - 1, as->s2 + as->start2 - 1, as->end1 - as->start1 + 1, as->end2 - as->start2 + 1, as->s, as->gap, as->ext, as->FF, as->RR, as->spc1, as->spc2);
-    return traceback(as);
+    if (as->score > 0)
+	as->score = align_threaded(as->s1 + as->start1 - 1, as->s2 + as->start2 - 1, as->end1 - as->start1 + 1, as->end2 - as->start2 + 1, as->s, as->gap, as->ext, as->FF, as->RR, as->spc1, as->spc2, threads, as->ws);
+    ao = traceback(as);
+    done_Workspace(ws, &tmp);
+    return ao;
 }
 
 /*
@@ -118,13 +119,16 @@ dpAlign_Local_DNA_MillerMyers(char * seq1, char * seq2, int match, int mismatch,
   gap extension as arguments. At the end, it returns the 
   dpAlign_AlignOutput data structure which can be translated into a 
   Bio::SimpleAlign object pretty easily.
+  It aligns with threads threads, or with dpAlign_get_threads() of
+  them if threads is 0.
  */
 dpAlign_AlignOutput *
-dpAlign_EndsFree_DNA_MillerMyers(char * seq1, char * seq2, int match, int mismatch, int gap, int ext)
+dpAlign_EndsFree_DNA_MillerMyers(dpAlign_EncodedSequence * seq1, dpAlign_EncodedSequence * seq2, int match, int mismatch, int gap, int ext, int threads, dpAlign_Workspace * ws)
 {
-    sw_AlignStruct * as;
+    sw_AlignStruct alignstruct, * as = &alignstruct;
+    dpAlign_Workspace tmp;
+    dpAlign_AlignOutput * ao;
     int ** s;
-    int i, j;
 
     if (seq1 == NULL)
 	dpAlign_fatal("Sequence 1 is a NULL pointer!\n");
@@ -132,55 +136,66 @@ dpAlign_EndsFree_DNA_MillerMyers(char * seq1, char * seq2, int match, int mismat
 	dpAlign_fatal("Sequence 2 is a NULL pointer!\n");
 
 /* initialize DNA scoring matrix */
-    s = (int **) malloc(17*sizeof(int *));
-    if (s == NULL)
-        dpAlign_fatal("Cannot allocate memory for scoring matrix row!\n");
-    for (i = 0; i < 17; ++i) {
-	s[i] = (int *) malloc(17*sizeof(int));
-	if (s[i] == NULL)
-	    dpAlign_fatal("Cannot allocate memory for scoring matrix col!\n");
-        for (j = 0; j < 17; ++j) {
-            if (i == 16 || j == 16) s[i][j] = mismatch; /* X mismatches all */
-            else if (i == 15 || j == 15) s[i][j] = match; /* N matches all but X */
-            else if (i == 14 && j != 0 || i != 0 && j == 14) s[i][j] = match; /* B is not A */
-            else if (i == 13 && j != 3 && j != 4 || i != 3 && i != 4 && j == 13) s[i][j] = match; /* V is not T/U */
-            else if (i == 12 && j != 2 || i != 2 && j == 12) s[i][j] = match; /* H is not G */
-            else if (i == 11 && j != 1 || i != 1 && j == 11) s[i][j] = match; /* D is not C */
-            else if (i == 10 && j != 0 && j != 1 && j != 7 || i != 0 && i != 1 && i != 7 && j == 10) s[i][j] = match; /* K is not A/C/M */
-            else if (i == 9 && j != 0 && j != 3 && j != 4 && j != 8 || i != 0 && i != 3 && i != 4 && i != 8 && j == 9) s[i][j] = match; /* S is not T/U/A/W */
-            else if (i == 8 && j != 1 && j != 2 && j != 9 || i != 1 && i != 2 && i != 9 && j == 10) s[i][j] = match; /* W is not G/C/S */
-            else if (i == 7 && j != 2 && j != 3 && j != 4 && j != 10 || i != 2 && i != 3 && i != 4 && i != 10 && j == 7) s[i][j] = match; /* M is not T/U/G/K */
-            else if (i == 3 && j == 4 || i == 4 && j == 3) s[i][j] = match; /* T matches U */ 
-	    else if (i == j) s[i][j] = match;
-            else s[i][j] = mismatch;
-        }
-    }
+    ws = use_Workspace(ws, &tmp);
+    s = dpAlign_DNA_Matrix(match, mismatch)->s;
 
 /* initialize the alignment data structure */
-    as = init_AlignStruct(seq1, seq2, s, gap, ext);
-
-/* uppercase the sequence and then encode it */
-    for (i = 0; i < as->len1; ++i) {
-	if (as->seq1[i] >= 'a' && as->seq1[i] <= 'z') as->seq1[i] -= 0x20;
-        as->s1[i] = dna_encode(as->seq1[i]);
-    }
-    for (i = 0; i < as->len2; ++i) {
-	if (as->seq2[i] >= 'a' && as->seq2[i] <= 'z') as->seq2[i] -= 0x20;
-        as->s2[i] = dna_encode(as->seq2[i]);
-    }
+    init_AlignStruct(as, seq1, seq2, DPALIGN_DNA, NULL, s, gap, ext, ws);
 
 /* locate the end points of the subsequences that gives you the maximal 
    score */
     find_endsfree(as);
 
 /* align the subsequences bounded by the end points */
-   as->score = align(as->s1 + as->start1 - 1, as->s2 + as->start2 - 1, as->end1 - as->start1 + 1, as->end2 - as->start2 + 1, as->s, as->gap, as->ext, as->FF, as->RR, as->spc1 + as->start1 - 1, as->spc2 + as->start2 - 1);
+   if (as->score > 0)
+       as->score = align_threaded(as->s1 + as->start1 - 1, as->s2 + as->start2 - 1, as->end1 - as->start1 + 1, as->end2 - as->start2 + 1, as->s, as->gap, as->ext, as->FF, as->RR, as->spc1 + as->start1 - 1, as->spc2 + as->start2 - 1, threads, as->ws);
 /* make it a global alignment */
    as->start1 = 1;
    as->end1 = as->len1;
    as->start2 = 1;
    as->end2 = as->len2;  
-   return traceback(as);
+   ao = traceback(as);
+   done_Workspace(ws, &tmp);
+   return ao;
+}
+
+/*
+  dpAlign_DNA_Myers aligns the DNA sequences seq1 and seq2 at unit cost,
+  i.e. it finds an alignment with the fewest substitutions, insertions
+  and deletions, using Myers' bit-vector algorithm (see myers_align).
+  The mode is one of DPALIGN_MYERS_GLOBAL, DPALIGN_MYERS_SEMIGLOBAL,
+  where seq1 may match anywhere in seq2, and DPALIGN_MYERS_PREFIX, where
+  seq1 is aligned to a prefix of seq2. IUPAC codes match as they do in
+  the other DNA aligners. The score of the dpAlign_AlignOutput returned
+  is minus the edit distance.
+ */
+dpAlign_AlignOutput *
+dpAlign_DNA_Myers(dpAlign_EncodedSequence * seq1, dpAlign_EncodedSequence * seq2, int mode, dpAlign_Workspace * ws)
+{
+    sw_AlignStruct alignstruct, * as = &alignstruct;
+    dpAlign_Workspace tmp;
+    dpAlign_AlignOutput * ao;
+
+    if (seq1 == NULL)
+	dpAlign_fatal("Sequence 1 is a NULL pointer!\n");
+    if (seq2 == NULL)
+	dpAlign_fatal("Sequence 2 is a NULL pointer!\n");
+    if (mode != DPALIGN_MYERS_GLOBAL && mode != DPALIGN_MYERS_SEMIGLOBAL && mode != DPALIGN_MYERS_PREFIX)
+	dpAlign_fatal("Unknown edit distance alignment mode!\n");
+
+/* the match masks come from the IUPAC matrix */
+    ws = use_Workspace(ws, &tmp);
+    init_AlignStruct(as, seq1, seq2, DPALIGN_DNA, NULL, dpAlign_DNA_Matrix(1, -1)->s, 0, 0, ws);
+
+    init_spaces(as, as->len1 + 1, as->len2 + 1);
+    as->score = -myers_align(as->s1, as->s2, as->len1, as->len2, as->s, mode, as->spc1, as->spc2, &as->start2, &as->end2, ws);
+    as->start1 = 1;
+    as->end1 = as->len1;
+/* the gaps of sequence 2 count from the start of the aligned stretch */
+    as->spc2 += as->start2 - 1;
+    ao = traceback(as);
+    done_Workspace(ws, &tmp);
+    return ao;
 }
 
 /*
@@ -191,13 +206,38 @@ dpAlign_EndsFree_DNA_MillerMyers(char * seq1, char * seq2, int match, int mismat
   arguments. At the end, it returns the dpAlign_AlignOutput data
   structure which can be translated into a Bio::SimpleAlign object
   pretty easily.
+  It aligns with threads threads, or with dpAlign_get_threads() of
+  them if threads is 0.
  */
 dpAlign_AlignOutput *
-dpAlign_Global_DNA_MillerMyers(char * seq1, char * seq2, int match, int mismatch, int gap, int ext)
+dpAlign_Global_DNA_MillerMyers(dpAlign_EncodedSequence * seq1, dpAlign_EncodedSequence * seq2, int match, int mismatch, int gap, int ext, int threads, dpAlign_Workspace * ws)
 {
-    sw_AlignStruct * as;
+    return global_DNA(seq1, seq2, match, mismatch, gap, ext, 0, threads, ws);
+}
+
+/*
+  dpAlign_Global_DNA_MillerMyers_Banded returns the same optimal global
+  alignment as dpAlign_Global_DNA_MillerMyers but only computes a band
+  of the dynamic programming matrix that is widened until it provably
+  holds the optimum, see align_banded. It is much faster for similar
+  sequences.
+ */
+dpAlign_AlignOutput *
+dpAlign_Global_DNA_MillerMyers_Banded(dpAlign_EncodedSequence * seq1, dpAlign_EncodedSequence * seq2, int match, int mismatch, int gap, int ext, dpAlign_Workspace * ws)
+{
+    return global_DNA(seq1, seq2, match, mismatch, gap, ext, 1, 1, ws);
+}
+
+/*
+  global_DNA does the work of the global DNA alignments, banded or not.
+ */
+static dpAlign_AlignOutput *
+global_DNA(dpAlign_EncodedSequence * seq1, dpAlign_EncodedSequence * seq2, int match, int mismatch, int gap, int ext, int banded, int threads, dpAlign_Workspace * ws)
+{
+    sw_AlignStruct alignstruct, * as = &alignstruct;
+    dpAlign_Workspace tmp;
+    dpAlign_AlignOutput * ao;
     int ** s;
-    int i, j;
 
     if (seq1 == NULL)
 	dpAlign_fatal("Sequence 1 is a NULL pointer!\n");
@@ -205,52 +245,19 @@ dpAlign_Global_DNA_MillerMyers(char * seq1, char * seq2, int match, int mismatch
 	dpAlign_fatal("Sequence 2 is a NULL pointer!\n");
 
 /* initialize DNA scoring matrix */
-    s = (int **) malloc(17*sizeof(int *));
-    if (s == NULL)
-        dpAlign_fatal("Cannot allocate memory for scoring matrix row!\n");
-    for (i = 0; i < 17; ++i) {
-	s[i] = (int *) malloc(17*sizeof(int));
-	if (s[i] == NULL)
-	    dpAlign_fatal("Cannot allocate memory for scoring matrix col!\n");
-        for (j = 0; j < 17; ++j) {
-            if (i == 16 || j == 16) s[i][j] = mismatch; /* X mismatches all */
-            else if (i == 15 || j == 15) s[i][j] = match; /* N matches all but X */
-            else if (i == 14 && j != 0 || i != 0 && j == 14) s[i][j] = match; /* B is not A */
-            else if (i == 13 && j != 3 && j != 4 || i != 3 && i != 4 && j == 13) s[i][j] = match; /* V is not T/U */
-            else if (i == 12 && j != 2 || i != 2 && j == 12) s[i][j] = match; /* H is not G */
-            else if (i == 11 && j != 1 || i != 1 && j == 11) s[i][j] = match; /* D is not C */
-            else if (i == 10 && j != 0 && j != 1 && j != 7 || i != 0 && i != 1 && i != 7 && j == 10) s[i][j] = match; /* K is not A/C/M */
-            else if (i == 9 && j != 0 && j != 3 && j != 4 && j != 8 || i != 0 && i != 3 && i != 4 && i != 8 && j == 9) s[i][j] = match; /* S is not T/U/A/W */
-            else if (i == 8 && j != 1 && j != 2 && j != 9 || i != 1 && i != 2 && i != 9 && j == 10) s[i][j] = match; /* W is not G/C/S */
-            else if (i == 7 && j != 2 && j != 3 && j != 4 && j != 10 || i != 2 && i != 3 && i != 4 && i != 10 && j == 7) s[i][j] = match; /* M is not T/U/G/K */
-            else if (i == 3 && j == 4 || i == 4 && j == 3) s[i][j] = match; /* T matches U */ 
-	    else if (i == j) s[i][j] = match;
-            else s[i][j] = mismatch;
-        }
-    }
+    ws = use_Workspace(ws, &tmp);
+    s = dpAlign_DNA_Matrix(match, mismatch)->s;
 
 /* initialize the alignment data structure */
-    as = init_AlignStruct(seq1, seq2, s, gap, ext);
-
-/* uppercase the sequence and then encode it */
-    for (i = 0; i < as->len1; ++i) {
-	if (as->seq1[i] >= 'a' && as->seq1[i] <= 'z') as->seq1[i] -= 0x20;
-        as->s1[i] = dna_encode(as->seq1[i]);
-    }
-    for (i = 0; i < as->len2; ++i) {
-	if (as->seq2[i] >= 'a' && as->seq2[i] <= 'z') as->seq2[i] -= 0x20;
-        as->s2[i] = dna_encode(as->seq2[i]);
-    }
+    init_AlignStruct(as, seq1, seq2, DPALIGN_DNA, NULL, s, gap, ext, ws);
 
 /* initialize the spaces arrays */
-    as->spc1 = (int *) calloc(as->len1 + 1, sizeof(int));
-    if (as->spc1 == NULL) 
-	dpAlign_fatal("Can't allocate memory for spaces array for seq 1!\n");
-    as->spc2 = (int *) calloc(as->len2 + 1, sizeof(int));
-    if (as->spc2 == NULL) 
-	dpAlign_fatal("Can't allocate memory for spaces array for seq 2!\n");
+    init_spaces(as, as->len1 + 1, as->len2 + 1);
 /* align the subsequences bounded by the end points */
-    as->score = align(as->s1, as->s2, as->len1, as->len2, as->s, as->gap, as->ext, as->FF, as->RR, as->spc1, as->spc2);
+    if (banded)
+        as->score = align_banded(as->s1, as->s2, as->len1, as->len2, as->s, 17, as->gap, as->ext, as->FF, as->RR, as->spc1, as->spc2, as->ws);
+    else
+        as->score = align_threaded(as->s1, as->s2, as->len1, as->len2, as->s, as->gap, as->ext, as->FF, as->RR, as->spc1, as->spc2, threads, as->ws);
 
 /*
    maxn0 = max(3*n0/2,MIN_RES);         
@@ -273,7 +280,9 @@ exit(0);
     as->end1 = as->len1;
     as->start2 = 1;
     as->end2 = as->len2;
-    return traceback(as);
+    ao = traceback(as);
+    done_Workspace(ws, &tmp);
+    return ao;
 }
 
 /*
@@ -293,16 +302,11 @@ new_dpAlign_ScoringMatrix(char * alphabet, int gap, int ext)
     if (matrix == NULL)
         dpAlign_fatal("Can't allocate memory for dpAlign_ScoringMatrix!\n");
     matrix->sz = strlen(alphabet);
-    matrix->s = (int **) malloc(matrix->sz*sizeof(int *));
-    if (matrix->s == NULL)
-        dpAlign_fatal("Can't allocate memory for dpAlign_ScoringMatrix's s!\n");
-    for (i = 0; i < matrix->sz; ++i) {
-        matrix->s[i] = (int *) calloc(matrix->sz, sizeof(int));
-        if (matrix->s[i] == NULL) 
-            dpAlign_fatal("Can't allocate memory for dpAlign_ScoringMatrix's s!\n");
-    }
+    matrix->m = new_dpAlign_Matrix(matrix->sz);
+    matrix->s = matrix->m->s;
     matrix->gap = gap;
     matrix->ext = ext;
+    memset(matrix->a, 0, sizeof(matrix->a));
     for (i = 0; i < matrix->sz; ++i) 
          matrix->a[alphabet[i]] = i;
     return matrix;
@@ -317,7 +321,38 @@ new_dpAlign_ScoringMatrix(char * alphabet, int gap, int ext)
 void
 set_dpAlign_ScoringMatrix(dpAlign_ScoringMatrix * matrix, char * row, char * col, int val)
 {
-   matrix->s[matrix->a[row[0]]][matrix->a[col[0]]] = val;
+   dpAlign_Matrix_Set(matrix->m, matrix->a[row[0]], matrix->a[col[0]], val);
+}
+
+/*
+    copy_dpAlign_ScoringMatrix returns a copy of matrix, to be released
+    with free_dpAlign_ScoringMatrix.
+ */
+dpAlign_ScoringMatrix *
+copy_dpAlign_ScoringMatrix(dpAlign_ScoringMatrix * matrix)
+{
+    dpAlign_ScoringMatrix * copy;
+    size_t cells = (size_t) matrix->m->sz*matrix->m->stride;
+
+    copy = (dpAlign_ScoringMatrix *) malloc(sizeof(dpAlign_ScoringMatrix));
+    if (copy == NULL)
+        dpAlign_fatal("Can't allocate memory for dpAlign_ScoringMatrix!\n");
+    memcpy(copy, matrix, sizeof(dpAlign_ScoringMatrix));
+    copy->m = new_dpAlign_Matrix(matrix->m->sz);
+    copy->s = copy->m->s;
+    memcpy(copy->m->s32, matrix->m->s32, cells*sizeof(int));
+    return copy;
+}
+
+/*
+    free_dpAlign_ScoringMatrix releases a dpAlign_ScoringMatrix object
+    created by new_dpAlign_ScoringMatrix.
+ */
+void
+free_dpAlign_ScoringMatrix(dpAlign_ScoringMatrix * matrix)
+{
+   free_dpAlign_Matrix(matrix->m);
+   free(matrix);
 }
 
 /* 
@@ -329,6 +364,7 @@ dpAlign_Protein_Profile(char * seq1, dpAlign_ScoringMatrix * matrix)
 {
     int i, j;
     unsigned char * s1;
+    unsigned char * t; /* encoding table */
     int gap = 7;
     int ext = 1;
     int sz = 24;
@@ -341,17 +377,15 @@ dpAlign_Protein_Profile(char * seq1, dpAlign_ScoringMatrix * matrix)
     sp = (dpAlign_SequenceProfile *) malloc(sizeof(dpAlign_SequenceProfile));
     if (sp == NULL)
 	dpAlign_fatal("Can't allocate memory for Sequence Profile!\n");
+    sp->map = NULL;
     sp->len = strlen(seq1);
     s1 = (unsigned char *) malloc(sp->len*sizeof(unsigned char));
     if (s1 == NULL)
         dpAlign_fatal("Cannot allocate memory for encoded sequence 1!\n");
     if (matrix == NULL) {
-        sp->a['A'] = 0x00; sp->a['R'] = 0x01; sp->a['N'] = 0x02; sp->a['D'] = 0x03;
-        sp->a['C'] = 0x04; sp->a['Q'] = 0x05; sp->a['E'] = 0x06; sp->a['G'] = 0x07;
-        sp->a['H'] = 0x08; sp->a['I'] = 0x09; sp->a['L'] = 0x0a; sp->a['K'] = 0x0b;
-        sp->a['M'] = 0x0c; sp->a['F'] = 0x0d; sp->a['P'] = 0x0e; sp->a['S'] = 0x0f;
-        sp->a['T'] = 0x10; sp->a['W'] = 0x11; sp->a['Y'] = 0x12; sp->a['V'] = 0x13;
-        sp->a['B'] = 0x14; sp->a['Z'] = 0x15; sp->a['X'] = 0x16; sp->a['*'] = 0x17;
+        t = dpAlign_Encode_Table(DPALIGN_PROTEIN);
+        for (i = 0; i < 256; ++i)
+            sp->a[i] = t[i];
     }
     else {
        gap = matrix->gap;
@@ -360,10 +394,8 @@ dpAlign_Protein_Profile(char * seq1, dpAlign_ScoringMatrix * matrix)
        for (i = 0; i < 256; ++i)
            sp->a[i] = matrix->a[i];
     }
-    for (i = 0; i < sp->len; ++i) {
-	if (seq1[i] >= 'a' && seq1[i] <= 'z') seq1[i] -= 0x20;
-        s1[i] = sp->a[seq1[i]];
-    }
+    for (i = 0; i < sp->len; ++i)
+        s1[i] = sp->a[upper_case((unsigned char) seq1[i])];
 
     sp->waa = (int *) malloc(sizeof(int)*sz*sp->len);
     if (sp->waa == NULL)
@@ -371,7 +403,7 @@ dpAlign_Protein_Profile(char * seq1, dpAlign_ScoringMatrix * matrix)
     pwaa = sp->waa;
     if (matrix == NULL) {
         for (i = 0; i < sz; ++i) {
-            smp = blosum62[i];
+            smp = dpAlign_Blosum62_Matrix()->s[i];
             for (j = 0; j < sp->len; ++j)
                 *pwaa++ = smp[s1[j]];
         }
@@ -388,7 +420,9 @@ dpAlign_Protein_Profile(char * seq1, dpAlign_ScoringMatrix * matrix)
     sp->gap = gap;
     sp->ext = ext;
     sp->type = 2;
+    sp->sz = sz;
     free(s1);
+    dpAlign_Striped_Profile(sp);
     return sp;
 }
 
@@ -397,37 +431,47 @@ dpAlign_Protein_Profile(char * seq1, dpAlign_ScoringMatrix * matrix)
     with a protein sequence and return the optimal local alignment score.
  */
 int
-dpAlign_Local_Protein_PhilGreen(dpAlign_SequenceProfile * sp, char * seq2)
+dpAlign_Local_Protein_PhilGreen(dpAlign_SequenceProfile * sp, dpAlign_EncodedSequence * seq2, dpAlign_Workspace * ws)
 {
     int i;
     int N;
-    struct swstr * ss;
     int score;
     unsigned char * s2;
+    dpAlign_Workspace tmp;
 
     if (seq2 == NULL)
 	dpAlign_fatal("Sequence 2 is a NULL pointer!\n");
+    if (seq2->type != DPALIGN_PROTEIN)
+	dpAlign_fatal("Sequence is not encoded as protein!\n");
 
-    N = strlen(seq2);
+    N = seq2->len;
 
-    s2 = (unsigned char *) malloc(N*sizeof(unsigned char));
-    if (s2 == NULL)
-        dpAlign_fatal("Cannot allocate memory for encoded sequence 2!\n");
+/* recode in the alphabet of the profile */
+    ws = use_Workspace(ws, &tmp);
+    s2 = (unsigned char *) dpAlign_Workspace_Buffer(&ws->seqs, &ws->seqsz, N);
+    for (i = 0; i < N; ++i)
+        s2[i] = sp->a[(unsigned char) seq2->seq[i]];
 
-    for (i = 0; i < N; ++i) {
-	if (seq2[i] >= 'a' && seq2[i] <= 'z') seq2[i] -= 0x20;
-        s2[i] = sp->a[seq2[i]];
-    }
-
-    ss = (struct swstr *) malloc(sizeof(struct swstr)*(sp->len+1));
-    if (ss == NULL)
-	dpAlign_fatal("Cannot allocate memory for ss array!\n");
-    score = pgreen(sp->waa, sp->len, s2, N, sp->gap, sp->ext, ss);
-    free(ss);
-    free(s2);
+    score = dpAlign_PhilGreen_Score(sp, s2, N, ws);
+    done_Workspace(ws, &tmp);
     return score;
 }
 
+/*
+    free_dpAlign_SequenceProfile releases a sequence profile created by
+    dpAlign_Protein_Profile, dpAlign_DNA_Profile or dpAlign_Load_Profile.
+ */
+void
+free_dpAlign_SequenceProfile(dpAlign_SequenceProfile * sp)
+{
+    free_dpAlign_StripedProfile(sp->striped);
+    if (sp->map != NULL)
+	munmap(sp->map, sp->mapsz);
+    else
+	free(sp->waa);
+    free(sp);
+}
+
 /* 
     dpAlign_Protein_Profile creates a sequence profile from a DNA sequence.
  */
@@ -436,6 +480,7 @@ dpAlign_DNA_Profile(char * seq1, int match, int mismatch, int gap, int ext)
 {
     int i, j;
     unsigned char * s1;
+    unsigned char * t; /* encoding table */
     int * pwaa;
     dpAlign_SequenceProfile * sp;
 
@@ -444,14 +489,16 @@ dpAlign_DNA_Profile(char * seq1, int match, int mismatch, int gap, int ext)
     sp = (dpAlign_SequenceProfile *) malloc(sizeof(dpAlign_SequenceProfile));
     if (sp == NULL)
 	dpAlign_fatal("Can't allocate memory for Sequence Profile!\n");
+    sp->map = NULL;
     sp->len = strlen(seq1);
     s1 = (unsigned char *) malloc(sp->len*sizeof(unsigned char));
     if (s1 == NULL)
         dpAlign_fatal("Cannot allocate memory for encoded sequence 1!\n");
-    for (i = 0; i < sp->len; ++i) {
-	if (seq1[i] >= 'a' && seq1[i] <= 'z') seq1[i] -= 0x20;
-        s1[i] = dna_encode(seq1[i]);
-    }
+    t = dpAlign_Encode_Table(DPALIGN_DNA);
+    dpAlign_Encode(seq1, sp->len, t, s1, NULL);
+/* anything that isn't IUPAC is recorded as X */
+    for (i = 0; i < 256; ++i)
+        sp->a[i] = t[i] < 17 ? t[i] : 0x10;
     sp->waa = (int *) malloc(sizeof(int)*24*sp->len);
     if (sp->waa == NULL)
         dpAlign_fatal("Can't allocate memory for waa!\n");
@@ -462,7 +509,9 @@ dpAlign_DNA_Profile(char * seq1, int match, int mismatch, int gap, int ext)
     sp->gap = gap;
     sp->ext = ext;
     sp->type = 1;
+    sp->sz = 17;
     free(s1);
+    dpAlign_Striped_Profile(sp);
     return sp;
 }
 
@@ -471,35 +520,189 @@ dpAlign_DNA_Profile(char * seq1, int match, int mismatch, int gap, int ext)
     with a DNA sequence and return the optimal local alignment score.
  */
 int
-dpAlign_Local_DNA_PhilGreen(dpAlign_SequenceProfile * sp, char * seq2)
+dpAlign_Local_DNA_PhilGreen(dpAlign_SequenceProfile * sp, dpAlign_EncodedSequence * seq2, dpAlign_Workspace * ws)
 {
-    int i;
-    int N;
-    struct swstr * ss;
     int score;
-    unsigned char * s2;
+    dpAlign_Workspace tmp;
+
+    if (seq2 == NULL)
+	dpAlign_fatal("Sequence 2 is a NULL pointer!\n");
+    if (seq2->type != DPALIGN_DNA)
+	dpAlign_fatal("Sequence is not encoded as DNA!\n");
+
+    ws = use_Workspace(ws, &tmp);
+    score = dpAlign_PhilGreen_Score(sp, seq2->code, seq2->len, ws);
+    done_Workspace(ws, &tmp);
+    return score;
+}
+
+/*
+    batch_encode uppercases and encodes the n sequences seqs for the
+    sequence profile sp into one buffer, without touching seqs, and
+    returns the buffer. B and N are set to the start and the length of
+    every encoded sequence.
+ */
+static unsigned char *
+batch_encode(dpAlign_SequenceProfile * sp, char ** seqs, int n, unsigned char ** B, int * N)
+{
+    int i, t, total = 0;
+    unsigned char * buf;
+    unsigned char * dna = dpAlign_Encode_Table(DPALIGN_DNA);
+
+    for (t = 0; t < n; ++t) {
+        if (seqs[t] == NULL)
+            dpAlign_fatal("Sequence 2 is a NULL pointer!\n");
+        N[t] = strlen(seqs[t]);
+        total += N[t];
+    }
+    buf = (unsigned char *) malloc(total > 0 ? total : 1);
+    if (buf == NULL)
+        dpAlign_fatal("Cannot allocate memory for encoded sequences!\n");
+    for (t = 0, total = 0; t < n; ++t) {
+        B[t] = buf + total;
+        if (sp->type == DPALIGN_DNA)
+            dpAlign_Encode(seqs[t], N[t], dna, B[t], NULL);
+        else
+            for (i = 0; i < N[t]; ++i)
+                B[t][i] = sp->a[upper_case((unsigned char) seqs[t][i])];
+        total += N[t];
+    }
+    return buf;
+}
+
+/*
+    batch_score encodes the n sequences seqs for the sequence profile sp
+    and scores them many at a time, see dpbatch.c.
+ */
+static void
+batch_score(dpAlign_SequenceProfile * sp, char ** seqs, int n, int * scores)
+{
+    unsigned char ** B;
+    unsigned char * buf;
+    int * N;
+
+    B = (unsigned char **) malloc((n+1)*sizeof(unsigned char *));
+    N = (int *) malloc((n+1)*sizeof(int));
+    if (B == NULL || N == NULL)
+        dpAlign_fatal("Cannot allocate memory for batch of sequences!\n");
+    buf = batch_encode(sp, seqs, n, B, N);
+    dpAlign_PhilGreen_Batch(sp, B, N, n, scores);
+    free(buf);
+    free(B);
+    free(N);
+}
+
+/*
+    dpAlign_Local_Protein_PhilGreen_Batch compares a protein sequence
+    profile with the n protein sequences seqs and puts their optimal local
+    alignment scores in scores.
+ */
+void
+dpAlign_Local_Protein_PhilGreen_Batch(dpAlign_SequenceProfile * sp, char ** seqs, int n, int * scores)
+{
+    batch_score(sp, seqs, n, scores);
+}
+
+/*
+    dpAlign_Local_DNA_PhilGreen_Batch compares a DNA sequence profile
+    with the n DNA sequences seqs and puts their optimal local alignment
+    scores in scores.
+ */
+void
+dpAlign_Local_DNA_PhilGreen_Batch(dpAlign_SequenceProfile * sp, char ** seqs, int n, int * scores)
+{
+    batch_score(sp, seqs, n, scores);
+}
+
+/*
+  dpAlign_Local_DNA_XDrop extends a seed, the pair of residues at
+  pos1 in seq1 and pos2 in seq2 (counting from 1), to a local alignment
+  by X-drop extension to the right and to the left of it: a cell of the
+  Gotoh matrix whose score is more than xdrop below the best seen so far
+  is dropped, and the extension stops once a whole row is dropped. Only
+  the cells around the alignment are computed, so long sequences cost
+  far less than with dpAlign_Local_DNA_MillerMyers. The alignment
+  between the end points found is then run with the Miller-Myers
+  algorithm as usual. The scoring parameters are those of
+  dpAlign_Local_DNA_MillerMyers.
+ */
+dpAlign_AlignOutput *
+dpAlign_Local_DNA_XDrop(dpAlign_EncodedSequence * seq1, dpAlign_EncodedSequence * seq2, int pos1, int pos2, int match, int mismatch, int gap, int ext, int xdrop, dpAlign_Workspace * ws)
+{
+    sw_AlignStruct alignstruct, * as = &alignstruct;
+    dpAlign_Workspace tmp;
+    dpAlign_AlignOutput * ao;
+    int ** s;
 
+    if (seq1 == NULL)
+	dpAlign_fatal("Sequence 1 is a NULL pointer!\n");
     if (seq2 == NULL)
 	dpAlign_fatal("Sequence 2 is a NULL pointer!\n");
 
-    N = strlen(seq2);
+/* initialize DNA scoring matrix */
+    ws = use_Workspace(ws, &tmp);
+    s = dpAlign_DNA_Matrix(match, mismatch)->s;
+
+/* initialize the alignment data structure */
+    init_AlignStruct(as, seq1, seq2, DPALIGN_DNA, NULL, s, gap, ext, ws);
 
-    s2 = (unsigned char *) malloc(N*sizeof(unsigned char));
-    if (s2 == NULL)
-        dpAlign_fatal("Cannot allocate memory for encoded sequence 2!\n");
+/* extend the seed to find the end points */
+    find_ends_xdrop(as, pos1, pos2, xdrop);
 
-    for (i = 0; i < N; ++i) {
-	if (seq2[i] >= 'a' && seq2[i] <= 'z') seq2[i] -= 0x20;
-        s2[i] = dna_encode(seq2[i]);
+/* align the subsequences bounded by the end points */
+    if (as->score > 0)
+	as->score = align(as->s1 + as->start1 - 1, as->s2 + as->start2 - 1, as->end1 - as->start1 + 1, as->end2 - as->start2 + 1, as->s, as->gap, as->ext, as->FF, as->RR, as->spc1, as->spc2, as->ws);
+    ao = traceback(as);
+    done_Workspace(ws, &tmp);
+    return ao;
+}
+
+/*
+  dpAlign_Local_Protein_XDrop is the protein counterpart of
+  dpAlign_Local_DNA_XDrop. matrix is used as in
+  dpAlign_Local_Protein_MillerMyers, BLOSUM62 if it is NULL.
+ */
+dpAlign_AlignOutput *
+dpAlign_Local_Protein_XDrop(dpAlign_EncodedSequence * seq1, dpAlign_EncodedSequence * seq2, int pos1, int pos2, dpAlign_ScoringMatrix * matrix, int xdrop, dpAlign_Workspace * ws)
+{
+    sw_AlignStruct alignstruct, * as = &alignstruct;
+    dpAlign_Workspace tmp;
+    dpAlign_AlignOutput * ao;
+    int ** s;
+    int * a; /* alphabet array, NULL for the BLOSUM62 codes of the sequences */
+    int gap = 7;
+    int ext = 1;
+
+    if (seq1 == NULL)
+	dpAlign_fatal("Sequence 1 is a NULL pointer!\n");
+    if (seq2 == NULL)
+	dpAlign_fatal("Sequence 2 is a NULL pointer!\n");
+
+/* initialize the scoring matrix */
+    ws = use_Workspace(ws, &tmp);
+    if (matrix == NULL) {
+        s = dpAlign_Blosum62_Matrix()->s;
+        a = NULL;
+    }
+    else {
+       a = matrix->a;
+       s = matrix->s;
+       gap = matrix->gap;
+       ext = matrix->ext;
     }
 
-    ss = (struct swstr *) malloc(sizeof(struct swstr)*(sp->len+1));
-    if (ss == NULL)
-	dpAlign_fatal("Cannot allocate memory for ss array!\n");
-    score = pgreen(sp->waa, sp->len, s2, N, sp->gap, sp->ext, ss);
-    free(ss);
-    free(s2);
-    return score;
+/* initialize alignment data structure */
+    init_AlignStruct(as, seq1, seq2, DPALIGN_PROTEIN, a, s, gap, ext, ws);
+
+/* extend the seed to find the end points */
+    find_ends_xdrop(as, pos1, pos2, xdrop);
+
+/* align the subsequences bounded by the end points */
+    if (as->score > 0)
+	as->score = align(as->s1 + as->start1 - 1, as->s2 + as->start2 - 1, as->end1 - as->start1 + 1, as->end2 - as->start2 + 1, as->s, as->gap, as->ext, as->FF, as->RR, as->spc1, as->spc2, as->ws);
+    ao = traceback(as);
+    done_Workspace(ws, &tmp);
+    return ao;
 }
 
 /*
@@ -513,17 +716,19 @@ dpAlign_Local_DNA_PhilGreen(dpAlign_SequenceProfile * sp, char * seq2)
   gap extension as arguments. At the end, it returns the 
   dpAlign_AlignOutput data structure which can be translated into a 
   Bio::SimpleAlign object pretty easily.
+  It aligns with threads threads, or with dpAlign_get_threads() of
+  them if threads is 0.
  */
 dpAlign_AlignOutput *
-dpAlign_Local_Protein_MillerMyers(char * seq1, char * seq2, dpAlign_ScoringMatrix * matrix)
+dpAlign_Local_Protein_MillerMyers(dpAlign_EncodedSequence * seq1, dpAlign_EncodedSequence * seq2, dpAlign_ScoringMatrix * matrix, int threads, dpAlign_Workspace * ws)
 {
-    sw_AlignStruct * as;
+    sw_AlignStruct alignstruct, * as = &alignstruct;
+    dpAlign_Workspace tmp;
+    dpAlign_AlignOutput * ao;
     int ** s;
-    int * a; /* alphabet array */
+    int * a; /* alphabet array, NULL for the BLOSUM62 codes of the sequences */
     int gap = 7;
     int ext = 1;
-    int sz = 24; /* size of alphabet */
-    int i, j;
 
     if (seq1 == NULL)
 	dpAlign_fatal("Sequence 1 is a NULL pointer!\n");
@@ -531,62 +736,35 @@ dpAlign_Local_Protein_MillerMyers(char * seq1, char * seq2, dpAlign_ScoringMatri
 	dpAlign_fatal("Sequence 2 is a NULL pointer!\n");
 
 /* initialize the scoring matrix */
+    ws = use_Workspace(ws, &tmp);
     if (matrix == NULL) {
-    s = (int **) malloc(sz*sizeof(int *));
-    if (s == NULL)
-        dpAlign_fatal("Cannot allocate memory for scoring matrix row!\n");
-    for (i = 0; i < sz; ++i) {
-	s[i] = (int *) malloc(24*sizeof(int));
-	if (s[i] == NULL)
-	    dpAlign_fatal("Cannot allocate memory for scoring matrix col!\n");
-        for (j = 0; j < sz; ++j) {
-	    s[i][j] = blosum62[i][j];
-        }
-    }
-        a = (int *) malloc(256*sizeof(int));
-        if (a == NULL)
-            dpAlign_fatal("Cannot allocate memory for protein encoding array!\n");
-
-        a['A'] = 0x00; a['R'] = 0x01; a['N'] = 0x02; a['D'] = 0x03;
-        a['C'] = 0x04; a['Q'] = 0x05; a['E'] = 0x06; a['G'] = 0x07;
-        a['H'] = 0x08; a['I'] = 0x09; a['L'] = 0x0a; a['K'] = 0x0b;
-        a['M'] = 0x0c; a['F'] = 0x0d; a['P'] = 0x0e; a['S'] = 0x0f;
-        a['T'] = 0x10; a['W'] = 0x11; a['Y'] = 0x12; a['V'] = 0x13;
-        a['B'] = 0x14; a['Z'] = 0x15; a['X'] = 0x16; a['*'] = 0x17;
+        s = dpAlign_Blosum62_Matrix()->s;
+        a = NULL;
     }
     else {
        a = matrix->a;
        s = matrix->s;
        gap = matrix->gap;
        ext = matrix->ext;
-       sz = matrix->sz;
     }
 
 /* initialize alignment data structure */
-    as = init_AlignStruct(seq1, seq2, s, gap, ext);
-
-/* uppercase the sequence and encode it */
-    for (i = 0; i < as->len1; ++i) {
-	if (as->seq1[i] >= 'a' && as->seq1[i] <= 'z') as->seq1[i] -= 0x20;
-        as->s1[i] = a[as->seq1[i]];
-    }
-    for (i = 0; i < as->len2; ++i) {
-	if (as->seq2[i] >= 'a' && as->seq2[i] <= 'z') as->seq2[i] -= 0x20;
-        as->s2[i] = a[as->seq2[i]];
-    }
-
-    if (matrix == NULL)
-        free(a); /* free array after encoding */
+    init_AlignStruct(as, seq1, seq2, DPALIGN_PROTEIN, a, s, gap, ext, ws);
 
 /* locate the end points of the subsequence that results in the maximal score */
     find_ends(as);
 
-    if (as->score < 0)
+    if (as->score < 0) {
+       done_Workspace(ws, &tmp);
        return NULL;
+    }
 
 /* align the subsequences bounded by the end points */
-    as->score = align(as->s1 + as->start1 - 1, as->s2 + as->start2 - 1, as->end1 - as->start1 + 1, as->end2 - as->start2 + 1, as->s, as->gap, as->ext, as->FF, as->RR, as->spc1, as->spc2);
-    return traceback(as);
+    if (as->score > 0)
+	as->score = align_threaded(as->s1 + as->start1 - 1, as->s2 + as->start2 - 1, as->end1 - as->start1 + 1, as->end2 - as->start2 + 1, as->s, as->gap, as->ext, as->FF, as->RR, as->spc1, as->spc2, threads, as->ws);
+    ao = traceback(as);
+    done_Workspace(ws, &tmp);
+    return ao;
 }
 
 /*
@@ -603,17 +781,19 @@ dpAlign_Local_Protein_MillerMyers(char * seq1, char * seq2, dpAlign_ScoringMatri
   gap extension as arguments. At the end, it returns the 
   dpAlign_AlignOutput data structure which can be translated into a 
   Bio::SimpleAlign object pretty easily.
+  It aligns with threads threads, or with dpAlign_get_threads() of
+  them if threads is 0.
  */
 dpAlign_AlignOutput *
-dpAlign_EndsFree_Protein_MillerMyers(char * seq1, char * seq2, dpAlign_ScoringMatrix * matrix)
+dpAlign_EndsFree_Protein_MillerMyers(dpAlign_EncodedSequence * seq1, dpAlign_EncodedSequence * seq2, dpAlign_ScoringMatrix * matrix, int threads, dpAlign_Workspace * ws)
 {
-    sw_AlignStruct * as;
+    sw_AlignStruct alignstruct, * as = &alignstruct;
+    dpAlign_Workspace tmp;
+    dpAlign_AlignOutput * ao;
     int ** s;
-    int * a; /* alphabet array */
+    int * a; /* alphabet array, NULL for the BLOSUM62 codes of the sequences */
     int gap = 7;
     int ext = 1;
-    int sz = 24; /* size of alphabet */
-    int i, j;
 
     if (seq1 == NULL)
 	dpAlign_fatal("Sequence 1 is a NULL pointer!\n");
@@ -621,64 +801,35 @@ dpAlign_EndsFree_Protein_MillerMyers(char * seq1, char * seq2, dpAlign_ScoringMa
 	dpAlign_fatal("Sequence 2 is a NULL pointer!\n");
 
 /* initialize the scoring matrix */
+    ws = use_Workspace(ws, &tmp);
     if (matrix == NULL) {
-    s = (int **) malloc(sz*sizeof(int *));
-    if (s == NULL)
-        dpAlign_fatal("Cannot allocate memory for scoring matrix row!\n");
-    for (i = 0; i < sz; ++i) {
-	s[i] = (int *) malloc(24*sizeof(int));
-	if (s[i] == NULL)
-	    dpAlign_fatal("Cannot allocate memory for scoring matrix col!\n");
-        for (j = 0; j < sz; ++j) {
-	    s[i][j] = blosum62[i][j];
-        }
-    }
-        a = (int *) malloc(256*sizeof(int));
-        if (a == NULL)
-            dpAlign_fatal("Cannot allocate memory for protein encoding array!\n");
-
-        a['A'] = 0x00; a['R'] = 0x01; a['N'] = 0x02; a['D'] = 0x03;
-        a['C'] = 0x04; a['Q'] = 0x05; a['E'] = 0x06; a['G'] = 0x07;
-        a['H'] = 0x08; a['I'] = 0x09; a['L'] = 0x0a; a['K'] = 0x0b;
-        a['M'] = 0x0c; a['F'] = 0x0d; a['P'] = 0x0e; a['S'] = 0x0f;
-        a['T'] = 0x10; a['W'] = 0x11; a['Y'] = 0x12; a['V'] = 0x13;
-        a['B'] = 0x14; a['Z'] = 0x15; a['X'] = 0x16; a['*'] = 0x17;
+        s = dpAlign_Blosum62_Matrix()->s;
+        a = NULL;
     }
     else {
        a = matrix->a;
        s = matrix->s;
        gap = matrix->gap;
        ext = matrix->ext;
-       sz = matrix->sz;
     }
 
 /* initialize alignment data structure */
-    as = init_AlignStruct(seq1, seq2, s, gap, ext);
-
-/* uppercase the sequence and encode it */
-    for (i = 0; i < as->len1; ++i) {
-	if (as->seq1[i] >= 'a' && as->seq1[i] <= 'z') as->seq1[i] -= 0x20;
-        as->s1[i] = a[as->seq1[i]];
-    }
-    for (i = 0; i < as->len2; ++i) {
-	if (as->seq2[i] >= 'a' && as->seq2[i] <= 'z') as->seq2[i] -= 0x20;
-        as->s2[i] = a[as->seq2[i]];
-    }
-
-    if (matrix == NULL)
-        free(a); /* free array after encoding */
+    init_AlignStruct(as, seq1, seq2, DPALIGN_PROTEIN, a, s, gap, ext, ws);
 
 /* locate the end points of the subsequence that results in the maximal score */
     find_endsfree(as);
 
 /* align the subsequences bounded by the end points */
-    as->score = align(as->s1 + as->start1 - 1, as->s2 + as->start2 - 1, as->end1 - as->start1 + 1, as->end2 - as->start2 + 1, as->s, as->gap, as->ext, as->FF, as->RR, as->spc1 + as->start1 - 1, as->spc2 + as->start2 - 1);
+    if (as->score > 0)
+	as->score = align_threaded(as->s1 + as->start1 - 1, as->s2 + as->start2 - 1, as->end1 - as->start1 + 1, as->end2 - as->start2 + 1, as->s, as->gap, as->ext, as->FF, as->RR, as->spc1 + as->start1 - 1, as->spc2 + as->start2 - 1, threads, as->ws);
 /* make global alignment */
     as->start1 = 1;
     as->end1 = as->len1;
     as->start2 = 1;
     as->end2 = as->len2;
-    return traceback(as);
+    ao = traceback(as);
+    done_Workspace(ws, &tmp);
+    return ao;
 }
 
 /* 
@@ -688,17 +839,42 @@ dpAlign_EndsFree_Protein_MillerMyers(char * seq1, char * seq2, dpAlign_ScoringMa
   Currently, we only support "BLOSUM62" matrix.
   dpAlign_Global_Protein_MillerMyers returns a dpAlign_AlignOutput data
   structure that can be easily converted into a Bio::SimpleAlign object.
+  It aligns with threads threads, or with dpAlign_get_threads() of
+  them if threads is 0.
+ */
+dpAlign_AlignOutput *
+dpAlign_Global_Protein_MillerMyers(dpAlign_EncodedSequence * seq1, dpAlign_EncodedSequence * seq2, dpAlign_ScoringMatrix * matrix, int threads, dpAlign_Workspace * ws)
+{
+    return global_Protein(seq1, seq2, matrix, 0, threads, ws);
+}
+
+/*
+  dpAlign_Global_Protein_MillerMyers_Banded returns the same optimal
+  global alignment as dpAlign_Global_Protein_MillerMyers but only
+  computes a band of the dynamic programming matrix that is widened
+  until it provably holds the optimum, see align_banded.
  */
 dpAlign_AlignOutput *
-dpAlign_Global_Protein_MillerMyers(char * seq1, char * seq2, dpAlign_ScoringMatrix * matrix)
+dpAlign_Global_Protein_MillerMyers_Banded(dpAlign_EncodedSequence * seq1, dpAlign_EncodedSequence * seq2, dpAlign_ScoringMatrix * matrix, dpAlign_Workspace * ws)
 {
-    sw_AlignStruct * as;
+    return global_Protein(seq1, seq2, matrix, 1, 1, ws);
+}
+
+/*
+  global_Protein does the work of the global protein alignments, banded
+  or not.
+ */
+static dpAlign_AlignOutput *
+global_Protein(dpAlign_EncodedSequence * seq1, dpAlign_EncodedSequence * seq2, dpAlign_ScoringMatrix * matrix, int banded, int threads, dpAlign_Workspace * ws)
+{
+    sw_AlignStruct alignstruct, * as = &alignstruct;
+    dpAlign_Workspace tmp;
+    dpAlign_AlignOutput * ao;
     int ** s;
-    int * a; /* alphabet array */
+    int * a; /* alphabet array, NULL for the BLOSUM62 codes of the sequences */
     int gap = 7;
     int ext = 1;
     int sz = 24; /* size of alphabet */
-    int i, j;
 
     if (seq1 == NULL)
 	dpAlign_fatal("Sequence 1 is a NULL pointer!\n");
@@ -706,28 +882,10 @@ dpAlign_Global_Protein_MillerMyers(char * seq1, char * seq2, dpAlign_ScoringMatr
 	dpAlign_fatal("Sequence 2 is a NULL pointer!\n");
 
 /* initialize the scoring matrix */
+    ws = use_Workspace(ws, &tmp);
     if (matrix == NULL) {
-        s = (int **) malloc(sz*sizeof(int *));
-        if (s == NULL)
-            dpAlign_fatal("Cannot allocate memory for scoring matrix row!\n");
-        for (i = 0; i < sz; ++i) {
-	    s[i] = (int *) malloc(sz*sizeof(int));
-	    if (s[i] == NULL)
-	        dpAlign_fatal("Cannot allocate memory for scoring matrix col!\n");
-            for (j = 0; j < sz; ++j) {
-	        s[i][j] = blosum62[i][j];
-            }
-        }
-        a = (int *) malloc(256*sizeof(int));
-        if (a == NULL)
-            dpAlign_fatal("Cannot allocate memory for protein encoding array!\n");
-
-        a['A'] = 0x00; a['R'] = 0x01; a['N'] = 0x02; a['D'] = 0x03;
-        a['C'] = 0x04; a['Q'] = 0x05; a['E'] = 0x06; a['G'] = 0x07;
-        a['H'] = 0x08; a['I'] = 0x09; a['L'] = 0x0a; a['K'] = 0x0b;
-        a['M'] = 0x0c; a['F'] = 0x0d; a['P'] = 0x0e; a['S'] = 0x0f;
-        a['T'] = 0x10; a['W'] = 0x11; a['Y'] = 0x12; a['V'] = 0x13;
-        a['B'] = 0x14; a['Z'] = 0x15; a['X'] = 0x16; a['*'] = 0x17;
+        s = dpAlign_Blosum62_Matrix()->s;
+        a = NULL;
     }
     else {
        a = matrix->a;
@@ -738,30 +896,15 @@ dpAlign_Global_Protein_MillerMyers(char * seq1, char * seq2, dpAlign_ScoringMatr
     }
 
 /* initialize alignment data structure */
-    as = init_AlignStruct(seq1, seq2, s, gap, ext);
-
-/* uppercase the sequence and encode it */
-    for (i = 0; i < as->len1; ++i) {
-	if (as->seq1[i] >= 'a' && as->seq1[i] <= 'z') as->seq1[i] -= 0x20;
-        as->s1[i] = a[as->seq1[i]];
-    }
-    for (i = 0; i < as->len2; ++i) {
-	if (as->seq2[i] >= 'a' && as->seq2[i] <= 'z') as->seq2[i] -= 0x20;
-        as->s2[i] = a[as->seq2[i]];
-    }
-
-    if (matrix == NULL)
-        free(a); /* free array after encoding */
+    init_AlignStruct(as, seq1, seq2, DPALIGN_PROTEIN, a, s, gap, ext, ws);
 
 /* initialize the spaces arrays */
-    as->spc1 = (int *) calloc(as->len1 + 1, sizeof(int));
-    if (as->spc1 == NULL) 
-	dpAlign_fatal("Can't allocate memory for spaces array for seq 1!\n");
-    as->spc2 = (int *) calloc(as->len2 + 1, sizeof(int));
-    if (as->spc2 == NULL) 
-	dpAlign_fatal("Can't allocate memory for spaces array for seq 2!\n");
+    init_spaces(as, as->len1 + 1, as->len2 + 1);
 /* align the subsequences bounded by the end points */
-    as->score = align(as->s1, as->s2, as->len1, as->len2, as->s, as->gap, as->ext, as->FF, as->RR, as->spc1, as->spc2);
+    if (banded)
+        as->score = align_banded(as->s1, as->s2, as->len1, as->len2, as->s, sz, as->gap, as->ext, as->FF, as->RR, as->spc1, as->spc2, as->ws);
+    else
+        as->score = align_threaded(as->s1, as->s2, as->len1, as->len2, as->s, as->gap, as->ext, as->FF, as->RR, as->spc1, as->spc2, threads, as->ws);
 
 /* free scoring matrix 
     for (i = 0; i < sz; ++i) {
@@ -776,379 +919,657 @@ dpAlign_Global_Protein_MillerMyers(char * seq1, char * seq2, dpAlign_ScoringMatr
     as->start2 = 1;
     as->end2 = as->len2;
 
-    return traceback(as);
+    ao = traceback(as);
+    done_Workspace(ws, &tmp);
+    return ao;
 }
 
-/* 
-  init_AlignStruct initializes the alignment data structure by allocating
-  memory and setting values. It returns a sw_AlignStruct that is 
-  initialized based on the two sequence strings seq1 and seq2, the
-  scoring matrix s, the gap opening cost gap and gap extension cost ext.
+/*
+  init_AlignStruct initializes the alignment data structure as by
+  setting values and taking its arrays from the workspace ws. It is
+  initialized based on the two encoded sequences seq1 and seq2, which
+  must both be of type, the scoring matrix s, the gap opening cost gap
+  and gap extension cost ext. If the alphabet array a isn't NULL the
+  sequences are recoded with it, else their own codes are used.
  */
-static sw_AlignStruct *
-init_AlignStruct(char * seq1, char * seq2, int ** s, int gap, int ext)
+static void
+init_AlignStruct(sw_AlignStruct * as, dpAlign_EncodedSequence * seq1, dpAlign_EncodedSequence * seq2, int type, int * a, int ** s, int gap, int ext, dpAlign_Workspace * ws)
 {
-    sw_AlignStruct * as = (sw_AlignStruct *) calloc(1, sizeof(sw_AlignStruct));
+    int i;
+
+    memset(as, 0, sizeof(sw_AlignStruct));
+    as->ws = ws;
 
-    if (as == NULL) 
-	dpAlign_fatal("Cannot allocate memory for dpAlign_AlignStruct!\n");
+    if (seq1->type != type || seq2->type != type)
+	dpAlign_fatal(type == DPALIGN_DNA ? "Sequence is not encoded as DNA!\n" : "Sequence is not encoded as protein!\n");
 
-    as->seq1 = seq1;
-    as->len1 = strlen(seq1);
+    as->seq1 = seq1->seq;
+    as->len1 = seq1->len;
     if (as->len1 <= 0) 
 	dpAlign_fatal("Sequence 1 is has non-positive length!\n");
 
-    as->seq2 = seq2;
-    as->len2 = strlen(seq2);
+    as->seq2 = seq2->seq;
+    as->len2 = seq2->len;
     if (as->len2 <= 0) 
 	dpAlign_fatal("Sequence 2 is has non-positive length!\n");
 
-/* allocate memory for Gotoh arrays */
-    as->FF = (struct swstr *) calloc((as->len2+1), sizeof(struct swstr));
-    if (as->FF == NULL)
-        dpAlign_fatal("Can't allocate memory for forward swstr array!\n");
-    as->RR = (struct swstr *) calloc((as->len2+1), sizeof(struct swstr));
-    if (as->RR == NULL)
-        dpAlign_fatal("Can't allocate memory for reverse swstr array!\n");
-
-/* allocate memory for encoded sequence string */
-    as->s1 = (unsigned char *) malloc(as->len1*sizeof(unsigned char));
-    if (as->s1 == NULL)
-        dpAlign_fatal("Cannot allocate memory for encoded sequence 1!\n");
-    as->s2 = (unsigned char *) malloc(as->len2*sizeof(unsigned char));
-    if (as->s2 == NULL)
-        dpAlign_fatal("Cannot allocate memory for encoded sequence 2!\n");
+/* Gotoh arrays, the local and ends-free passes count on them being zero */
+    as->FF = (struct swstr *) dpAlign_Workspace_Buffer(&ws->rows, &ws->rowsz, 2*(as->len2+1)*sizeof(struct swstr));
+    as->RR = as->FF + as->len2+1;
+    memset(as->FF, 0, 2*(as->len2+1)*sizeof(struct swstr));
+
+/* encoded sequence strings */
+    if (a == NULL) {
+	as->s1 = seq1->code;
+	as->s2 = seq2->code;
+    }
+    else {
+	as->s1 = (unsigned char *) dpAlign_Workspace_Buffer(&ws->seqs, &ws->seqsz, as->len1 + as->len2);
+	as->s2 = as->s1 + as->len1;
+	for (i = 0; i < as->len1; ++i)
+	    as->s1[i] = a[(unsigned char) as->seq1[i]];
+	for (i = 0; i < as->len2; ++i)
+	    as->s2[i] = a[(unsigned char) as->seq2[i]];
+    }
 
     as->gap = gap;
     as->ext = ext;
     as->s = s;
+}
+
+/*
+  init_spaces sets up the gap arrays of as with n1 and n2 cells, all
+  zero.
+ */
+static void
+init_spaces(sw_AlignStruct * as, int n1, int n2)
+{
+    dpAlign_Workspace * ws = as->ws;
+
+    as->spc1 = (int *) dpAlign_Workspace_Buffer(&ws->spcs, &ws->spcsz, (n1 + n2)*sizeof(int));
+    as->spc2 = as->spc1 + n1;
+    memset(as->spc1, 0, (n1 + n2)*sizeof(int));
+}
 
-    return as;
+/*
+  new_dpAlign_Workspace creates an empty workspace. Passed to the
+  alignment and scoring functions, it keeps the arrays they need from
+  one call to the next, only growing them when a longer sequence comes
+  along, so a run of many alignments doesn't allocate memory for every
+  one. A workspace must not be used by two calls at the same time.
+ */
+dpAlign_Workspace *
+new_dpAlign_Workspace(void)
+{
+    dpAlign_Workspace * ws;
+
+    ws = (dpAlign_Workspace *) calloc(1, sizeof(dpAlign_Workspace));
+    if (ws == NULL)
+	dpAlign_fatal("Can't allocate memory for workspace!\n");
+    return ws;
+}
+
+/* clear_Workspace releases the arrays of the workspace ws */
+static void
+clear_Workspace(dpAlign_Workspace * ws)
+{
+    free(ws->rows);
+    free(ws->seqs);
+    free(ws->spcs);
+    free(ws->simd);
+    free(ws->bits);
+    free(ws->orgs);
+    free(ws->trace);
+    memset(ws, 0, sizeof(dpAlign_Workspace));
+}
+
+/*
+  free_dpAlign_Workspace releases a workspace created by
+  new_dpAlign_Workspace.
+ */
+void
+free_dpAlign_Workspace(dpAlign_Workspace * ws)
+{
+    clear_Workspace(ws);
+    free(ws);
+}
+
+/* free_dpAlign_AlignOutput releases an alignment made by the aligners */
+void
+free_dpAlign_AlignOutput(dpAlign_AlignOutput * out)
+{
+    free(out->aln1);
+    free(out->aln2);
+    free(out->cigar);
+    free(out);
+}
+
+/*
+  dpAlign_Workspace_Buffer returns the buffer *buf of *sz bytes, first
+  replacing it with one of at least need bytes if it is smaller. The
+  buffer is aligned for the SIMD kernels; what it held is lost when it
+  grows.
+ */
+void *
+dpAlign_Workspace_Buffer(void ** buf, size_t * sz, size_t need)
+{
+    if (need > *sz || *buf == NULL) {
+	free(*buf);
+	if (need < 2 * *sz)
+	    need = 2 * *sz;
+	if (posix_memalign(buf, 32, need > 0 ? need : 1) != 0)
+	    dpAlign_fatal("Can't allocate memory for workspace!\n");
+	*sz = need;
+    }
+    return *buf;
+}
+
+/*
+  use_Workspace returns ws, or if it is NULL the temporary workspace tmp
+  emptied for the length of one call.
+ */
+static dpAlign_Workspace *
+use_Workspace(dpAlign_Workspace * ws, dpAlign_Workspace * tmp)
+{
+    if (ws != NULL)
+	return ws;
+    memset(tmp, 0, sizeof(dpAlign_Workspace));
+    return tmp;
+}
+
+/* done_Workspace releases ws if it is the temporary workspace tmp */
+static void
+done_Workspace(dpAlign_Workspace * ws, dpAlign_Workspace * tmp)
+{
+    if (ws == tmp)
+	clear_Workspace(tmp);
+}
+
+/*
+  gapped_seq returns a newly allocated copy of the len residues of seq
+  with spc[i] gaps inserted before residue i and spc[len] gaps after
+  the last one. The length is counted
+  first, so the string is written once straight into a buffer of the
+  right size.
+ */
+static char *
+gapped_seq(char * seq, int * spc, int len)
+{
+    char * out, * p;
+    size_t n = (size_t) (len > 0 ? len : 0);
+    int i;
+
+    for (i = 0; i <= len; ++i)
+	n += (size_t) (spc[i] > 0 ? spc[i] : 0);
+    out = (char *) malloc(n + 1);
+    if (out == NULL)
+	dpAlign_fatal("Can't allocate memory for aligned sequence!\n");
+    p = out;
+    for (i = 0; i < len; ++i) {
+	memset(p, '-', spc[i]);
+	p += spc[i];
+	*p++ = seq[i];
+    }
+    memset(p, '-', spc[len]);
+    p[spc[len]] = '\0';
+    return out;
+}
+
+/*
+  walk_columns goes through the columns of the alignment in as, which
+  has spc1[i] gaps before residue i of aligned subsequence 1 and spc2[j]
+  before residue j of aligned subsequence 2, without building the gapped
+  strings. It counts the identities, mismatches and gaps into ao and
+  returns the number of CIGAR operations. If cigar is not NULL, the
+  CIGAR string is written there as well: M for a pair of residues, I for
+  a residue of sequence 1 against a gap and D for a residue of sequence
+  2 against a gap.
+ */
+static int
+walk_columns(sw_AlignStruct * as, dpAlign_AlignOutput * ao, char * cigar)
+{
+    char * seq1 = as->seq1 + as->start1 - 1;
+    char * seq2 = as->seq2 + as->start2 - 1;
+    int n1 = as->end1 - as->start1 + 1;
+    int n2 = as->end2 - as->start2 + 1;
+    int i = 0, j = 0;
+    int g1 = as->spc1[0], g2 = as->spc2[0];
+    int run = 0, runs = 0;
+    char op, prev = 0;
+    char c1, c2;
+
+    ao->matches = ao->mismatches = ao->gap_opens = ao->gap_exts = 0;
+    while (i < n1 || g1 > 0) {
+	c1 = g1 > 0 ? '-' : seq1[i];
+	c2 = g2 > 0 || j == n2 ? '-' : seq2[j];
+	if (g1 > 0) --g1; else g1 = as->spc1[++i];
+	if (g2 > 0) --g2; else if (j < n2) g2 = as->spc2[++j];
+	if (c1 != '-' && c2 != '-') {
+	    op = 'M';
+	    if (c1 == c2)
+		++ao->matches;
+	    else
+		++ao->mismatches;
+	} else if (c1 != '-' || c2 != '-') {
+	    op = c1 != '-' ? 'I' : 'D';
+	    if (op != prev)
+		++ao->gap_opens;
+	    ++ao->gap_exts;
+	} else
+	    continue;
+	if (op != prev && prev != 0) {
+	    if (cigar != NULL)
+		cigar += sprintf(cigar, "%d%c", run, prev);
+	    ++runs;
+	    run = 0;
+	}
+	prev = op;
+	++run;
+    }
+    if (prev != 0) {
+	if (cigar != NULL)
+	    sprintf(cigar, "%d%c", run, prev);
+	++runs;
+    } else if (cigar != NULL)
+	*cigar = '\0';
+    return runs;
 }
 
 /* 
   traceback takes a sw_AlignStruct with the gap arrays computed by
   align and inserts gaps into the aligned subsequences. Then it
   returns the dpAlign_AlignOutput that is to be converted into a
-  Bio::SimpleAlign object.
+  Bio::SimpleAlign object. Which of the gapped strings and the CIGAR
+  string are made depends on the output flags of the workspace; the
+  alignment statistics are always filled in.
  */
 static dpAlign_AlignOutput * 
 traceback(sw_AlignStruct * as) 
 {
     dpAlign_AlignOutput * ao;
-    int aln1_len = as->end1 - as->start1 + 1;
-    int aln2_len = as->end2 - as->start2 + 1;
-    char aln_seq1[as->len1+as->len2+1];
-    char aln_seq2[as->len1+as->len2+1];
-    int i, j, k;
-
-/* free all allocated memory before we exit this module */
-    free(as->s1);
-    free(as->s2);
-    free(as->FF);
-    free(as->RR);
+    int output = as->ws->output != 0 ? as->ws->output : DPALIGN_OUTPUT_ALN;
+    int runs;
 
     ao = (dpAlign_AlignOutput *) calloc(1, sizeof(dpAlign_AlignOutput));
     if (ao == NULL)
 	dpAlign_fatal("Can't allocate memory for AlignOutput!\n");
 
     ao->score = as->score;
-/* insert gaps to sequence 1 */
-    k = 0;
-    for (i = 0; i <= aln1_len; ++i) {
-	for (j = 0; j < as->spc1[i]; ++j)
-	    aln_seq1[k++] = '-';
-	aln_seq1[k++] = as->seq1[i+as->start1-1];
+    if (output & DPALIGN_OUTPUT_ALN) {
+	ao->aln1 = gapped_seq(as->seq1 + as->start1 - 1, as->spc1, as->end1 - as->start1 + 1);
+	ao->aln2 = gapped_seq(as->seq2 + as->start2 - 1, as->spc2, as->end2 - as->start2 + 1);
     }
-    aln_seq1[k-1] = '\0';
-
-    ao->aln1 = (char *) malloc(k*sizeof(char));
-    if (ao->aln1 == NULL)
-        dpAlign_fatal("Can't allocate memory for aln1!\n");
-    strcpy(ao->aln1, aln_seq1);
-
-/* insert gaps to sequence 2 */
-    k = 0;
-    for (i = 0; i <= aln2_len; ++i) {
-	for (j = 0; j < as->spc2[i]; ++j)
-	    aln_seq2[k++] = '-';
-	aln_seq2[k++] = as->seq2[i+as->start2-1];
+    runs = walk_columns(as, ao, NULL);
+    if (output & DPALIGN_OUTPUT_CIGAR) {
+/* an operation takes at most 10 digits and its letter */
+	ao->cigar = (char *) malloc(11*runs + 1);
+	if (ao->cigar == NULL)
+	    dpAlign_fatal("Can't allocate memory for CIGAR!\n");
+	walk_columns(as, ao, ao->cigar);
     }
-    aln_seq2[k-1] = '\0';
-
-    ao->aln2 = (char *) malloc(k*sizeof(char));
-    if (ao->aln2 == NULL)
-        dpAlign_fatal("Can't allocate memory for aln1!\n");
-    strcpy(ao->aln2, aln_seq2);
-
     ao->start1 = as->start1;
     ao->start2 = as->start2;
     ao->end1 = as->end1;
     ao->end2 = as->end2;      
 
-/* free the rest of allocated memory */
-    free(as->spc1);
-    free(as->spc2);
-    free(as);
     return ao;
 }
 
+/*
+  start_origins returns zeroed arrays of n+1 start points for the H and
+  E values of a row of Gotoh cells.
+ */
+static struct swstart *
+start_origins(sw_AlignStruct * as, int n)
+{
+    dpAlign_Workspace * ws = as->ws;
+    struct swstart * O;
+
+    O = (struct swstart *) dpAlign_Workspace_Buffer(&ws->orgs, &ws->orgsz, (n+1)*sizeof(struct swstart));
+    memset(O, 0, (n+1)*sizeof(struct swstart));
+    return O;
+}
+
 /* 
   find_ends set the end points in the sw_AlignStruct by employing
-  the Gotoh way of calculating alignment score. First it goes forward
-  to find the end points. Then from there it goes backwards to find
-  the start points. There are no return values, the end points 
-  in sw_AlignStruct are set before the function returns.
+  the Gotoh way of calculating alignment score. Every cell carries
+  the start point of the best alignment ending in it along with its
+  score, so a single forward pass finds both the end points and the
+  start points. Of the alignments ending at the end points, the one
+  that starts last is taken, as the backward pass that this replaces
+  did. There are no return values, the end points in sw_AlignStruct
+  are set before the function returns.
  */
 static void
 find_ends(sw_AlignStruct * as)
 {
     struct swstr * F = as->FF;
-    struct swstr * R = as->RR;
+    struct swstart * O = start_origins(as, as->len2);
     int M = as->len1;
     int N = as->len2;
     unsigned char * A = as->s1;
     unsigned char * B = as->s2;
     struct swstr * swp;
+    struct swstart * op;
     int i, j;
     int from, P;
+    long long ofrom, oP; /* start points of from and P */
     int c; /* score of a cell */
+    long long oc; /* start point of c */
     int d; /* down value in Q array */
+    long long od; /* start point of d */
+    int u;
     int ** s = as->s;
     int * ss; 
     int g = as->gap;
     int e = as->ext;
     int h = g + e;
-    int score1 = 0, score2 = 0;
+    int score1 = 0;
 
-/* find end points */
     for (i = 0; i < M; ++i) {
 	F[0].H = P = from = c = 0;
+	ofrom = oP = oc = 0;
 	ss = s[A[i]];
-	for (swp = F+1, j = 0; swp <= F+N; ++swp, ++j) {
-	    if ((c = c - h) > (P = P - e)) P = c;
-	    if ((c = swp->H - h) > (d = swp->E - e)) d = c;
+	for (swp = F+1, op = O+1, j = 0; swp <= F+N; ++swp, ++op, ++j) {
+	    c = c - h;
+	    P = P - e;
+	    if (better_start(c, oc, P, oP)) { P = c; oP = oc; }
+	    u = swp->H - h;
+	    d = swp->E - e;
+	    od = op->E;
+	    if (better_start(u, op->H, d, od)) { d = u; od = op->H; }
+/* an alignment scoring nothing is better started afresh here */
 	    c = from + ss[B[j]];
+	    oc = from > 0 ? ofrom : start_point(i+1, j+1);
 	    if (c < 0) c = 0;
-	    if (P > c) c = P;
-	    if (d > c) c = d;
+	    if (better_start(P, oP, c, oc)) { c = P; oc = oP; }
+	    if (better_start(d, od, c, oc)) { c = d; oc = od; }
 	    swp->E = d;
+	    op->E = od;
 	    from = swp->H;
+	    ofrom = op->H;
 	    swp->H = c;
+	    op->H = oc;
 	    if (c > score1) {
 		score1 = c;
 		as->end1 = i+1;
 		as->end2 = j+1;
+		as->start1 = start_i(oc);
+		as->start2 = start_j(oc);
 	    } 
 	}
     }
 
-/* find start point */
-    M = as->end1;
-    N = as->end2;
-    for (i = M-1; i >= 0; --i) {
-	R[0].H = P = from = c = 0;
-	ss = s[A[i]];
-	for (swp = R+1, j = N-1; swp <= R+N; ++swp, --j) {
-	    if ((c = c - h) > (P = P - e)) P = c;
-	    if ((c = swp->H - h) > (d = swp->E - e)) d = c;
-	    c = from + ss[B[j]];
-	    if (c < 0) c = 0;
+    as->score = score1;
+/* no pair scores above zero, the local alignment is empty */
+    if (score1 == 0) {
+	as->start1 = as->start2 = 1;
+	as->end1 = as->end2 = 0;
+    }
+/* initialize the spaces arrays */
+    init_spaces(as, as->end1 - as->start1 + 2, as->end2 - as->start2 + 2);
+}
+
+/*
+  xdrop_extend runs the X-drop extension from the corner before the M
+  residues A[0], A[dir], A[2*dir], ... and the N residues B[0], B[dir],
+  ... so dir is 1 to extend to the right and -1 to extend to the left.
+  Only the cells of a row from the first cell kept in the row before to
+  one past the last, and those a gap reaches beyond, are computed. It
+  returns the best score and puts how many residues of A and B it
+  spans in *bi and *bj, 0 if no cell scores above zero.
+ */
+static int
+xdrop_extend(sw_AlignStruct * as, unsigned char * A, unsigned char * B, int M, int N, int dir, int xdrop, int * bi, int * bj)
+{
+    struct swstr * F = as->FF;
+    int ** s = as->s;
+    int * ss;
+    int g = as->gap;
+    int e = as->ext;
+    int h = g + e;
+    int neg = INT_MIN / 4; /* a dropped cell */
+    int i, j, lo, hi, newlo, newhi;
+    int from, P, c, d, up, upE;
+    int best = 0;
+
+    *bi = *bj = 0;
+/* the first row is a gap in sequence 1 */
+    F[0].H = 0;
+    F[0].E = neg;
+    for (hi = 0, j = 1; j <= N && -(g + e*j) >= -xdrop; hi = j++) {
+	F[j].H = -(g + e*j);
+	F[j].E = neg;
+    }
+    for (lo = 0, i = 1; i <= M; ++i) {
+	ss = s[A[(i-1)*dir]];
+	from = neg;
+	P = c = neg;
+	newlo = newhi = -1;
+	for (j = lo; j <= N; ++j) {
+	    if (j > hi) {
+		if (j > hi + 1 && c == neg)
+		    break; /* nothing left to extend the row with */
+		up = upE = neg;
+	    } else {
+		up = F[j].H;
+		upE = F[j].E;
+	    }
+/* gap in sequence 2, gap in sequence 1, then match */
+	    if ((d = up - h) < upE - e) d = upE - e;
+	    if (j > 0) {
+		if ((P = P - e) < c - h) P = c - h;
+		c = from + ss[B[(j-1)*dir]];
+	    } else
+		c = neg;
+	    from = up;
 	    if (P > c) c = P;
 	    if (d > c) c = d;
-	    swp->E = d;
-	    from = swp->H;
-	    swp->H = c;
-	    if (c > score2) {
-		score2 = c;
-		as->start1 = i+1;
-		as->start2 = j+1;
-		if (c >= score1) goto found; // score same as before, done!
-	    } 
+	    if (c < best - xdrop) {
+		c = P = d = neg;
+	    } else {
+		if (newlo < 0)
+		    newlo = j;
+		newhi = j;
+		if (c > best) {
+		    best = c;
+		    *bi = i;
+		    *bj = j;
+		}
+	    }
+	    F[j].H = c;
+	    F[j].E = d;
 	}
+	if (newlo < 0)
+	    break;
+	lo = newlo;
+	hi = newhi;
     }
+    return best;
+}
 
-found:
-    as->score = score1;
+/*
+  find_ends_xdrop sets the end points in the sw_AlignStruct to those
+  of the X-drop extensions to the right and to the left of the seed at
+  pos1 and pos2, see dpAlign_Local_DNA_XDrop. The score is the sum of
+  the two extensions.
+ */
+static void
+find_ends_xdrop(sw_AlignStruct * as, int pos1, int pos2, int xdrop)
+{
+    int score1, score2;
+    int bi1, bj1, bi2, bj2;
+
+    if (pos1 < 1 || pos1 > as->len1 || pos2 < 1 || pos2 > as->len2)
+	dpAlign_fatal("Seed is outside the sequences!\n");
+    if (xdrop < 0)
+	dpAlign_fatal("X-drop must not be negative!\n");
+
+/* to the right, starting with the seed */
+    score1 = xdrop_extend(as, as->s1 + pos1 - 1, as->s2 + pos2 - 1, as->len1 - pos1 + 1, as->len2 - pos2 + 1, 1, xdrop, &bi1, &bj1);
+/* to the left of the seed */
+    score2 = xdrop_extend(as, as->s1 + pos1 - 2, as->s2 + pos2 - 2, pos1 - 1, pos2 - 1, -1, xdrop, &bi2, &bj2);
+
+    as->start1 = pos1 - bi2;
+    as->start2 = pos2 - bj2;
+    as->end1 = pos1 - 1 + bi1;
+    as->end2 = pos2 - 1 + bj1;
+    as->score = score1 + score2;
 /* initialize the spaces arrays */
-    as->spc1 = (int *) calloc(as->end1 - as->start1 + 2, sizeof(int));
-    if (as->spc1 == NULL) 
-	dpAlign_fatal("Can't allocate memory for spaces array for seq 1!\n");
-    as->spc2 = (int *) calloc(as->end2 - as->start2 + 2, sizeof(int));
-    if (as->spc2 == NULL) 
-	dpAlign_fatal("Can't allocate memory for spaces array for seq 2!\n");
+    init_spaces(as, as->end1 - as->start1 + 2, as->end2 - as->start2 + 2);
 }
 
+/*
+  find_endsfree does for an ends-free alignment what find_ends does for
+  a local one. The gaps before the start points and after the end
+  points are free, so a start point is where the alignment leaves the
+  first row or column of the matrix: the cells there carry the start
+  point of an alignment that begins right after them.
+ */
 static void
 find_endsfree(sw_AlignStruct * as)
 {
    struct swstr * F = as->FF;
-   struct swstr * R = as->RR;
+   struct swstart * O = start_origins(as, as->len2);
    int M = as->len1;
    int N = as->len2;
    unsigned char * A = as->s1;
    unsigned char * B = as->s2;
    struct swstr * swp;
+   struct swstart * op;
    int i, j;
    int from, P;
+   long long ofrom, oP; /* start points of from and P */
    int c; /* score of a cell */
+   long long oc; /* start point of c */
    int d; /* down value in Q array */
+   long long od; /* start point of d */
+   int u;
    int ** s = as->s;
    int * ss; 
    int g = as->gap;
    int e = as->ext;
    int h = g + e;
-   int score1 = 0, score2 = 0;
+   int score1 = 0;
 
    for (i = 0; i < N; ++i)
       F[i].E = -g;
+   for (i = 0; i <= N; ++i)
+      O[i].H = O[i].E = start_point(1, i+1);
 
 /* find end points */
    for (i = 0; i < M-1; ++i) {
       from = c = 0;
       P = -g;
+      ofrom = start_point(i+1, 1);
+      oc = oP = start_point(i+2, 1);
       ss = s[A[i]];
-      for (swp = F+1, j = 0; swp < F+N; ++swp, ++j) {
-         if ((c = c - h) > (P = P - e)) P = c;
-         if ((c = swp->H - h) > (d = swp->E - e)) d = c;
+      for (swp = F+1, op = O+1, j = 0; swp < F+N; ++swp, ++op, ++j) {
+         c = c - h;
+         P = P - e;
+         if (better_start(c, oc, P, oP)) { P = c; oP = oc; }
+         u = swp->H - h;
+         d = swp->E - e;
+         od = op->E;
+         if (better_start(u, op->H, d, od)) { d = u; od = op->H; }
          c = from + ss[B[j]];
-         if (P > c) c = P;
-         if (d > c) c = d;
+         oc = ofrom;
+         if (better_start(P, oP, c, oc)) { c = P; oc = oP; }
+         if (better_start(d, od, c, oc)) { c = d; oc = od; }
          swp->E = d;
+         op->E = od;
          from = swp->H;
+         ofrom = op->H;
          swp->H = c;
+         op->H = oc;
       }
 /* calculate last cell in the 2nd sequence */
       swp = F+N;
-      if ((c = c - h) > (P = P - e)) P = c;
-      if (swp->H > (d = swp->E)) d = swp->H; 
+      op = O+N;
+      c = c - h;
+      P = P - e;
+      if (better_start(c, oc, P, oP)) { P = c; oP = oc; }
+      d = swp->E;
+      od = op->E;
+      if (better_start(swp->H, op->H, d, od)) { d = swp->H; od = op->H; }
       c = from + ss[B[N-1]];
-      if (P > c) c = P;
-      if (d > c) c = d;
+      oc = ofrom;
+      if (better_start(P, oP, c, oc)) { c = P; oc = oP; }
+      if (better_start(d, od, c, oc)) { c = d; oc = od; }
       swp->E = d;
+      op->E = od;
       swp->H = c;
+      op->H = oc;
       if (c > score1) {
          score1 = c;
          as->end1 = i+1;
          as->end2 = N;
+         as->start1 = start_i(oc);
+         as->start2 = start_j(oc);
       }
    }
 
 /* calculate last cell in the 1st sequence */
    from = c = 0;
    P = -g;
+   ofrom = start_point(M, 1);
+   oc = oP = start_point(M+1, 1);
    ss = s[A[M-1]];
-   for (swp = F+1, j = 0; swp < F+N; ++swp, ++j) {
-      if (c > P) P = c;
-      if ((c = swp->H - h) > (d = swp->E - e)) d = c;
+   for (swp = F+1, op = O+1, j = 0; swp < F+N; ++swp, ++op, ++j) {
+      if (better_start(c, oc, P, oP)) { P = c; oP = oc; }
+      u = swp->H - h;
+      d = swp->E - e;
+      od = op->E;
+      if (better_start(u, op->H, d, od)) { d = u; od = op->H; }
       c = from + ss[B[j]];
-      if (P > c) c = P;
-      if (d > c) c = d;
+      oc = ofrom;
+      if (better_start(P, oP, c, oc)) { c = P; oc = oP; }
+      if (better_start(d, od, c, oc)) { c = d; oc = od; }
       swp->E = d;
+      op->E = od;
       from = swp->H;
+      ofrom = op->H;
       swp->H = c;
+      op->H = oc;
       if (c > score1) {
          score1 = c;
          as->end1 = M;
          as->end2 = j+1;
+         as->start1 = start_i(oc);
+         as->start2 = start_j(oc);
       } 
    }
 /* calculate last cell for both sequences */
    swp = F+N;
-   if (c > P) P = c;
-   if (swp->H > (d = swp->E)) d = swp->H; 
+   op = O+N;
+   if (better_start(c, oc, P, oP)) { P = c; oP = oc; }
+   d = swp->E;
+   od = op->E;
+   if (better_start(swp->H, op->H, d, od)) { d = swp->H; od = op->H; }
    c = from + ss[B[N-1]];
-   if (P > c) c = P;
-   if (d > c) c = d;
+   oc = ofrom;
+   if (better_start(P, oP, c, oc)) { c = P; oc = oP; }
+   if (better_start(d, od, c, oc)) { c = d; oc = od; }
    swp->E = d;
    swp->H = c;
    if (c > score1) {
       score1 = c;
       as->end1 = M;
       as->end2 = N;
+      as->start1 = start_i(oc);
+      as->start2 = start_j(oc);
    }
 
-/* find start point */
-   M = as->end1;
-   N = as->end2;
-   for (i = 0; i < N; ++i)
-      R[i].E = -g;
-   for (i = M-1; i > 0; --i) {
-      from = c = 0;
-      P = -g;
-      ss = s[A[i]];
-      for (swp = R+1, j = N-1; swp < R+N; ++swp, --j) {
-         if ((c = c - h) > (P = P - e)) P = c;
-         if ((c = swp->H - h) > (d = swp->E - e)) d = c;
-         c = from + ss[B[j]];
-         if (P > c) c = P;
-         if (d > c) c = d;
-         swp->E = d;
-         from = swp->H;
-         swp->H = c;
-      }
-/* calculate last cell in the 2nd sequence */
-      swp = R+N;
-      if ((c = c - h) > (P = P - e)) P = c;
-      if (swp->H > (d = swp->E)) d = swp->H; 
-      c = from + ss[B[0]];
-      if (P > c) c = P;
-      if (d > c) c = d;
-      swp->E = d;
-      swp->H = c;
-      if (c > score2) {
-         score2 = c;
-         as->start1 = i+1;
-         as->start2 = 1;
-         if (c >= score1) goto found; // score same as before, done!
-      } 
-   }
-
-/* calculate last cell in the 1st sequence */
-   from = c = 0;
-   P = -g;
-   ss = s[A[0]];
-   for (swp = R+1, j = N-1; swp < R+N; ++swp, --j) {
-      if (c > P) P = c;
-      if ((c = swp->H - h) > (d = swp->E - e)) d = c;
-      c = from + ss[B[j]];
-      if (P > c) c = P;
-      if (d > c) c = d;
-      swp->E = d;
-      from = swp->H;
-      swp->H = c;
-      if (c > score2) {
-         score2 = c;
-         as->start1 = 1;
-         as->start2 = j+1;
-         if (c >= score1) goto found; // score same as before, done!
-      } 
-   }
-/* calculate last cell for both sequences */
-   swp = R+N;
-   if (c > P) P = c;
-   if (swp->H > (d = swp->E)) d = swp->H; 
-   c = from + ss[B[0]];
-   if (P > c) c = P;
-   if (d > c) c = d;
-   swp->E = d;
-   swp->H = c;
-   if (c > score2) {
-      score2 = c;
-      as->start1 = 1;
+   as->score = score1;
+/* no end scores above zero, align the sequences end to end with free gaps */
+   if (score1 == 0) {
+      as->start1 = as->len1 + 1;
+      as->end1 = as->len1;
       as->start2 = 1;
-      if (c >= score1) goto found; // score same as before, done!
+      as->end2 = 0;
    }
-
-found:
-   as->score = score1;
 /* initialize the spaces arrays */
-   as->spc1 = (int *) calloc(as->len1 + 1, sizeof(int));
-   if (as->spc1 == NULL) 
-      dpAlign_fatal("Can't allocate memory for spaces array for seq 1!\n");
-   as->spc2 = (int *) calloc(as->len2 + 1, sizeof(int));
-   if (as->spc2 == NULL) 
-   dpAlign_fatal("Can't allocate memory for spaces array for seq 2!\n");
+   init_spaces(as, as->len1 + 1, as->len2 + 1);
 /* set the end gaps based on the start stop */
    as->spc1[0] += (as->start2 - 1);
    as->spc1[as->len1] += (as->len2 - as->end2);  
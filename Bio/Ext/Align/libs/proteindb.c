@@ -68,6 +68,16 @@ ComplexSequence * init_ProteinDB(ProteinDB * prodb,int * return_status)
     return prodb->single;
   }
 
+  if( prodb->is_loaded == TRUE ) {
+    prodb->pos = 0;
+    if( prodb->len == 0 ) {
+      *return_status = DB_RETURN_END;
+      return NULL;
+    }
+    *return_status = DB_RETURN_OK;
+    return hard_link_ComplexSequence(prodb->loaded[prodb->pos++]);
+  }
+
   seq = init_SequenceDB(prodb->sdb,return_status);
 
   if( seq == NULL || *return_status == DB_RETURN_ERROR || *return_status == DB_RETURN_END ) {
@@ -110,6 +120,15 @@ ComplexSequence * reload_ProteinDB(ComplexSequence * last,ProteinDB * prodb,int
   if( last != NULL ) 
     free_ComplexSequence(last);
 
+  if( prodb->is_loaded == TRUE ) {
+    if( prodb->pos >= prodb->len ) {
+      *return_status = DB_RETURN_END;
+      return NULL;
+    }
+    *return_status = DB_RETURN_OK;
+    return hard_link_ComplexSequence(prodb->loaded[prodb->pos++]);
+  }
+
   seq = reload_SequenceDB(NULL,prodb->sdb,return_status);
 
   if( seq == NULL || *return_status == DB_RETURN_ERROR || *return_status == DB_RETURN_END ) {
@@ -143,6 +162,12 @@ boolean close_ProteinDB(ComplexSequence * cs,ProteinDB * prodb)
     return TRUE;
   }
 
+  if( prodb->is_loaded == TRUE ) {
+    if( cs != NULL )
+      free_ComplexSequence(cs);
+    return TRUE;
+  }
+
   if( cs == NULL)
     free_ComplexSequence(cs);
 
@@ -250,6 +275,70 @@ ProteinDB * new_ProteinDB(SequenceDB * seqdb,ComplexSequenceEvalSet * cses)
   return out;
 }
 
+/* Function:  load_ProteinDB(prodb)
+ *
+ * Descrip:    To make a new protein database held in memory
+ *             from all the entries of prodb, which is read once
+ *
+ *             The entries are kept as the ComplexSequences the
+ *             searches score, so searching the new database again,
+ *             as a multi-query search does for every query, neither
+ *             reads nor parses nor encodes anything.
+ *
+ *
+ * Arg:        prodb [READ ] protein database to read [ProteinDB *]
+ *
+ * Return [UNKN ]  Undocumented return value [ProteinDB *]
+ *
+ */
+ProteinDB * load_ProteinDB(ProteinDB * prodb)
+{
+  ProteinDB * out;
+  ComplexSequence * cs;
+  ComplexSequence ** grown;
+  int maxlen = 64;
+  int status;
+
+  out = ProteinDB_alloc();
+  if( out == NULL )
+    return NULL;
+  out->is_loaded = TRUE;
+  if( prodb->cses != NULL )
+    out->cses = hard_link_ComplexSequenceEvalSet(prodb->cses);
+  out->loaded = (ComplexSequence **) ckcalloc(maxlen,sizeof(ComplexSequence *));
+  if( out->loaded == NULL ) {
+    free_ProteinDB(out);
+    return NULL;
+  }
+
+  for(cs = init_ProteinDB(prodb,&status); status == DB_RETURN_OK; cs = reload_ProteinDB(NULL,prodb,&status)) {
+    if( out->len == maxlen ) {
+      grown = (ComplexSequence **) ckrealloc(out->loaded,2*maxlen*sizeof(ComplexSequence *));
+      if( grown == NULL ) {
+        warn("Could not grow the in-memory protein database beyond %d entries",maxlen);
+        status = DB_RETURN_ERROR;
+        break;
+      }
+      out->loaded = grown;
+      maxlen *= 2;
+    }
+    /* a single sequence database keeps its entry */
+    out->loaded[out->len++] = prodb->is_single_seq == TRUE ? hard_link_ComplexSequence(cs) : cs;
+  }
+  if( status == DB_RETURN_ERROR ) {
+    if( cs != NULL && prodb->is_single_seq == FALSE )
+      free_ComplexSequence(cs);
+    warn("Could not read the protein database into memory");
+    free_ProteinDB(out);
+    return NULL;
+  }
+  /* every entry is kept, so only a file backed source has anything to close */
+  if( prodb->is_single_seq == FALSE && prodb->is_loaded == FALSE )
+    close_SequenceDB(NULL,prodb->sdb);
+
+  return out;
+}
+
  
 # line 235 "proteindb.c"
 /* Function:  hard_link_ProteinDB(obj)
@@ -298,6 +387,10 @@ ProteinDB * ProteinDB_alloc(void)
     out->single = NULL;  
     out->sdb = NULL; 
     out->cses = NULL;    
+    out->is_loaded = FALSE;  
+    out->loaded = NULL;  
+    out->len = 0;    
+    out->pos = 0;    
 
 
     return out;  
@@ -317,6 +410,7 @@ ProteinDB * ProteinDB_alloc(void)
  */
 ProteinDB * free_ProteinDB(ProteinDB * obj) 
 {
+    int i;   
 
 
     if( obj == NULL) {  
@@ -335,6 +429,11 @@ ProteinDB * free_ProteinDB(ProteinDB * obj)
       free_SequenceDB(obj->sdb);     
     if( obj->cses != NULL)   
       free_ComplexSequenceEvalSet(obj->cses);    
+    if( obj->loaded != NULL) {   
+      for(i=0;i<obj->len;i++)    
+        free_ComplexSequence(obj->loaded[i]);   
+      ckfree(obj->loaded);   
+      }  
 
 
     ckfree(obj); 
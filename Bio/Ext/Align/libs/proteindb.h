@@ -16,6 +16,10 @@ struct bp_sw_ProteinDB {
     ComplexSequence * single;    
     SequenceDB * sdb;    
     ComplexSequenceEvalSet * cses;   
+    boolean is_loaded;  /* entries are held in memory, see load_ProteinDB */
+    ComplexSequence ** loaded;   
+    int len;/* len for above loaded  */ 
+    int pos;/* next entry of loaded to read */ 
     } ;  
 /* ProteinDB defined */ 
 #ifndef DYNAMITE_DEFINED_ProteinDB
@@ -172,6 +176,26 @@ ProteinDB * bp_sw_new_ProteinDB(SequenceDB * seqdb,ComplexSequenceEvalSet * cses
 #define new_ProteinDB bp_sw_new_ProteinDB
 
 
+/* Function:  load_ProteinDB(prodb)
+ *
+ * Descrip:    To make a new protein database held in memory
+ *             from all the entries of prodb, which is read once
+ *
+ *             The entries are kept as the ComplexSequences the
+ *             searches score, so searching the new database again,
+ *             as a multi-query search does for every query, neither
+ *             reads nor parses nor encodes anything.
+ *
+ *
+ * Arg:        prodb [READ ] protein database to read [ProteinDB *]
+ *
+ * Return [UNKN ]  Undocumented return value [ProteinDB *]
+ *
+ */
+ProteinDB * bp_sw_load_ProteinDB(ProteinDB * prodb);
+#define load_ProteinDB bp_sw_load_ProteinDB
+
+
 /* Function:  hard_link_ProteinDB(obj)
  *
  * Descrip:    Bumps up the reference count of the object
@@ -2,6 +2,9 @@
 extern "C" {
 #endif
 #include "proteinsw.h"
+#include "swstriped.h"
+#include <pthread.h>
+#include <unistd.h>
 
 # line 5 "proteinsw.c"
 
@@ -30,6 +33,13 @@ extern "C" {
 
 #define ProteinSW_EXPL_MATRIX(this_matrix,i,j,STATE) this_matrix->basematrix->matrix[((j+1)*3)+STATE][i+1]   
 #define ProteinSW_EXPL_SPECIAL(matrix,i,j,STATE) matrix->basematrix->specmatrix[STATE][j+1]  
+
+
+/* largest blocks thread_calculate_ProteinSW hands to a thread, query by target positions */ 
+#define ProteinSW_BLOCK_I 512    
+#define ProteinSW_BLOCK_J 64     
+
+
 #define ProteinSW_READ_OFF_ERROR -3
  
 
@@ -40,6 +50,14 @@ extern "C" {
  *
  * Descrip:    This function makes a database search of ProteinSW
  *
+ *             The pairs are scored by /score_only_striped_ProteinSW,
+ *             which gives the same scores as /score_only_ProteinSW
+ *
+ *             If out only stores scores from some cutoff on (see
+ *             /store_cutoff_Hscore), targets are given up as soon
+ *             as they can't reach it, and are passed to out with
+ *             some lower score.
+ *
  *
  * Arg:             out [UNKN ] Undocumented argument [Hscore *]
  * Arg:         querydb [UNKN ] Undocumented argument [ProteinDB*]
@@ -60,8 +78,18 @@ Search_Return_Type search_ProteinSW(Hscore * out,ProteinDB* querydb,ProteinDB* t
     int query_pos = 0;   
     int target_pos = 0;  
     DataScore * ds;  
+    ProteinSW * mat;     
+    ProteinSW_Striped * st;  
+    int cutoff;  
 
 
+    /* one scoring memory for the whole search */ 
+    if( (mat = ProteinSW_alloc()) == NULL )  {  
+      warn("ProteinSW search could not allocate its scoring memory");    
+      return SEARCH_ERROR;   
+      }  
+    /* targets which can't be stored can be given up early */ 
+    cutoff = store_cutoff_Hscore(out);   
     push_errormsg_stack("Before any actual search in db searching"); 
     query = init_ProteinDB(querydb,&db_status);  
     if( db_status == DB_RETURN_ERROR )   {  
@@ -72,6 +100,10 @@ Search_Return_Type search_ProteinSW(Hscore * out,ProteinDB* querydb,ProteinDB* t
 
 
       target_pos = 0;    
+      if( (st = new_ProteinSW_Striped(query, comp, gap, ext)) == NULL )  {  
+        warn("ProteinSW search could not allocate the query profile, position %d",query_pos);   
+        return SEARCH_ERROR; 
+        }  
 
 
       target = init_ProteinDB(targetdb,&db_status);  
@@ -83,7 +115,7 @@ Search_Return_Type search_ProteinSW(Hscore * out,ProteinDB* querydb,ProteinDB* t
 
 
         /* No maximum length - allocated on-the-fly */ 
-        score = score_only_ProteinSW(query, target , comp, gap, ext);    
+        score = score_only_striped_ProteinSW(st, mat, target, cutoff);   
         if( should_store_Hscore(out,score) == TRUE )     {  
           ds = new_DataScore_from_storage(out);  
           if( ds == NULL )   {  
@@ -110,6 +142,7 @@ Search_Return_Type search_ProteinSW(Hscore * out,ProteinDB* querydb,ProteinDB* t
         target_pos++;    
         } /* end of For all target entries */ 
       close_ProteinDB(target,targetdb);  
+      free_ProteinSW_Striped(st);    
        query = reload_ProteinDB(query,querydb,&db_status);   
       if( db_status == DB_RETURN_ERROR)  {  
         warn("In searching ProteinSW, Reload error on database query, position %d,%d",query_pos,target_pos); 
@@ -121,10 +154,443 @@ Search_Return_Type search_ProteinSW(Hscore * out,ProteinDB* querydb,ProteinDB* t
       } /* end of For all query entries */ 
     close_ProteinDB(query,querydb);  
     pop_errormsg_stack();    
+    free_ProteinSW(mat); 
+    return SEARCH_OK;    
+}    
+
+
+/* Function:  batch_search_ProteinSW(out,querydb,targetdb,comp,gap,ext,batch)
+ *
+ * Descrip:    This function makes a database search of ProteinSW
+ *             taking the queries batch at a time and scoring every
+ *             query of a batch against a target before going on to
+ *             the next target, so the target database is gone through
+ *             once per batch rather than once per query and each
+ *             target is scored while it is still in cache.
+ *
+ *             The targets of a pass are held until the scores of the
+ *             batch are merged into out, which is done query by query
+ *             so out ends up just as search_ProteinSW would leave it.
+ *             This is best used with a target database made by
+ *             load_ProteinDB, whose entries are in memory anyway.
+ *
+ *
+ * Arg:             out [UNKN ] Undocumented argument [Hscore *]
+ * Arg:         querydb [UNKN ] Undocumented argument [ProteinDB*]
+ * Arg:        targetdb [UNKN ] Undocumented argument [ProteinDB*]
+ * Arg:            comp [UNKN ] Undocumented argument [CompMat*]
+ * Arg:             gap [UNKN ] Undocumented argument [int]
+ * Arg:             ext [UNKN ] Undocumented argument [int]
+ * Arg:           batch [UNKN ] number of queries scored per pass [int]
+ *
+ * Return [UNKN ]  Undocumented return value [Search_Return_Type]
+ *
+ */
+Search_Return_Type batch_search_ProteinSW(Hscore * out,ProteinDB* querydb,ProteinDB* targetdb ,CompMat* comp,int gap,int ext,int batch) 
+{
+    ComplexSequence ** query;    
+    ComplexSequence ** target;   
+    ComplexSequence ** grown;    
+    ComplexSequence * next;  
+    ComplexSequence * cs;    
+    int * score;     
+    int * grown_score;   
+    int maxlen;  
+    int nquery;  
+    int ntarget;     
+    int db_status;   
+    int query_status;    
+    int query_pos = 0;   
+    int i;   
+    int j;   
+    DataScore * ds;  
+    ProteinSW * mat;     
+    ProteinSW_Striped ** st;     
+    int cutoff;  
+
+
+    if( batch < 1 )  
+      batch = 1; 
+    cutoff = store_cutoff_Hscore(out);   
+    maxlen = 256;    
+    query = (ComplexSequence **) ckcalloc(batch,sizeof(ComplexSequence *));   
+    target = (ComplexSequence **) ckcalloc(maxlen,sizeof(ComplexSequence *));     
+    score = (int *) ckcalloc((size_t) maxlen*batch,sizeof(int));   
+    st = (ProteinSW_Striped **) ckcalloc(batch,sizeof(ProteinSW_Striped *));     
+    mat = ProteinSW_alloc();     
+    if( query == NULL || target == NULL || score == NULL || st == NULL || mat == NULL )  {  
+      warn("ProteinSW batched search could not allocate a batch of %d queries",batch);   
+      return SEARCH_ERROR;   
+      }  
+
+    push_errormsg_stack("Before any actual search in db searching"); 
+    next = init_ProteinDB(querydb,&query_status);    
+    if( query_status == DB_RETURN_ERROR )    {  
+      warn("In searching ProteinSW, got a database reload error on the query [query] database"); 
+      return SEARCH_ERROR;   
+      }  
+    while( query_status == DB_RETURN_OK )    {  
+      /* the queries of this batch are all held at once */ 
+      for(nquery = 0; nquery < batch && query_status == DB_RETURN_OK; ) {  
+        if( (st[nquery] = new_ProteinSW_Striped(next, comp, gap, ext)) == NULL )     {  
+          warn("ProteinSW batched search could not allocate the query profile, position %d",query_pos+nquery);     
+          return SEARCH_ERROR;   
+          }  
+        query[nquery++] = next;  
+        next = reload_ProteinDB(NULL,querydb,&query_status);     
+        }  
+      if( query_status == DB_RETURN_ERROR)   {  
+        warn("In searching ProteinSW, Reload error on database query, position %d",query_pos+nquery);    
+        return SEARCH_ERROR; 
+        }  
+
+      ntarget = 0;   
+      cs = init_ProteinDB(targetdb,&db_status);  
+      if( db_status == DB_RETURN_ERROR )     {  
+        warn("In searching ProteinSW, got a database init error on the target [target] database");   
+        return SEARCH_ERROR; 
+        }  
+      while( db_status == DB_RETURN_OK ) {   
+        if( ntarget == maxlen )  {  
+          maxlen = 2*maxlen;     
+          grown = (ComplexSequence **) ckrealloc(target,maxlen*sizeof(ComplexSequence *));   
+          grown_score = (int *) ckrealloc(score,(size_t) maxlen*batch*sizeof(int));  
+          if( grown == NULL || grown_score == NULL ) {   
+            warn("ProteinSW batched search could not hold %d targets",maxlen);   
+            return SEARCH_ERROR; 
+            }  
+          target = grown;    
+          score = grown_score;   
+          }  
+        /* No maximum length - allocated on-the-fly */ 
+        for(i=0;i<nquery;i++)    
+          score[ntarget*batch+i] = score_only_striped_ProteinSW(st[i], mat, cs, cutoff);   
+        target[ntarget++] = cs;  
+        cs = reload_ProteinDB(NULL,targetdb,&db_status); 
+        if( db_status == DB_RETURN_ERROR )   {  
+          warn("In searching ProteinSW, Reload error on database target, position %d,%d",query_pos,ntarget);    
+          return SEARCH_ERROR;   
+          }  
+        } /* end of For all target entries */ 
+
+      /* merge in the order search_ProteinSW would */ 
+      for(i=0;i<nquery;i++,query_pos++)  {  
+        for(j=0;j<ntarget;j++)   {  
+          if( should_store_Hscore(out,score[j*batch+i]) == TRUE )    {  
+            ds = new_DataScore_from_storage(out);    
+            if( ds == NULL )     {  
+              warn("ProteinSW search had a memory error in allocating a new_DataScore (?a leak somewhere - DataScore is a very small datastructure");    
+              return SEARCH_ERROR;   
+              }  
+            /* Now: add query/target information to the entry */ 
+            dataentry_add_ProteinDB(ds->query,query[i],querydb);     
+            dataentry_add_ProteinDB(ds->target,target[j],targetdb);  
+            ds->score = score[j*batch+i];    
+            add_Hscore(out,ds);  
+            } /* end of if storing datascore */ 
+          pop_errormsg_stack();  
+          push_errormsg_stack("DB searching: just finished [Query Pos: %d] [Target Pos: %d]",query_pos,j);   
+          }  
+        }  
+
+      if( targetdb->is_single_seq == FALSE ) 
+        for(j=0;j<ntarget;j++)   
+          free_ComplexSequence(target[j]);   
+      close_ProteinDB(NULL,targetdb);    
+      for(i=0;i<nquery;i++)  
+        free_ProteinSW_Striped(st[i]);   
+      if( querydb->is_single_seq == FALSE )  
+        for(i=0;i<nquery;i++)    
+          free_ComplexSequence(query[i]);    
+      } /* end of For all query entries */ 
+    close_ProteinDB(NULL,querydb);   
+    pop_errormsg_stack();    
+    ckfree(target);  
+    ckfree(score);   
+    ckfree(query);   
+    ckfree(st);  
+    free_ProteinSW(mat); 
     return SEARCH_OK;    
 }    
 
 
+/* the targets of a query in flight between the threads of thread_search_ProteinSW */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;    /* a target was read, or the search is over */
+    pthread_cond_t scored;  /* a target was scored */
+    ComplexSequence ** target; /* target number n is in slot n % size */
+    int * score;
+    boolean * done;
+    int size;
+    int read;               /* targets of this query read so far */
+    int taken;              /* targets of this query taken by the workers */
+    boolean finished;       /* no more queries */
+    ComplexSequence * query;
+    int query_pos;          /* number of the query, so workers know when it changes */
+    int cutoff;             /* from store_cutoff_Hscore */
+    CompMat * comp;
+    int gap;
+    int ext;
+    } ProteinSW_Window;
+
+
+/* Function:  thread_loop_ProteinSW(ptr)
+ *
+ * Descrip:    Loop of each worker thread of thread_search_ProteinSW:
+ *             takes the targets in the order they were read and
+ *             scores them against the current query
+ *
+ *
+ * Arg:        ptr [UNKN ] window of targets [ProteinSW_Window *]
+ *
+ * Return [UNKN ]  Undocumented return value [void *]
+ *
+ */
+static void * thread_loop_ProteinSW(void * ptr)
+{
+    ProteinSW_Window * w = (ProteinSW_Window *) ptr;
+    ComplexSequence * query;
+    ComplexSequence * target;
+    ProteinSW * mat;
+    ProteinSW_Striped * st = NULL;
+    int st_pos = -1;
+    int query_pos;
+    int slot;
+    int score;
+
+
+    /* each worker scores in its own memory */
+    mat = ProteinSW_alloc();
+    pthread_mutex_lock(&w->lock);
+    for(;;)  {
+      while( w->taken == w->read && w->finished == FALSE )
+        pthread_cond_wait(&w->work,&w->lock);
+      if( w->taken == w->read )
+        break;
+      slot = w->taken++ % w->size;
+      query = w->query;
+      query_pos = w->query_pos;
+      target = w->target[slot];
+      pthread_mutex_unlock(&w->lock);
+      /* a worker makes its own profile of each query it meets */
+      if( st_pos != query_pos )  {
+        if( st != NULL )
+          free_ProteinSW_Striped(st);
+        st = new_ProteinSW_Striped(query, w->comp, w->gap, w->ext);
+        st_pos = query_pos;
+        }
+      if( st != NULL )
+        score = score_only_striped_ProteinSW(st, mat, target, w->cutoff);
+      else if( mat != NULL )
+        score = score_only_reuse_ProteinSW(mat, query, target , w->comp, w->gap, w->ext, w->cutoff);
+      else
+        score = score_only_ProteinSW(query, target , w->comp, w->gap, w->ext);
+      pthread_mutex_lock(&w->lock);
+      w->score[slot] = score;
+      w->done[slot] = TRUE;
+      pthread_cond_signal(&w->scored);
+      }
+    pthread_mutex_unlock(&w->lock);
+    if( mat != NULL )
+      free_ProteinSW(mat);
+    if( st != NULL )
+      free_ProteinSW_Striped(st);
+    return NULL;
+}
+
+
+/* Function:  thread_search_ProteinSW(out,querydb,targetdb,comp,gap,ext,number)
+ *
+ * Descrip:    This function makes a database search of ProteinSW
+ *             with number threads scoring the targets, or one
+ *             per online processor if number is less than 1.
+ *
+ *             The calling thread reads the targets ahead into a
+ *             bounded window, which the worker threads score, and
+ *             merges the scores into out in the order the targets
+ *             were read, so out ends up just as search_ProteinSW
+ *             would leave it. Only the calling thread touches the
+ *             databases and out.
+ *
+ *
+ * Arg:             out [UNKN ] Undocumented argument [Hscore *]
+ * Arg:         querydb [UNKN ] Undocumented argument [ProteinDB*]
+ * Arg:        targetdb [UNKN ] Undocumented argument [ProteinDB*]
+ * Arg:            comp [UNKN ] Undocumented argument [CompMat*]
+ * Arg:             gap [UNKN ] Undocumented argument [int]
+ * Arg:             ext [UNKN ] Undocumented argument [int]
+ * Arg:          number [UNKN ] number of worker threads [int]
+ *
+ * Return [UNKN ]  Undocumented return value [Search_Return_Type]
+ *
+ */
+Search_Return_Type thread_search_ProteinSW(Hscore * out,ProteinDB* querydb,ProteinDB* targetdb ,CompMat* comp,int gap,int ext,int number) 
+{
+    ComplexSequence* query;  
+    ComplexSequence* target;     
+    ProteinSW_Window w;
+    pthread_t * worker;
+    Search_Return_Type ret = SEARCH_OK;
+    boolean more;
+    int db_status;   
+    int query_pos = 0;   
+    int target_pos;  
+    int slot;
+    int score;
+    int i;
+    DataScore * ds;  
+
+
+    if( number < 1 )  {
+      number = (int) sysconf(_SC_NPROCESSORS_ONLN);
+      if( number < 1 )
+        number = 1;
+      }
+
+    push_errormsg_stack("Before any actual search in db searching"); 
+    query = init_ProteinDB(querydb,&db_status);  
+    if( db_status == DB_RETURN_ERROR )   {  
+      warn("In searching ProteinSW, got a database reload error on the query [query] database"); 
+      return SEARCH_ERROR;   
+      }  
+
+    w.size = 16 * number;
+    w.target = (ComplexSequence **) ckcalloc(w.size,sizeof(ComplexSequence *));
+    w.score = (int *) ckcalloc(w.size,sizeof(int));
+    w.done = (boolean *) ckcalloc(w.size,sizeof(boolean));
+    worker = (pthread_t *) ckcalloc(number,sizeof(pthread_t));
+    if( w.target == NULL || w.score == NULL || w.done == NULL || worker == NULL )  {
+      warn("ProteinSW threaded search could not allocate its window of %d targets",w.size);
+      return SEARCH_ERROR;
+      }
+    pthread_mutex_init(&w.lock,NULL);
+    pthread_cond_init(&w.work,NULL);
+    pthread_cond_init(&w.scored,NULL);
+    w.read = w.taken = 0;
+    w.finished = FALSE;
+    w.query = query;
+    w.query_pos = 0;
+    w.cutoff = store_cutoff_Hscore(out);
+    w.comp = comp;
+    w.gap = gap;
+    w.ext = ext;
+    for(i=0;i<number;i++) {
+      if( pthread_create(&worker[i],NULL,thread_loop_ProteinSW,&w) != 0 )  {
+        warn("ProteinSW threaded search could not start worker thread %d",i);
+        number = i;
+        ret = SEARCH_ERROR;
+        break;
+        }
+      }
+
+    while( ret == SEARCH_OK ) {  
+
+
+      target_pos = 0;    
+
+
+      target = init_ProteinDB(targetdb,&db_status);  
+      if( db_status == DB_RETURN_ERROR )     {  
+        warn("In searching ProteinSW, got a database init error on the target [target] database");   
+        ret = SEARCH_ERROR;
+        break;
+        }  
+      more = target != NULL ? TRUE : FALSE;
+
+      /* the workers are idle between queries */
+      pthread_mutex_lock(&w.lock);
+      w.query = query;
+      w.query_pos = query_pos;
+      w.read = w.taken = 0;
+      for(;;)    {  
+        /* merge the scores that are ready in target order */
+        while( target_pos < w.read && w.done[target_pos % w.size] == TRUE ) {
+          slot = target_pos % w.size;
+          score = w.score[slot];
+          w.done[slot] = FALSE;
+          pthread_mutex_unlock(&w.lock);
+          if( ret == SEARCH_OK && should_store_Hscore(out,score) == TRUE )     {  
+            ds = new_DataScore_from_storage(out);  
+            if( ds == NULL )   {  
+              warn("ProteinSW search had a memory error in allocating a new_DataScore (?a leak somewhere - DataScore is a very small datastructure");  
+              ret = SEARCH_ERROR;
+              }  
+            else {
+              /* Now: add query/target information to the entry */ 
+              dataentry_add_ProteinDB(ds->query,query,querydb);  
+              dataentry_add_ProteinDB(ds->target,w.target[slot],targetdb);   
+              ds->score = score;     
+              add_Hscore(out,ds);    
+              }
+            } /* end of if storing datascore */ 
+          if( targetdb->is_single_seq == FALSE )
+            free_ComplexSequence(w.target[slot]);
+          pop_errormsg_stack();    
+          push_errormsg_stack("DB searching: just finished [Query Pos: %d] [Target Pos: %d]",query_pos,target_pos);    
+          target_pos++;
+          pthread_mutex_lock(&w.lock);
+          }
+
+        /* read ahead while there is room in the window */
+        if( more == TRUE && w.read - target_pos < w.size ) {
+          w.target[w.read % w.size] = target;
+          w.read++;
+          pthread_cond_signal(&w.work);
+          pthread_mutex_unlock(&w.lock);
+          target = reload_ProteinDB(NULL,targetdb,&db_status);  
+          if( db_status == DB_RETURN_ERROR )   {  
+            warn("In searching ProteinSW, Reload error on database target, position %d,%d",query_pos,w.read);  
+            ret = SEARCH_ERROR;
+            }  
+          if( db_status != DB_RETURN_OK || ret != SEARCH_OK )
+            more = FALSE;
+          pthread_mutex_lock(&w.lock);
+          continue;
+          }
+        if( more == FALSE && target_pos == w.read )
+          break;/* Out of target loop */ 
+        pthread_cond_wait(&w.scored,&w.lock);
+        } /* end of For all target entries */ 
+      pthread_mutex_unlock(&w.lock);
+      if( target != NULL && targetdb->is_single_seq == FALSE )
+        free_ComplexSequence(target);
+      close_ProteinDB(NULL,targetdb);  
+      if( ret != SEARCH_OK )
+        break;
+       query = reload_ProteinDB(query,querydb,&db_status);   
+      if( db_status == DB_RETURN_ERROR)  {  
+        warn("In searching ProteinSW, Reload error on database query, position %d,%d",query_pos,target_pos); 
+        ret = SEARCH_ERROR;
+        break;
+        }  
+      if( db_status == DB_RETURN_END)    
+        break;  /* Out of query loop */ 
+      query_pos++;   
+      } /* end of For all query entries */ 
+
+    pthread_mutex_lock(&w.lock);
+    w.finished = TRUE;
+    pthread_cond_broadcast(&w.work);
+    pthread_mutex_unlock(&w.lock);
+    for(i=0;i<number;i++)
+      pthread_join(worker[i],NULL);
+    pthread_mutex_destroy(&w.lock);
+    pthread_cond_destroy(&w.work);
+    pthread_cond_destroy(&w.scored);
+    ckfree(worker);
+    ckfree(w.done);
+    ckfree(w.score);
+    ckfree(w.target);
+
+    if( ret == SEARCH_OK ) {
+      close_ProteinDB(query,querydb);  
+      pop_errormsg_stack();    
+      }
+    return ret;
+}    
+
+
 #define ProteinSW_VSMALL_MATRIX(mat,i,j,STATE) mat->basematrix->matrix[(j+2)%2][((i+1)*3)+STATE] 
 #define ProteinSW_VSMALL_SPECIAL(mat,i,j,STATE) mat->basematrix->specmatrix[(j+2)%2][STATE]  
 
@@ -135,6 +601,9 @@ Search_Return_Type search_ProteinSW(Hscore * out,ProteinDB* querydb,ProteinDB* t
  *             I am pretty sure we can do this better, but hey, for the moment...
  *             It calls /allocate_ProteinSW_only
  *
+ *             To score many pairs, keep one ProteinSW and call
+ *             /score_only_reuse_ProteinSW with it instead
+ *
  *
  * Arg:         query [UNKN ] query data structure [ComplexSequence*]
  * Arg:        target [UNKN ] target data structure [ComplexSequence*]
@@ -147,10 +616,7 @@ Search_Return_Type search_ProteinSW(Hscore * out,ProteinDB* querydb,ProteinDB* t
  */
 int score_only_ProteinSW(ComplexSequence* query,ComplexSequence* target ,CompMat* comp,int gap,int ext) 
 {
-    int bestscore = NEGI;    
-    int i;   
-    int j;   
-    int k;   
+    int bestscore;   
     ProteinSW * mat;     
 
 
@@ -159,12 +625,83 @@ int score_only_ProteinSW(ComplexSequence* query,ComplexSequence* target ,CompMat
       warn("Memory allocation error in the db search - unable to communicate to calling function. this spells DIASTER!");    
       return NEGI;   
       }  
-    if((mat->basematrix = BaseMatrix_alloc_matrix_and_specials(2,(mat->leni + 1) * 3,2,2)) == NULL)  {  
-      warn("Score only matrix for ProteinSW cannot be allocated, (asking for 1  by %d  cells)",mat->leni*3); 
-      mat = free_ProteinSW(mat);     
-      return 0;  
+    bestscore = score_only_reuse_ProteinSW(mat, query, target , comp, gap, ext, 0);  
+    mat = free_ProteinSW(mat);   
+    return bestscore;    
+}    
+
+
+/* Function:  score_only_reuse_ProteinSW(mat,query,target,comp,gap,ext,cutoff)
+ *
+ * Descrip:    This function calculates the score for the matrix
+ *             as /score_only_ProteinSW does, but in mat, which
+ *             comes from /ProteinSW_alloc and is kept from one
+ *             call to the next by the caller.
+ *
+ *             The two rows of score memory are kept in mat and
+ *             only made again when a longer query comes along,
+ *             so a database search allocates nothing per pair.
+ *             A mat must not be used by two threads at once.
+ *             It is freed with /free_ProteinSW
+ *
+ *             If cutoff is above 0, the target is given up as
+ *             soon as the best score of a target position plus
+ *             the best CompMat score of the query for each
+ *             position left can't reach cutoff. The score is
+ *             then some score below cutoff rather than the exact
+ *             one, which is all a search storing the scores of
+ *             at least cutoff needs (see /store_cutoff_Hscore)
+ *
+ *
+ * Arg:           mat [RW   ] scoring memory kept between calls [ProteinSW *]
+ * Arg:         query [UNKN ] query data structure [ComplexSequence*]
+ * Arg:        target [UNKN ] target data structure [ComplexSequence*]
+ * Arg:          comp [UNKN ] Resource [CompMat*]
+ * Arg:           gap [UNKN ] Resource [int]
+ * Arg:           ext [UNKN ] Resource [int]
+ * Arg:        cutoff [READ ] lowest score that has to be exact, 0 for all [int]
+ *
+ * Return [UNKN ]  Undocumented return value [int]
+ *
+ */
+int score_only_reuse_ProteinSW(ProteinSW * mat,ComplexSequence* query,ComplexSequence* target ,CompMat* comp,int gap,int ext,int cutoff) 
+{
+    int bestscore = NEGI;    
+    int maxcomp = 0;     
+    int rowmax;  
+    int left;    
+    int i;   
+    int j;   
+    int k;   
+
+
+    mat->query = query;  
+    mat->target = target;    
+    mat->comp = comp;    
+    mat->gap = gap;  
+    mat->ext = ext;  
+    mat->leni = query->seq->len;     
+    mat->lenj = target->seq->len;    
+    if( mat->basematrix != NULL && mat->basematrix->lenj < (mat->leni + 1) * 3 ) 
+      mat->basematrix = free_BaseMatrix(mat->basematrix);    
+    if( mat->basematrix == NULL )    {  
+      if((mat->basematrix = BaseMatrix_alloc_matrix_and_specials(2,(mat->leni + 1) * 3,2,2)) == NULL)    {  
+        warn("Score only matrix for ProteinSW cannot be allocated, (asking for 1  by %d  cells)",mat->leni*3);   
+        return 0;    
+        }  
+      mat->basematrix->type = BASEMATRIX_TYPE_VERYSMALL;     
+      }  
+
+
+    /* best score a target position can add */ 
+    if( cutoff > 0 ) {  
+      for(i=0;i<mat->leni;i++)   
+        for(k=0;k<26;k++)    
+          if( CompMat_AAMATCH(mat->comp,CSEQ_PROTEIN_AMINOACID(mat->query,i),k) > maxcomp )  
+            maxcomp = CompMat_AAMATCH(mat->comp,CSEQ_PROTEIN_AMINOACID(mat->query,i),k);     
+      if( maxcomp * (mat->leni < mat->lenj ? mat->leni : mat->lenj) < cutoff )   
+        return 0;    
       }  
-    mat->basematrix->type = BASEMATRIX_TYPE_VERYSMALL;   
 
 
     /* Now, initiate matrix */ 
@@ -270,10 +807,24 @@ int score_only_ProteinSW(ComplexSequence* query,ComplexSequence* target ,CompMat
       /* Special state END has no special to special movements */ 
       if( bestscore < ProteinSW_VSMALL_SPECIAL(mat,0,j,END) )    
         bestscore = ProteinSW_VSMALL_SPECIAL(mat,0,j,END);   
+
+
+      /* give up if the rest of the target can't reach cutoff */ 
+      if( cutoff > 0 && bestscore < cutoff )     {  
+        rowmax = 0;  
+        for(i=0;i<mat->leni;i++) 
+          for(k=0;k<3;k++)   
+            if( ProteinSW_VSMALL_MATRIX(mat,i,j,k) > rowmax )    
+              rowmax = ProteinSW_VSMALL_MATRIX(mat,i,j,k);   
+        left = mat->lenj - 1 - j;    
+        if( left > mat->leni )   
+          left = mat->leni;  
+        if( rowmax + maxcomp * left < cutoff )   
+          return bestscore;  
+        }  
       } /* end of for all target positions */ 
 
 
-    mat = free_ProteinSW(mat);   
     return bestscore;    
 }    
 
@@ -334,6 +885,53 @@ PackAln * PackAln_bestmemory_ProteinSW(ComplexSequence* query,ComplexSequence* t
 }    
 
 
+/* Function:  PackAln_thread_bestmemory_ProteinSW(query,target,comp,gap,ext,dpenv,number)
+ *
+ * Descrip:    This function is /PackAln_bestmemory_ProteinSW with the
+ *             large memory model calculated by /thread_calculate_ProteinSW
+ *             with number threads, or one per online processor if number
+ *             is less than 1. The alignment is the same; the small
+ *             memory model is still calculated with one thread.
+ *
+ *
+ * Arg:         query [UNKN ] query data structure [ComplexSequence*]
+ * Arg:        target [UNKN ] target data structure [ComplexSequence*]
+ * Arg:          comp [UNKN ] Resource [CompMat*]
+ * Arg:           gap [UNKN ] Resource [int]
+ * Arg:           ext [UNKN ] Resource [int]
+ * Arg:         dpenv [UNKN ] Undocumented argument [DPEnvelope *]
+ * Arg:        number [UNKN ] number of threads [int]
+ *
+ * Return [UNKN ]  Undocumented return value [PackAln *]
+ *
+ */
+PackAln * PackAln_thread_bestmemory_ProteinSW(ComplexSequence* query,ComplexSequence* target ,CompMat* comp,int gap,int ext,DPEnvelope * dpenv,int number) 
+{
+    int total;   
+    ProteinSW * mat; 
+    PackAln * out;   
+
+
+    total = query->seq->len * target->seq->len;  
+
+
+    if( dpenv != NULL || (total * 3 * sizeof(int)) > 1000*get_max_BaseMatrix_kbytes() )  
+      return PackAln_bestmemory_ProteinSW(query, target , comp, gap, ext, dpenv);  
+
+
+    if( (mat=allocate_Expl_ProteinSW(query, target , comp, gap, ext)) == NULL )  {  
+      warn("Unable to allocate large ProteinSW version");    
+      return NULL;   
+      }  
+    thread_calculate_ProteinSW(mat,number);  
+    out =  PackAln_read_Expl_ProteinSW(mat);     
+
+
+    mat = free_ProteinSW(mat);   
+    return out;  
+}    
+
+
 /* Function:  allocate_ProteinSW_only(query,target,comp,gap,ext)
  *
  * Descrip:    This function only allocates the ProteinSW structure
@@ -2683,6 +3281,11 @@ int max_calc_special_ProteinSW(ProteinSW * mat,int i,int j,int state,boolean iss
  * Descrip:    This function calculates the ProteinSW matrix when in explicit mode
  *             To allocate the matrix use /allocate_Expl_ProteinSW
  *
+ *             The matrix is worked out a target position at a time
+ *             by /calculate_block_ProteinSW. Progress is reported
+ *             about every 1000 cells, checked between target positions
+ *             rather than in every cell.
+ *
  *
  * Arg:        mat [UNKN ] ProteinSW which contains explicit basematrix memory [ProteinSW *]
  *
@@ -2691,12 +3294,12 @@ int max_calc_special_ProteinSW(ProteinSW * mat,int i,int j,int state,boolean iss
  */
 boolean calculate_ProteinSW(ProteinSW * mat) 
 {
-    int i;   
     int j;   
     int leni;    
     int lenj;    
     int tot; 
     int num; 
+    int next;    
 
 
     if( mat->basematrix->type != BASEMATRIX_TYPE_EXPLICIT )  {  
@@ -2709,18 +3312,54 @@ boolean calculate_ProteinSW(ProteinSW * mat)
     lenj = mat->lenj;    
     tot = leni * lenj;   
     num = 0; 
+    next = 0;    
 
 
     start_reporting("ProteinSW Matrix calculation: ");   
     for(j=0;j<lenj;j++)  {  
-      auto int score;    
-      auto int temp;     
-      for(i=0;i<leni;i++)    {  
-        if( num%1000 == 0 )  
-          log_full_error(REPORT,0,"[%7d] Cells %2d%%%%",num,num*100/tot);    
-        num++;   
+      if( num >= next )  {  
+        log_full_error(REPORT,0,"[%7d] Cells %2d%%%%",num,num*100/tot);  
+        next = num + 1000;   
+        }  
+      num += calculate_block_ProteinSW(mat,0,j,leni,j+1);    
+      }  
+    stop_reporting();    
+    return TRUE;     
+}    
 
 
+/* Function:  calculate_block_ProteinSW(mat,starti,startj,stopi,stopj)
+ *
+ * Descrip:    This function calculates the cells of the ProteinSW matrix
+ *             from starti to stopi and startj to stopj, not including
+ *             the stops, when in explicit mode. The cells above and to
+ *             the left of the block have to be calculated already.
+ *             The stops are cut down to the matrix.
+ *
+ *
+ * Arg:           mat [UNKN ] ProteinSW which contains explicit basematrix memory [ProteinSW *]
+ * Arg:        starti [UNKN ] first query position [int]
+ * Arg:        startj [UNKN ] first target position [int]
+ * Arg:         stopi [UNKN ] query position after the block [int]
+ * Arg:         stopj [UNKN ] target position after the block [int]
+ *
+ * Return [UNKN ]  number of cells calculated [int]
+ *
+ */
+int calculate_block_ProteinSW(ProteinSW * mat,int starti,int startj,int stopi,int stopj) 
+{
+    int i;   
+    int j;   
+
+
+    if( stopi > mat->leni )  
+      stopi = mat->leni; 
+    if( stopj > mat->lenj )  
+      stopj = mat->lenj; 
+    for(j=startj;j<stopj;j++)    {  
+      auto int score;    
+      auto int temp;     
+      for(i=starti;i<stopi;i++)  {  
         /* For state MATCH */ 
         /* setting first movement to score */ 
         score = ProteinSW_EXPL_MATRIX(mat,i-1,j-1,MATCH) + 0;    
@@ -2801,8 +3440,150 @@ boolean calculate_ProteinSW(ProteinSW * mat)
 
       /* Special state END has no special to special movements */ 
       }  
-    stop_reporting();    
-    return TRUE;     
+    if( stopi <= starti || stopj <= startj ) 
+      return 0;  
+    return (stopi - starti) * (stopj - startj);  
+}    
+
+
+/* the columns of blocks shared out between the threads of thread_calculate_ProteinSW */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t block;   /* a block was calculated */
+    ProteinSW * mat;
+    int rows;               /* query positions in a block */
+    int blocki;
+    int blockj;
+    int next;               /* next column of blocks to take */
+    int * done;             /* blocks calculated in each column, from the top */
+    } ProteinSW_Wavefront;
+
+
+/* Function:  thread_calculate_loop_ProteinSW(ptr)
+ *
+ * Descrip:    Loop of each worker thread of thread_calculate_ProteinSW:
+ *             takes the next column of blocks and works down it,
+ *             waiting on each block for its left hand neighbour
+ *
+ *
+ * Arg:        ptr [UNKN ] columns of blocks [ProteinSW_Wavefront *]
+ *
+ * Return [UNKN ]  Undocumented return value [void *]
+ *
+ */
+static void * thread_calculate_loop_ProteinSW(void * ptr)
+{
+    ProteinSW_Wavefront * w = (ProteinSW_Wavefront *) ptr;
+    int bi;
+    int bj;
+
+
+    pthread_mutex_lock(&w->lock);
+    while( w->next < w->blockj )  {
+      /* columns are taken in order, so the one to the left is always being worked on */
+      bj = w->next++;
+      for(bi=0;bi<w->blocki;bi++)  {
+        while( bj > 0 && w->done[bj-1] <= bi )
+          pthread_cond_wait(&w->block,&w->lock);
+        pthread_mutex_unlock(&w->lock);
+        calculate_block_ProteinSW(w->mat,bi*w->rows,bj*ProteinSW_BLOCK_J,(bi+1)*w->rows,(bj+1)*ProteinSW_BLOCK_J);
+        pthread_mutex_lock(&w->lock);
+        w->done[bj] = bi+1;
+        pthread_cond_broadcast(&w->block);
+        }
+      }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+
+/* Function:  thread_calculate_ProteinSW(mat,number)
+ *
+ * Descrip:    This function calculates the ProteinSW matrix when in explicit mode
+ *             as /calculate_ProteinSW does, with number threads, or one
+ *             per online processor if number is less than 1.
+ *
+ *             Each thread takes a column of ProteinSW_BLOCK_J target
+ *             positions and works down it a block at a time, each block
+ *             starting once the block to its left is done, so the threads
+ *             move across the matrix as a wavefront of blocks. The blocks
+ *             are cut shorter than ProteinSW_BLOCK_I down short queries so
+ *             that there are enough of them to keep the threads busy.
+ *
+ *             The matrix is the same as /calculate_ProteinSW makes, so
+ *             /PackAln_read_Expl_ProteinSW reads it as usual. Progress
+ *             is not reported.
+ *
+ *
+ * Arg:           mat [UNKN ] ProteinSW which contains explicit basematrix memory [ProteinSW *]
+ * Arg:        number [UNKN ] number of threads [int]
+ *
+ * Return [UNKN ]  Undocumented return value [boolean]
+ *
+ */
+boolean thread_calculate_ProteinSW(ProteinSW * mat,int number) 
+{
+    ProteinSW_Wavefront w;
+    pthread_t * worker;
+    int i;
+
+
+    if( mat->basematrix->type != BASEMATRIX_TYPE_EXPLICIT )  {  
+      warn("in thread_calculate_ProteinSW, passed a non Explicit matrix type, cannot calculate!");   
+      return FALSE;  
+      }  
+
+    if( number < 1 )  {
+      number = (int) sysconf(_SC_NPROCESSORS_ONLN);
+      if( number < 1 )
+        number = 1;
+      }
+
+    /* four blocks a thread down the query, but not so small that the locking costs more than the cells */
+    w.rows = (mat->leni + 4*number - 1) / (4*number);
+    if( w.rows > ProteinSW_BLOCK_I )
+      w.rows = ProteinSW_BLOCK_I;
+    if( w.rows < 32 )
+      w.rows = 32;
+    w.blocki = (mat->leni + w.rows - 1) / w.rows;
+    w.blockj = (mat->lenj + ProteinSW_BLOCK_J - 1) / ProteinSW_BLOCK_J;
+    if( number == 1 || w.blocki < 2 || w.blockj < 2 )
+      return calculate_ProteinSW(mat);
+
+    if( number > w.blockj )
+      number = w.blockj;
+    w.done = (int *) ckcalloc(w.blockj,sizeof(int));
+    worker = (pthread_t *) ckcalloc(number,sizeof(pthread_t));
+    if( w.done == NULL || worker == NULL )  {
+      warn("ProteinSW threaded calculation could not allocate its %d columns of blocks, calculating with one thread",w.blockj);
+      if( w.done != NULL )
+        ckfree(w.done);
+      if( worker != NULL )
+        ckfree(worker);
+      return calculate_ProteinSW(mat);
+      }
+    pthread_mutex_init(&w.lock,NULL);
+    pthread_cond_init(&w.block,NULL);
+    w.mat = mat;
+    w.next = 0;
+    for(i=0;i<number;i++) {
+      if( pthread_create(&worker[i],NULL,thread_calculate_loop_ProteinSW,&w) != 0 )  {
+        warn("ProteinSW threaded calculation could not start worker thread %d",i);
+        number = i;
+        break;
+        }
+      }
+
+    /* with no workers the calling thread does it all */
+    if( number == 0 )
+      thread_calculate_loop_ProteinSW(&w);
+    for(i=0;i<number;i++)
+      pthread_join(worker[i],NULL);
+    pthread_mutex_destroy(&w.lock);
+    pthread_cond_destroy(&w.block);
+    ckfree(worker);
+    ckfree(w.done);
+    return TRUE;
 }    
 
 
@@ -37,6 +37,14 @@ typedef struct bp_sw_ProteinSW bp_sw_ProteinSW;
  *
  * Descrip:    This function makes a database search of ProteinSW
  *
+ *             The pairs are scored by /score_only_striped_ProteinSW,
+ *             which gives the same scores as /score_only_ProteinSW
+ *
+ *             If out only stores scores from some cutoff on (see
+ *             /store_cutoff_Hscore), targets are given up as soon
+ *             as they can't reach it, and are passed to out with
+ *             some lower score.
+ *
  *
  * Arg:             out [UNKN ] Undocumented argument [Hscore *]
  * Arg:         querydb [UNKN ] Undocumented argument [ProteinDB*]
@@ -52,6 +60,103 @@ Search_Return_Type bp_sw_search_ProteinSW(Hscore * out,ProteinDB* querydb,Protei
 #define search_ProteinSW bp_sw_search_ProteinSW
 
 
+/* Function:  score_only_reuse_ProteinSW(mat,query,target,comp,gap,ext,cutoff)
+ *
+ * Descrip:    This function calculates the score for the matrix
+ *             as /score_only_ProteinSW does, but in mat, which
+ *             comes from /ProteinSW_alloc and is kept from one
+ *             call to the next by the caller.
+ *
+ *             The two rows of score memory are kept in mat and
+ *             only made again when a longer query comes along,
+ *             so a database search allocates nothing per pair.
+ *             A mat must not be used by two threads at once.
+ *             It is freed with /free_ProteinSW
+ *
+ *             If cutoff is above 0, the target is given up as
+ *             soon as the best score of a target position plus
+ *             the best CompMat score of the query for each
+ *             position left can't reach cutoff. The score is
+ *             then some score below cutoff rather than the exact
+ *             one, which is all a search storing the scores of
+ *             at least cutoff needs (see /store_cutoff_Hscore)
+ *
+ *
+ * Arg:           mat [RW   ] scoring memory kept between calls [ProteinSW *]
+ * Arg:         query [UNKN ] query data structure [ComplexSequence*]
+ * Arg:        target [UNKN ] target data structure [ComplexSequence*]
+ * Arg:          comp [UNKN ] Resource [CompMat*]
+ * Arg:           gap [UNKN ] Resource [int]
+ * Arg:           ext [UNKN ] Resource [int]
+ * Arg:        cutoff [READ ] lowest score that has to be exact, 0 for all [int]
+ *
+ * Return [UNKN ]  Undocumented return value [int]
+ *
+ */
+int bp_sw_score_only_reuse_ProteinSW(ProteinSW * mat,ComplexSequence* query,ComplexSequence* target ,CompMat* comp,int gap,int ext,int cutoff);
+#define score_only_reuse_ProteinSW bp_sw_score_only_reuse_ProteinSW
+
+
+/* Function:  batch_search_ProteinSW(out,querydb,targetdb,comp,gap,ext,batch)
+ *
+ * Descrip:    This function makes a database search of ProteinSW
+ *             taking the queries batch at a time and scoring every
+ *             query of a batch against a target before going on to
+ *             the next target, so the target database is gone through
+ *             once per batch rather than once per query and each
+ *             target is scored while it is still in cache.
+ *
+ *             The targets of a pass are held until the scores of the
+ *             batch are merged into out, which is done query by query
+ *             so out ends up just as search_ProteinSW would leave it.
+ *             This is best used with a target database made by
+ *             load_ProteinDB, whose entries are in memory anyway.
+ *
+ *
+ * Arg:             out [UNKN ] Undocumented argument [Hscore *]
+ * Arg:         querydb [UNKN ] Undocumented argument [ProteinDB*]
+ * Arg:        targetdb [UNKN ] Undocumented argument [ProteinDB*]
+ * Arg:            comp [UNKN ] Undocumented argument [CompMat*]
+ * Arg:             gap [UNKN ] Undocumented argument [int]
+ * Arg:             ext [UNKN ] Undocumented argument [int]
+ * Arg:           batch [UNKN ] number of queries scored per pass [int]
+ *
+ * Return [UNKN ]  Undocumented return value [Search_Return_Type]
+ *
+ */
+Search_Return_Type bp_sw_batch_search_ProteinSW(Hscore * out,ProteinDB* querydb,ProteinDB* targetdb ,CompMat* comp,int gap,int ext,int batch);
+#define batch_search_ProteinSW bp_sw_batch_search_ProteinSW
+
+
+/* Function:  thread_search_ProteinSW(out,querydb,targetdb,comp,gap,ext,number)
+ *
+ * Descrip:    This function makes a database search of ProteinSW
+ *             with number threads scoring the targets, or one
+ *             per online processor if number is less than 1.
+ *
+ *             The calling thread reads the targets ahead into a
+ *             bounded window, which the worker threads score, and
+ *             merges the scores into out in the order the targets
+ *             were read, so out ends up just as search_ProteinSW
+ *             would leave it. Only the calling thread touches the
+ *             databases and out.
+ *
+ *
+ * Arg:             out [UNKN ] Undocumented argument [Hscore *]
+ * Arg:         querydb [UNKN ] Undocumented argument [ProteinDB*]
+ * Arg:        targetdb [UNKN ] Undocumented argument [ProteinDB*]
+ * Arg:            comp [UNKN ] Undocumented argument [CompMat*]
+ * Arg:             gap [UNKN ] Undocumented argument [int]
+ * Arg:             ext [UNKN ] Undocumented argument [int]
+ * Arg:          number [UNKN ] number of worker threads [int]
+ *
+ * Return [UNKN ]  Undocumented return value [Search_Return_Type]
+ *
+ */
+Search_Return_Type bp_sw_thread_search_ProteinSW(Hscore * out,ProteinDB* querydb,ProteinDB* targetdb ,CompMat* comp,int gap,int ext,int number);
+#define thread_search_ProteinSW bp_sw_thread_search_ProteinSW
+
+
 /* Function:  PackAln_bestmemory_ProteinSW(query,target,comp,gap,ext,dpenv)
  *
  * Descrip:    This function chooses the best memory set-up for the alignment
@@ -78,6 +183,30 @@ PackAln * bp_sw_PackAln_bestmemory_ProteinSW(ComplexSequence* query,ComplexSeque
 #define PackAln_bestmemory_ProteinSW bp_sw_PackAln_bestmemory_ProteinSW
 
 
+/* Function:  PackAln_thread_bestmemory_ProteinSW(query,target,comp,gap,ext,dpenv,number)
+ *
+ * Descrip:    This function is /PackAln_bestmemory_ProteinSW with the
+ *             large memory model calculated by /thread_calculate_ProteinSW
+ *             with number threads, or one per online processor if number
+ *             is less than 1. The alignment is the same; the small
+ *             memory model is still calculated with one thread.
+ *
+ *
+ * Arg:         query [UNKN ] query data structure [ComplexSequence*]
+ * Arg:        target [UNKN ] target data structure [ComplexSequence*]
+ * Arg:          comp [UNKN ] Resource [CompMat*]
+ * Arg:           gap [UNKN ] Resource [int]
+ * Arg:           ext [UNKN ] Resource [int]
+ * Arg:         dpenv [UNKN ] Undocumented argument [DPEnvelope *]
+ * Arg:        number [UNKN ] number of threads [int]
+ *
+ * Return [UNKN ]  Undocumented return value [PackAln *]
+ *
+ */
+PackAln * bp_sw_PackAln_thread_bestmemory_ProteinSW(ComplexSequence* query,ComplexSequence* target ,CompMat* comp,int gap,int ext,DPEnvelope * dpenv,int number);
+#define PackAln_thread_bestmemory_ProteinSW bp_sw_PackAln_thread_bestmemory_ProteinSW
+
+
 /* Function:  allocate_Expl_ProteinSW(query,target,comp,gap,ext)
  *
  * Descrip:    This function allocates the ProteinSW structure
@@ -239,6 +368,11 @@ PackAln * bp_sw_PackAln_read_Expl_ProteinSW(ProteinSW * mat);
  * Descrip:    This function calculates the ProteinSW matrix when in explicit mode
  *             To allocate the matrix use /allocate_Expl_ProteinSW
  *
+ *             The matrix is worked out a target position at a time
+ *             by /calculate_block_ProteinSW. Progress is reported
+ *             about every 1000 cells, checked between target positions
+ *             rather than in every cell.
+ *
  *
  * Arg:        mat [UNKN ] ProteinSW which contains explicit basematrix memory [ProteinSW *]
  *
@@ -249,6 +383,34 @@ boolean bp_sw_calculate_ProteinSW(ProteinSW * mat);
 #define calculate_ProteinSW bp_sw_calculate_ProteinSW
 
 
+/* Function:  thread_calculate_ProteinSW(mat,number)
+ *
+ * Descrip:    This function calculates the ProteinSW matrix when in explicit mode
+ *             as /calculate_ProteinSW does, with number threads, or one
+ *             per online processor if number is less than 1.
+ *
+ *             Each thread takes a column of ProteinSW_BLOCK_J target
+ *             positions and works down it a block at a time, each block
+ *             starting once the block to its left is done, so the threads
+ *             move across the matrix as a wavefront of blocks. The blocks
+ *             are cut shorter than ProteinSW_BLOCK_I down short queries so
+ *             that there are enough of them to keep the threads busy.
+ *
+ *             The matrix is the same as /calculate_ProteinSW makes, so
+ *             /PackAln_read_Expl_ProteinSW reads it as usual. Progress
+ *             is not reported.
+ *
+ *
+ * Arg:           mat [UNKN ] ProteinSW which contains explicit basematrix memory [ProteinSW *]
+ * Arg:        number [UNKN ] number of threads [int]
+ *
+ * Return [UNKN ]  Undocumented return value [boolean]
+ *
+ */
+boolean bp_sw_thread_calculate_ProteinSW(ProteinSW * mat,int number);
+#define thread_calculate_ProteinSW bp_sw_thread_calculate_ProteinSW
+
+
 /* Function:  ProteinSW_alloc(void)
  *
  * Descrip:    Allocates structure: assigns defaults if given 
@@ -335,6 +497,8 @@ int bp_sw_max_calc_ProteinSW(ProteinSW * mat,int i,int j,int state,boolean isspe
 #define max_calc_ProteinSW bp_sw_max_calc_ProteinSW
 int bp_sw_max_calc_special_ProteinSW(ProteinSW * mat,int i,int j,int state,boolean isspecial,int * reti,int * retj,int * retstate,boolean * retspecial,int * cellscore);
 #define max_calc_special_ProteinSW bp_sw_max_calc_special_ProteinSW
+int bp_sw_calculate_block_ProteinSW(ProteinSW * mat,int starti,int startj,int stopi,int stopj);
+#define calculate_block_ProteinSW bp_sw_calculate_block_ProteinSW
 
 #ifdef _cplusplus
 }
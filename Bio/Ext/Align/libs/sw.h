@@ -69,6 +69,10 @@ typedef struct bp_sw_Protein bp_sw_Protein;
 
 typedef struct bp_sw_ProteinDB bp_sw_ProteinDB;
 
+typedef struct bp_sw_ProteinSW bp_sw_ProteinSW;
+
+typedef struct bp_sw_ProteinSW_Striped bp_sw_ProteinSW_Striped;
+
 typedef struct bp_sw_Sequence bp_sw_Sequence;
 
 typedef struct bp_sw_SequenceDB bp_sw_SequenceDB;
@@ -2644,6 +2648,44 @@ bp_sw_ComplexSequenceEvalSet * bp_sw_free_ComplexSequenceEvalSet( bp_sw_ComplexS
 
 
 
+/* Helper functions in the module
+ *
+ * bp_sw_new_ComplexSequence
+ * bp_sw_default_aminoacid_ComplexSequenceEvalSet
+ */
+
+
+/* These functions are not associated with an object */
+/* Function:  bp_sw_new_ComplexSequence(seq,cses)
+ *
+ * Descrip:    The basic way to make a ComplexSequence. Requires that
+ *             you have already built a ComplexSequenceEvalSet (such as
+ *             /default_aminoacid_ComplexSequenceEvalSet).
+ *
+ *
+ *
+ * Arg:        seq          Sequence that the ComplexSequence is based on [bp_sw_Sequence *]
+ * Arg:        cses         EvalSet that defines the functions used on the sequence [bp_sw_ComplexSequenceEvalSet *]
+ *
+ * Returns Undocumented return value [bp_sw_ComplexSequence *]
+ *
+ */
+bp_sw_ComplexSequence * bp_sw_new_ComplexSequence( bp_sw_Sequence * seq,bp_sw_ComplexSequenceEvalSet * cses);
+
+/* Function:  bp_sw_default_aminoacid_ComplexSequenceEvalSet(void)
+ *
+ * Descrip:    Makes a very sensible protein sequence
+ *             eval set. You shouldn't need your own
+ *
+ *
+ *
+ * Returns Undocumented return value [bp_sw_ComplexSequenceEvalSet *]
+ *
+ */
+bp_sw_ComplexSequenceEvalSet * bp_sw_default_aminoacid_ComplexSequenceEvalSet();
+
+
+
 /* Functions that create, manipulate or act on CompMat
  *
  * bp_sw_fail_safe_CompMat_access
@@ -4018,6 +4060,7 @@ bp_sw_Histogram * bp_sw_new_Histogram( int min,int max,int lumpsize);
  * bp_sw_basic_show_Hscore
  * bp_sw_hard_link_Hscore
  * bp_sw_Hscore_alloc_std
+ * bp_sw_level_score_Hscore
  * bp_sw_free_Hscore [destructor]
  *
  */
@@ -4187,6 +4230,21 @@ bp_sw_Hscore * bp_sw_hard_link_Hscore( bp_sw_Hscore * obj);
  */
 bp_sw_Hscore * bp_sw_Hscore_alloc_std();
 
+/* Function:  bp_sw_level_score_Hscore(cut_off,report_stagger)
+ *
+ * Descrip:    Makes a Hscore which stores the scores of
+ *             at least cut_off, reporting progress every
+ *             report_stagger comparisons, or never if it is -1
+ *
+ *
+ * Arg:        cut_off      lowest score to store [int]
+ * Arg:        report_stagger comparisons between reports [int]
+ *
+ * Returns Undocumented return value [bp_sw_Hscore *]
+ *
+ */
+bp_sw_Hscore * bp_sw_level_score_Hscore( int cut_off,int report_stagger);
+
 /* This is the destructor function, ie, call this to free object*/
 /* Function:  bp_sw_free_Hscore(obj)
  *
@@ -5020,6 +5078,7 @@ bp_sw_Protein * bp_sw_free_Protein( bp_sw_Protein * obj);
  * bp_sw_new_ProteinDB_from_single_seq
  * bp_sw_single_fasta_ProteinDB
  * bp_sw_new_ProteinDB
+ * bp_sw_load_ProteinDB
  */
 
 /* API for object ProteinDB */
@@ -5211,6 +5270,260 @@ bp_sw_ProteinDB * bp_sw_single_fasta_ProteinDB( char * filename);
  */
 bp_sw_ProteinDB * bp_sw_new_ProteinDB( bp_sw_SequenceDB * seqdb,bp_sw_ComplexSequenceEvalSet * cses);
 
+/* Function:  bp_sw_load_ProteinDB(prodb)
+ *
+ * Descrip:    To make a new protein database held in memory
+ *             from all the entries of prodb, which is read once
+ *
+ *
+ * Arg:        prodb        protein database to read [bp_sw_ProteinDB *]
+ *
+ * Returns Undocumented return value [bp_sw_ProteinDB *]
+ *
+ */
+bp_sw_ProteinDB * bp_sw_load_ProteinDB( bp_sw_ProteinDB * prodb);
+
+
+
+/* Helper functions in the module
+ *
+ * bp_sw_search_ProteinSW
+ * bp_sw_batch_search_ProteinSW
+ * bp_sw_thread_search_ProteinSW
+ * bp_sw_score_only_ProteinSW
+ * bp_sw_score_only_reuse_ProteinSW
+ * bp_sw_new_ProteinSW_Striped
+ * bp_sw_score_only_striped_ProteinSW
+ */
+
+
+/* These functions are not associated with an object */
+/* Function:  bp_sw_search_ProteinSW(out,querydb,targetdb,comp,gap,ext)
+ *
+ * Descrip:    This function makes a database search of ProteinSW
+ *
+ *             The pairs are scored by /score_only_striped_ProteinSW,
+ *             which gives the same scores as /score_only_ProteinSW
+ *
+ *             If out only stores scores from some cutoff on (see
+ *             /store_cutoff_Hscore), targets are given up as soon
+ *             as they can't reach it, and are passed to out with
+ *             some lower score.
+ *
+ *
+ * Arg:        out          scores of the pairs [bp_sw_Hscore *]
+ * Arg:        querydb      query database [bp_sw_ProteinDB *]
+ * Arg:        targetdb     target database [bp_sw_ProteinDB *]
+ * Arg:        comp         comparison matrix [bp_sw_CompMat *]
+ * Arg:        gap          gap open penalty [int]
+ * Arg:        ext          gap extension penalty [int]
+ *
+ * Returns Undocumented return value [int]
+ *
+ */
+int bp_sw_search_ProteinSW( bp_sw_Hscore * out,bp_sw_ProteinDB * querydb,bp_sw_ProteinDB * targetdb,bp_sw_CompMat * comp,int gap,int ext);
+
+/* Function:  bp_sw_batch_search_ProteinSW(out,querydb,targetdb,comp,gap,ext,batch)
+ *
+ * Descrip:    This function makes a database search of ProteinSW
+ *             taking the queries batch at a time and scoring every
+ *             query of a batch against a target before going on to
+ *             the next target, so the target database is gone through
+ *             once per batch rather than once per query and each
+ *             target is scored while it is still in cache.
+ *
+ *             The targets of a pass are held until the scores of the
+ *             batch are merged into out, which is done query by query
+ *             so out ends up just as search_ProteinSW would leave it.
+ *             This is best used with a target database made by
+ *             load_ProteinDB, whose entries are in memory anyway.
+ *
+ *
+ * Arg:        out          scores of the pairs [bp_sw_Hscore *]
+ * Arg:        querydb      query database [bp_sw_ProteinDB *]
+ * Arg:        targetdb     target database [bp_sw_ProteinDB *]
+ * Arg:        comp         comparison matrix [bp_sw_CompMat *]
+ * Arg:        gap          gap open penalty [int]
+ * Arg:        ext          gap extension penalty [int]
+ * Arg:        batch        number of queries scored per pass [int]
+ *
+ * Returns Undocumented return value [int]
+ *
+ */
+int bp_sw_batch_search_ProteinSW( bp_sw_Hscore * out,bp_sw_ProteinDB * querydb,bp_sw_ProteinDB * targetdb,bp_sw_CompMat * comp,int gap,int ext,int batch);
+
+/* Function:  bp_sw_thread_search_ProteinSW(out,querydb,targetdb,comp,gap,ext,number)
+ *
+ * Descrip:    This function makes a database search of ProteinSW
+ *             with number threads scoring the targets, or one
+ *             per online processor if number is less than 1.
+ *
+ *             The calling thread reads the targets ahead into a
+ *             bounded window, which the worker threads score, and
+ *             merges the scores into out in the order the targets
+ *             were read, so out ends up just as search_ProteinSW
+ *             would leave it. Only the calling thread touches the
+ *             databases and out.
+ *
+ *
+ * Arg:        out          scores of the pairs [bp_sw_Hscore *]
+ * Arg:        querydb      query database [bp_sw_ProteinDB *]
+ * Arg:        targetdb     target database [bp_sw_ProteinDB *]
+ * Arg:        comp         comparison matrix [bp_sw_CompMat *]
+ * Arg:        gap          gap open penalty [int]
+ * Arg:        ext          gap extension penalty [int]
+ * Arg:        number       number of worker threads [int]
+ *
+ * Returns Undocumented return value [int]
+ *
+ */
+int bp_sw_thread_search_ProteinSW( bp_sw_Hscore * out,bp_sw_ProteinDB * querydb,bp_sw_ProteinDB * targetdb,bp_sw_CompMat * comp,int gap,int ext,int number);
+
+/* Function:  bp_sw_score_only_ProteinSW(query,target,comp,gap,ext)
+ *
+ * Descrip:    This function just calculates the score for the matrix
+ *             I am pretty sure we can do this better, but hey, for the moment...
+ *             It calls /allocate_ProteinSW_only
+ *
+ *             To score many pairs, keep one ProteinSW and call
+ *             /score_only_reuse_ProteinSW with it instead
+ *
+ *
+ * Arg:        query        query data structure [bp_sw_ComplexSequence *]
+ * Arg:        target       target data structure [bp_sw_ComplexSequence *]
+ * Arg:        comp         Resource [bp_sw_CompMat *]
+ * Arg:        gap          Resource [int]
+ * Arg:        ext          Resource [int]
+ *
+ * Returns Undocumented return value [int]
+ *
+ */
+int bp_sw_score_only_ProteinSW( bp_sw_ComplexSequence * query,bp_sw_ComplexSequence * target,bp_sw_CompMat * comp,int gap,int ext);
+
+/* Function:  bp_sw_score_only_reuse_ProteinSW(mat,query,target,comp,gap,ext,cutoff)
+ *
+ * Descrip:    This function calculates the score for the matrix
+ *             as /score_only_ProteinSW does, but in mat, which
+ *             comes from /ProteinSW_alloc and is kept from one
+ *             call to the next by the caller.
+ *
+ *             If cutoff is above 0, the target is given up as
+ *             soon as it can't reach cutoff. The score is then
+ *             some score below cutoff rather than the exact one.
+ *
+ *
+ * Arg:        mat          scoring memory kept between calls [bp_sw_ProteinSW *]
+ * Arg:        query        query data structure [bp_sw_ComplexSequence *]
+ * Arg:        target       target data structure [bp_sw_ComplexSequence *]
+ * Arg:        comp         Resource [bp_sw_CompMat *]
+ * Arg:        gap          Resource [int]
+ * Arg:        ext          Resource [int]
+ * Arg:        cutoff       lowest score that has to be exact, 0 for all [int]
+ *
+ * Returns Undocumented return value [int]
+ *
+ */
+int bp_sw_score_only_reuse_ProteinSW( bp_sw_ProteinSW * mat,bp_sw_ComplexSequence * query,bp_sw_ComplexSequence * target,bp_sw_CompMat * comp,int gap,int ext,int cutoff);
+
+/* Function:  bp_sw_new_ProteinSW_Striped(query,comp,gap,ext)
+ *
+ * Descrip:    Makes the striped query profile used by
+ *             /score_only_striped_ProteinSW to score query
+ *             against many targets with the SSE2 or AVX2 kernel,
+ *             whichever is the best this CPU runs.
+ *
+ *             The profile doesn't own query and comp, which
+ *             have to be kept for as long as it is used.
+ *
+ *
+ * Arg:        query        query data structure [bp_sw_ComplexSequence *]
+ * Arg:        comp         Resource [bp_sw_CompMat *]
+ * Arg:        gap          Resource [int]
+ * Arg:        ext          Resource [int]
+ *
+ * Returns profile, NULL if out of memory [bp_sw_ProteinSW_Striped *]
+ *
+ */
+bp_sw_ProteinSW_Striped * bp_sw_new_ProteinSW_Striped( bp_sw_ComplexSequence * query,bp_sw_CompMat * comp,int gap,int ext);
+
+/* Function:  bp_sw_score_only_striped_ProteinSW(st,mat,target,cutoff)
+ *
+ * Descrip:    Returns the same score as /score_only_ProteinSW
+ *             for the query of st against target, with the
+ *             striped kernels where they can be used.
+ *
+ *             If cutoff is above 0, a target is given up as soon
+ *             as it can't reach cutoff, and some score below
+ *             cutoff is returned.
+ *
+ *
+ * Arg:        st           striped query profile [bp_sw_ProteinSW_Striped *]
+ * Arg:        mat          scoring memory for saturated scores, may be NULL [bp_sw_ProteinSW *]
+ * Arg:        target       target data structure [bp_sw_ComplexSequence *]
+ * Arg:        cutoff       lowest score that has to be exact, 0 for all [int]
+ *
+ * Returns Undocumented return value [int]
+ *
+ */
+int bp_sw_score_only_striped_ProteinSW( bp_sw_ProteinSW_Striped * st,bp_sw_ProteinSW * mat,bp_sw_ComplexSequence * target,int cutoff);
+
+
+
+/* Functions that create, manipulate or act on ProteinSW
+ *
+ * bp_sw_ProteinSW_alloc
+ * bp_sw_free_ProteinSW [destructor]
+ *
+ */
+
+/* API for object ProteinSW */
+/* Function:  bp_sw_ProteinSW_alloc(void)
+ *
+ * Descrip:    Allocates structure: assigns defaults if given 
+ *
+ *
+ *
+ * Returns Undocumented return value [bp_sw_ProteinSW *]
+ *
+ */
+bp_sw_ProteinSW * bp_sw_ProteinSW_alloc();
+
+/* This is the destructor function, ie, call this to free object*/
+/* Function:  bp_sw_free_ProteinSW(obj)
+ *
+ * Descrip:    Free Function: removes the memory held by obj
+ *             Will chain up to owned members and clear all lists
+ *
+ *
+ * Arg:        obj          Object that is free'd [bp_sw_ProteinSW *]
+ *
+ * Returns Undocumented return value [bp_sw_ProteinSW *]
+ *
+ */
+bp_sw_ProteinSW * bp_sw_free_ProteinSW( bp_sw_ProteinSW * obj);
+
+
+
+/* Functions that create, manipulate or act on ProteinSW_Striped
+ *
+ * bp_sw_free_ProteinSW_Striped [destructor]
+ *
+ */
+
+/* API for object ProteinSW_Striped */
+/* This is the destructor function, ie, call this to free object*/
+/* Function:  bp_sw_free_ProteinSW_Striped(obj)
+ *
+ * Descrip:    Free Function: removes the memory held by obj
+ *
+ *
+ * Arg:        obj          Object that is free'd [bp_sw_ProteinSW_Striped *]
+ *
+ * Returns Undocumented return value [bp_sw_ProteinSW_Striped *]
+ *
+ */
+bp_sw_ProteinSW_Striped * bp_sw_free_ProteinSW_Striped( bp_sw_ProteinSW_Striped * obj);
+
 
 
 /* Helper functions in the module
@@ -6297,6 +6610,7 @@ bp_sw_FileSource * bp_sw_free_FileSource( bp_sw_FileSource * obj);
  *
  * bp_sw_Align_strings_ProteinSmithWaterman
  * bp_sw_Align_Sequences_ProteinSmithWaterman
+ * bp_sw_thread_Align_Sequences_ProteinSmithWaterman
  * bp_sw_Align_Proteins_SmithWaterman
  */
 
@@ -6349,6 +6663,27 @@ bp_sw_AlnBlock * bp_sw_Align_strings_ProteinSmithWaterman( char * one,char * two
  */
 bp_sw_AlnBlock * bp_sw_Align_Sequences_ProteinSmithWaterman( bp_sw_Sequence * one,bp_sw_Sequence * two,bp_sw_CompMat * comp,int gap,int ext);
 
+/* Function:  bp_sw_thread_Align_Sequences_ProteinSmithWaterman(one,two,comp,gap,ext,number)
+ *
+ * Descrip:    This function is /Align_Sequences_ProteinSmithWaterman
+ *             with the matrix calculated by number threads, or one
+ *             per online processor if number is less than 1, when
+ *             it fits in memory. The alignment is the same with any
+ *             number of threads.
+ *
+ *
+ * Arg:        one          First sequence to compare [bp_sw_Sequence *]
+ * Arg:        two          Second sequecne to compare [bp_sw_Sequence *]
+ * Arg:        comp         Comparison matrix to use [bp_sw_CompMat *]
+ * Arg:        gap          gap penalty. Must be negative or 0 [int]
+ * Arg:        ext          ext penalty. Must be negative or 0 [int]
+ * Arg:        number       number of threads [int]
+ *
+ * Returns new AlnBlock structure representing the alignment [bp_sw_AlnBlock *]
+ *
+ */
+bp_sw_AlnBlock * bp_sw_thread_Align_Sequences_ProteinSmithWaterman( bp_sw_Sequence * one,bp_sw_Sequence * two,bp_sw_CompMat * comp,int gap,int ext,int number);
+
 /* Function:  bp_sw_Align_Proteins_SmithWaterman(one,two,comp,gap,ext)
  *
  * Descrip:    This is the most correct way of aligning two Proteins,
@@ -79,6 +79,30 @@ AlnBlock * Align_strings_ProteinSmithWaterman(char * one,char * two,CompMat * co
  */
 # line 82 "sw_wrap.dy"
 AlnBlock * Align_Sequences_ProteinSmithWaterman(Sequence * one,Sequence * two,CompMat * comp,int gap,int ext)
+{
+  return thread_Align_Sequences_ProteinSmithWaterman(one,two,comp,gap,ext,1);
+}
+
+/* Function:  thread_Align_Sequences_ProteinSmithWaterman(one,two,comp,gap,ext,number)
+ *
+ * Descrip:    This function is /Align_Sequences_ProteinSmithWaterman
+ *             with the matrix calculated by number threads, or one
+ *             per online processor if number is less than 1, when
+ *             it fits in memory. The alignment is the same with any
+ *             number of threads.
+ *
+ *
+ * Arg:           one [READ ] First sequence to compare [Sequence *]
+ * Arg:           two [READ ] Second sequecne to compare [Sequence *]
+ * Arg:          comp [READ ] Comparison matrix to use [CompMat *]
+ * Arg:           gap [UNKN ] gap penalty. Must be negative or 0 [int]
+ * Arg:           ext [UNKN ] ext penalty. Must be negative or 0 [int]
+ * Arg:        number [UNKN ] number of threads [int]
+ *
+ * Return [OWNER]  new AlnBlock structure representing the alignment [AlnBlock *]
+ *
+ */
+AlnBlock * thread_Align_Sequences_ProteinSmithWaterman(Sequence * one,Sequence * two,CompMat * comp,int gap,int ext,int number)
 {
   AlnBlock * out = NULL;
   ComplexSequenceEvalSet * evalfunc = NULL;
@@ -114,7 +138,7 @@ AlnBlock * Align_Sequences_ProteinSmithWaterman(Sequence * one,Sequence * two,Co
   if( target_cs == NULL )
     goto cleanup;
 
-  pal = PackAln_bestmemory_ProteinSW(query_cs,target_cs,comp,gap,ext,NULL);
+  pal = PackAln_thread_bestmemory_ProteinSW(query_cs,target_cs,comp,gap,ext,NULL,number);
   if( pal == NULL ) 
     goto cleanup;
 
@@ -67,6 +67,29 @@ AlnBlock * bp_sw_Align_Sequences_ProteinSmithWaterman(Sequence * one,Sequence *
 #define Align_Sequences_ProteinSmithWaterman bp_sw_Align_Sequences_ProteinSmithWaterman
 
 
+/* Function:  thread_Align_Sequences_ProteinSmithWaterman(one,two,comp,gap,ext,number)
+ *
+ * Descrip:    This function is /Align_Sequences_ProteinSmithWaterman
+ *             with the matrix calculated by number threads, or one
+ *             per online processor if number is less than 1, when
+ *             it fits in memory. The alignment is the same with any
+ *             number of threads.
+ *
+ *
+ * Arg:           one [READ ] First sequence to compare [Sequence *]
+ * Arg:           two [READ ] Second sequecne to compare [Sequence *]
+ * Arg:          comp [READ ] Comparison matrix to use [CompMat *]
+ * Arg:           gap [UNKN ] gap penalty. Must be negative or 0 [int]
+ * Arg:           ext [UNKN ] ext penalty. Must be negative or 0 [int]
+ * Arg:        number [UNKN ] number of threads [int]
+ *
+ * Return [OWNER]  new AlnBlock structure representing the alignment [AlnBlock *]
+ *
+ */
+AlnBlock * bp_sw_thread_Align_Sequences_ProteinSmithWaterman(Sequence * one,Sequence * two,CompMat * comp,int gap,int ext,int number);
+#define thread_Align_Sequences_ProteinSmithWaterman bp_sw_thread_Align_Sequences_ProteinSmithWaterman
+
+
 /* Function:  Align_Proteins_SmithWaterman(one,two,comp,gap,ext)
  *
  * Descrip:    This is the most correct way of aligning two Proteins,
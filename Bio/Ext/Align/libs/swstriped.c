@@ -0,0 +1,535 @@
+#include "swstriped.h"
+#include <limits.h>
+
+/* $Id$ */
+
+/*
+  Striped score-only kernels for the ProteinSW model, laid out as in
+  dpstriped.c after Farrar (Bioinformatics 23:156, 2007), but keeping
+  the states of ProteinSW rather than Farrar's single H:
+
+    MATCH(i,j)  = max(MATCH, INSERT, DELETE, START=0)(i-1,j-1) + comp
+    INSERT(i,j) = max(MATCH(i,j-1) + gap, INSERT(i,j-1) + ext)
+    DELETE(i,j) = max(MATCH(i-1,j) + gap, DELETE(i-1,j) + ext)
+    END         = max MATCH
+
+  so gaps only open from MATCH and the scores are those of
+  score_only_ProteinSW. The vectors hold H = max(MATCH, INSERT, DELETE,
+  0) for the diagonal, INSERT for the next column and DELETE, which the
+  lazy loop carries across the segment boundaries. As gap and ext are
+  not positive, a state that drops to 0 or below can't lead to a better
+  score than starting afresh, so the kernels clamp at 0 and only report
+  positive END scores; any other score, or one that saturates the
+  lanes, is left to the scalar code.
+
+  Define DPALIGN_NO_SIMD to leave the kernels out, or DPALIGN_NO_AVX2
+  to only build the SSE2 ones, as for dpstriped.c.
+ */
+
+#if !defined(DPALIGN_NO_SIMD) && defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#define SWSTRIPED_SSE2
+#include <emmintrin.h>
+#if !defined(DPALIGN_NO_AVX2) && (__GNUC__ > 4 || defined(__clang__))
+#define SWSTRIPED_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+#define SWSTRIPED_ALPHABET 26 /* rows and columns of a CompMat */
+
+#ifdef SWSTRIPED_SSE2
+
+static void * striped_alloc(size_t sz)
+{
+    void * p = NULL;
+
+    if( posix_memalign(&p,32,sz) != 0 )
+      return NULL;
+    memset(p,0,sz);
+    return p;
+}
+
+/* vector width in bytes of the best kernel this CPU can run */
+static int striped_lanes(void)
+{
+#ifdef SWSTRIPED_AVX2
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports("avx2") )
+      return 32;
+#endif
+    return 16;
+}
+
+/*
+  striped_limit returns the score every position of target column j
+  has to stay below for the target to be given up, as no score of
+  cutoff can be reached from any of them with a match of at most
+  st->hi for each column left, or 0 if it can't be given up yet.
+ */
+static int striped_limit(ProteinSW_Striped * st,int N,int j,int cutoff)
+{
+    int left = N - 1 - j;
+
+    if( cutoff <= 0 )
+      return 0;
+    if( left > st->len )
+      left = st->len;
+    return cutoff - st->hi * left > 0 ? cutoff - st->hi * left : 0;
+}
+
+static int striped_sse2_8(ProteinSW_Striped * st,int * B,int N,int cutoff)
+{
+    int seg = st->seg8;
+    __m128i * prof = (__m128i *) st->p8;
+    __m128i vZero = _mm_setzero_si128();
+    __m128i vBias = _mm_set1_epi8((char) st->bias);
+    __m128i vGapO = _mm_set1_epi8((char) st->gapo8);
+    __m128i vGapE = _mm_set1_epi8((char) st->gape8);
+    __m128i vMax = vZero;
+    __m128i vH, vM, vI, vD, vF, vT, vCol;
+    __m128i * pvHStore, * pvHLoad, * pvE, * pvD, * pvP, * mem, * tmp;
+    unsigned char m[16];
+    int i, j, k, score, lim;
+
+    mem = (__m128i *) st->scratch;
+    memset(mem,0,4*seg*sizeof(__m128i));
+    pvHStore = mem;
+    pvHLoad = mem + seg;
+    pvE = mem + 2*seg;
+    pvD = mem + 3*seg;
+
+    for(j=0;j<N;j++) {
+      pvP = prof + B[j]*seg;
+      vF = vZero;
+      vCol = vZero;
+      vH = _mm_slli_si128(pvHStore[seg-1],1);
+      tmp = pvHLoad; pvHLoad = pvHStore; pvHStore = tmp;
+      for(i=0;i<seg;i++) {
+        vM = _mm_subs_epu8(_mm_adds_epu8(vH,pvP[i]),vBias);
+        vMax = _mm_max_epu8(vMax,vM);
+        vI = pvE[i];
+        vH = _mm_max_epu8(_mm_max_epu8(vM,vI),vF);
+        vCol = _mm_max_epu8(vCol,vH);
+        pvHStore[i] = vH;
+        pvD[i] = vF;
+        vT = _mm_subs_epu8(vM,vGapO);
+        pvE[i] = _mm_max_epu8(_mm_subs_epu8(vI,vGapE),vT);
+        vF = _mm_max_epu8(_mm_subs_epu8(vF,vGapE),vT);
+        vH = pvHLoad[i];
+        }
+      /* lazy F: DELETE only changes H, never MATCH or INSERT */
+      for(k=0;k<16;k++) {
+        vF = _mm_slli_si128(vF,1);
+        for(i=0;i<seg;i++) {
+          vD = pvD[i];
+          if( _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(vF,vD),vZero)) == 0xffff )
+            goto next_column;
+          vD = _mm_max_epu8(vD,vF);
+          pvD[i] = vD;
+          pvHStore[i] = _mm_max_epu8(pvHStore[i],vD);
+          vF = _mm_subs_epu8(vF,vGapE);
+          }
+        }
+      next_column:
+      /* give up once the rest of the target can't reach cutoff */
+      lim = striped_limit(st,N,j,cutoff);
+      if( lim > 0 && lim <= 255 - st->bias
+          && _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_subs_epu8(vCol,_mm_set1_epi8((char) (lim-1))),vZero)) == 0xffff )
+        break;
+      }
+
+    _mm_storeu_si128((__m128i *) m,vMax);
+    for(score=0,i=0;i<16;i++)
+      if( m[i] > score ) score = m[i];
+    return score + st->bias >= 255 ? -1 : score;
+}
+
+static int striped_sse2_16(ProteinSW_Striped * st,int * B,int N,int cutoff)
+{
+    int seg = st->seg16;
+    __m128i * prof = (__m128i *) st->p16;
+    __m128i vZero = _mm_setzero_si128();
+    __m128i vGapO = _mm_set1_epi16((short) st->gapo16);
+    __m128i vGapE = _mm_set1_epi16((short) st->gape16);
+    __m128i vMax = vZero;
+    __m128i vH, vM, vI, vD, vF, vT, vCol;
+    __m128i * pvHStore, * pvHLoad, * pvE, * pvD, * pvP, * mem, * tmp;
+    short m[8];
+    int i, j, k, score, lim;
+
+    mem = (__m128i *) st->scratch;
+    memset(mem,0,4*seg*sizeof(__m128i));
+    pvHStore = mem;
+    pvHLoad = mem + seg;
+    pvE = mem + 2*seg;
+    pvD = mem + 3*seg;
+
+    for(j=0;j<N;j++) {
+      pvP = prof + B[j]*seg;
+      vF = vZero;
+      vCol = vZero;
+      vH = _mm_slli_si128(pvHStore[seg-1],2);
+      tmp = pvHLoad; pvHLoad = pvHStore; pvHStore = tmp;
+      for(i=0;i<seg;i++) {
+        vM = _mm_adds_epi16(vH,pvP[i]);
+        vMax = _mm_max_epi16(vMax,vM);
+        vI = pvE[i];
+        vH = _mm_max_epi16(_mm_max_epi16(vM,vZero),_mm_max_epi16(vI,vF));
+        vCol = _mm_max_epi16(vCol,vH);
+        pvHStore[i] = vH;
+        pvD[i] = vF;
+        vT = _mm_subs_epi16(vM,vGapO);
+        pvE[i] = _mm_max_epi16(_mm_subs_epi16(vI,vGapE),vT);
+        vF = _mm_max_epi16(_mm_subs_epi16(vF,vGapE),vT);
+        vH = pvHLoad[i];
+        }
+      for(k=0;k<8;k++) {
+        vF = _mm_slli_si128(vF,2);
+        for(i=0;i<seg;i++) {
+          vD = pvD[i];
+          if( _mm_movemask_epi8(_mm_cmpgt_epi16(vF,vD)) == 0 )
+            goto next_column;
+          vD = _mm_max_epi16(vD,vF);
+          pvD[i] = vD;
+          pvHStore[i] = _mm_max_epi16(pvHStore[i],vD);
+          vF = _mm_subs_epi16(vF,vGapE);
+          }
+        }
+      next_column:
+      lim = striped_limit(st,N,j,cutoff);
+      if( lim > 0 && lim < SHRT_MAX
+          && _mm_movemask_epi8(_mm_cmpgt_epi16(_mm_set1_epi16((short) lim),vCol)) == 0xffff )
+        break;
+      }
+
+    _mm_storeu_si128((__m128i *) m,vMax);
+    for(score=0,i=0;i<8;i++)
+      if( m[i] > score ) score = m[i];
+    return score >= SHRT_MAX ? -1 : score;
+}
+
+#ifdef SWSTRIPED_AVX2
+
+/* shift a 256-bit vector left by n bytes across the 128-bit lanes */
+#define avx2_shift(v,n) _mm256_alignr_epi8((v),_mm256_permute2x128_si256((v),(v),0x08),16-(n))
+
+__attribute__((target("avx2")))
+static int striped_avx2_8(ProteinSW_Striped * st,int * B,int N,int cutoff)
+{
+    int seg = st->seg8;
+    __m256i * prof = (__m256i *) st->p8;
+    __m256i vZero = _mm256_setzero_si256();
+    __m256i vBias = _mm256_set1_epi8((char) st->bias);
+    __m256i vGapO = _mm256_set1_epi8((char) st->gapo8);
+    __m256i vGapE = _mm256_set1_epi8((char) st->gape8);
+    __m256i vMax = vZero;
+    __m256i vH, vM, vI, vD, vF, vT, vCol;
+    __m256i * pvHStore, * pvHLoad, * pvE, * pvD, * pvP, * mem, * tmp;
+    unsigned char m[32];
+    int i, j, k, score, lim;
+
+    mem = (__m256i *) st->scratch;
+    memset(mem,0,4*seg*sizeof(__m256i));
+    pvHStore = mem;
+    pvHLoad = mem + seg;
+    pvE = mem + 2*seg;
+    pvD = mem + 3*seg;
+
+    for(j=0;j<N;j++) {
+      pvP = prof + B[j]*seg;
+      vF = vZero;
+      vCol = vZero;
+      vH = avx2_shift(pvHStore[seg-1],1);
+      tmp = pvHLoad; pvHLoad = pvHStore; pvHStore = tmp;
+      for(i=0;i<seg;i++) {
+        vM = _mm256_subs_epu8(_mm256_adds_epu8(vH,pvP[i]),vBias);
+        vMax = _mm256_max_epu8(vMax,vM);
+        vI = pvE[i];
+        vH = _mm256_max_epu8(_mm256_max_epu8(vM,vI),vF);
+        vCol = _mm256_max_epu8(vCol,vH);
+        pvHStore[i] = vH;
+        pvD[i] = vF;
+        vT = _mm256_subs_epu8(vM,vGapO);
+        pvE[i] = _mm256_max_epu8(_mm256_subs_epu8(vI,vGapE),vT);
+        vF = _mm256_max_epu8(_mm256_subs_epu8(vF,vGapE),vT);
+        vH = pvHLoad[i];
+        }
+      for(k=0;k<32;k++) {
+        vF = avx2_shift(vF,1);
+        for(i=0;i<seg;i++) {
+          vD = pvD[i];
+          if( _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_subs_epu8(vF,vD),vZero)) == -1 )
+            goto next_column;
+          vD = _mm256_max_epu8(vD,vF);
+          pvD[i] = vD;
+          pvHStore[i] = _mm256_max_epu8(pvHStore[i],vD);
+          vF = _mm256_subs_epu8(vF,vGapE);
+          }
+        }
+      next_column:
+      lim = striped_limit(st,N,j,cutoff);
+      if( lim > 0 && lim <= 255 - st->bias
+          && _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_subs_epu8(vCol,_mm256_set1_epi8((char) (lim-1))),vZero)) == -1 )
+        break;
+      }
+
+    _mm256_storeu_si256((__m256i *) m,vMax);
+    for(score=0,i=0;i<32;i++)
+      if( m[i] > score ) score = m[i];
+    return score + st->bias >= 255 ? -1 : score;
+}
+
+__attribute__((target("avx2")))
+static int striped_avx2_16(ProteinSW_Striped * st,int * B,int N,int cutoff)
+{
+    int seg = st->seg16;
+    __m256i * prof = (__m256i *) st->p16;
+    __m256i vZero = _mm256_setzero_si256();
+    __m256i vGapO = _mm256_set1_epi16((short) st->gapo16);
+    __m256i vGapE = _mm256_set1_epi16((short) st->gape16);
+    __m256i vMax = vZero;
+    __m256i vH, vM, vI, vD, vF, vT, vCol;
+    __m256i * pvHStore, * pvHLoad, * pvE, * pvD, * pvP, * mem, * tmp;
+    short m[16];
+    int i, j, k, score, lim;
+
+    mem = (__m256i *) st->scratch;
+    memset(mem,0,4*seg*sizeof(__m256i));
+    pvHStore = mem;
+    pvHLoad = mem + seg;
+    pvE = mem + 2*seg;
+    pvD = mem + 3*seg;
+
+    for(j=0;j<N;j++) {
+      pvP = prof + B[j]*seg;
+      vF = vZero;
+      vCol = vZero;
+      vH = avx2_shift(pvHStore[seg-1],2);
+      tmp = pvHLoad; pvHLoad = pvHStore; pvHStore = tmp;
+      for(i=0;i<seg;i++) {
+        vM = _mm256_adds_epi16(vH,pvP[i]);
+        vMax = _mm256_max_epi16(vMax,vM);
+        vI = pvE[i];
+        vH = _mm256_max_epi16(_mm256_max_epi16(vM,vZero),_mm256_max_epi16(vI,vF));
+        vCol = _mm256_max_epi16(vCol,vH);
+        pvHStore[i] = vH;
+        pvD[i] = vF;
+        vT = _mm256_subs_epi16(vM,vGapO);
+        pvE[i] = _mm256_max_epi16(_mm256_subs_epi16(vI,vGapE),vT);
+        vF = _mm256_max_epi16(_mm256_subs_epi16(vF,vGapE),vT);
+        vH = pvHLoad[i];
+        }
+      for(k=0;k<16;k++) {
+        vF = avx2_shift(vF,2);
+        for(i=0;i<seg;i++) {
+          vD = pvD[i];
+          if( _mm256_movemask_epi8(_mm256_cmpgt_epi16(vF,vD)) == 0 )
+            goto next_column;
+          vD = _mm256_max_epi16(vD,vF);
+          pvD[i] = vD;
+          pvHStore[i] = _mm256_max_epi16(pvHStore[i],vD);
+          vF = _mm256_subs_epi16(vF,vGapE);
+          }
+        }
+      next_column:
+      lim = striped_limit(st,N,j,cutoff);
+      if( lim > 0 && lim < SHRT_MAX
+          && _mm256_movemask_epi8(_mm256_cmpgt_epi16(_mm256_set1_epi16((short) lim),vCol)) == -1 )
+        break;
+      }
+
+    _mm256_storeu_si256((__m256i *) m,vMax);
+    for(score=0,i=0;i<16;i++)
+      if( m[i] > score ) score = m[i];
+    return score >= SHRT_MAX ? -1 : score;
+}
+#endif /* SWSTRIPED_AVX2 */
+
+#endif /* SWSTRIPED_SSE2 */
+
+/* Function:  new_ProteinSW_Striped(query,comp,gap,ext)
+ *
+ * Descrip:    Makes the striped query profile used by
+ *             /score_only_striped_ProteinSW
+ *
+ *             The query position k*seg+i goes to element k of
+ *             vector i of each residue row, and the positions past
+ *             the end of the query score as low as the lanes allow,
+ *             so they never add to a score.
+ *
+ *
+ * Arg:        query [READ ] query data structure [ComplexSequence*]
+ * Arg:         comp [READ ] Resource [CompMat*]
+ * Arg:          gap [READ ] Resource [int]
+ * Arg:          ext [READ ] Resource [int]
+ *
+ * Return [UNKN ]  profile, NULL if out of memory [ProteinSW_Striped *]
+ *
+ */
+ProteinSW_Striped * new_ProteinSW_Striped(ComplexSequence* query,CompMat* comp,int gap,int ext)
+{
+    ProteinSW_Striped * out;
+#ifdef SWSTRIPED_SSE2
+    int len = query->seq->len;
+    int lo = 0;
+    int hi = 0;
+    int lanes;
+    int seg;
+    int r;
+    int i;
+    int k;
+    int s;
+#endif
+
+    if((out=(ProteinSW_Striped *) ckcalloc(1,sizeof(ProteinSW_Striped))) == NULL)  {
+      warn("new_ProteinSW_Striped failed ");
+      return NULL;
+      }
+    out->dynamite_hard_link = 1;
+    out->query = query;
+    out->comp = comp;
+    out->gap = gap;
+    out->ext = ext;
+
+#ifdef SWSTRIPED_SSE2
+    if( len <= 0 || gap > 0 || ext > 0 )
+      return out;
+    for(i=0;i<len;i++)   {
+      if( query->data[i] < 0 || query->data[i] >= SWSTRIPED_ALPHABET )
+        return out;
+      for(r=0;r<SWSTRIPED_ALPHABET;r++)  {
+        s = CompMat_AAMATCH(comp,query->data[i],r);
+        if( s < lo ) lo = s;
+        if( s > hi ) hi = s;
+        }
+      }
+    if( lo <= SHRT_MIN || hi >= SHRT_MAX )
+      return out;
+
+    lanes = striped_lanes();
+    out->len = len;
+    out->hi = hi;
+    out->bias = -lo;
+    out->gapo8 = -gap < 255 ? -gap : 255;
+    out->gape8 = -ext < 255 ? -ext : 255;
+    out->gapo16 = -gap < SHRT_MAX ? -gap : SHRT_MAX;
+    out->gape16 = -ext < SHRT_MAX ? -ext : SHRT_MAX;
+
+    /* 8-bit profile, padded with the lowest score */
+    if( hi - lo <= 255 ) {
+      seg = out->seg8 = (len + lanes - 1)/lanes;
+      if( (out->p8 = (unsigned char *) striped_alloc((size_t) SWSTRIPED_ALPHABET*seg*lanes)) == NULL )
+        return free_ProteinSW_Striped(out);
+      for(r=0;r<SWSTRIPED_ALPHABET;r++)
+        for(i=0;i<seg;i++)
+          for(k=0;k<lanes;k++)
+            out->p8[(r*seg + i)*lanes + k] = k*seg + i < len ? CompMat_AAMATCH(comp,query->data[k*seg + i],r) + out->bias : 0;
+      }
+
+    /* 16-bit profile, with half as many elements to a vector */
+    seg = out->seg16 = (len + lanes/2 - 1)/(lanes/2);
+    if( (out->p16 = (short *) striped_alloc((size_t) SWSTRIPED_ALPHABET*seg*lanes)) == NULL )
+      return free_ProteinSW_Striped(out);
+    for(r=0;r<SWSTRIPED_ALPHABET;r++)
+      for(i=0;i<seg;i++)
+        for(k=0;k<lanes/2;k++)
+          out->p16[(r*seg + i)*(lanes/2) + k] = k*seg + i < len ? CompMat_AAMATCH(comp,query->data[k*seg + i],r) : SHRT_MIN;
+
+    /* room for the four rows of the 16-bit kernel, the longer ones */
+    if( (out->scratch = striped_alloc((size_t) 4*seg*lanes)) == NULL )
+      return free_ProteinSW_Striped(out);
+    out->lanes = lanes;
+#endif
+
+    return out;
+}
+
+/* Function:  score_only_striped_ProteinSW(st,mat,target,cutoff)
+ *
+ * Descrip:    Returns the same score as /score_only_ProteinSW
+ *             for the query of st against target, or some score
+ *             below cutoff if the exact one is below it too
+ *
+ *
+ * Arg:            st [RW   ] striped query profile [ProteinSW_Striped *]
+ * Arg:           mat [RW   ] scoring memory for /score_only_reuse_ProteinSW [ProteinSW *]
+ * Arg:        target [READ ] target data structure [ComplexSequence*]
+ * Arg:        cutoff [READ ] lowest score that has to be exact, 0 for all [int]
+ *
+ * Return [UNKN ]  Undocumented return value [int]
+ *
+ */
+int score_only_striped_ProteinSW(ProteinSW_Striped * st,ProteinSW * mat,ComplexSequence* target,int cutoff)
+{
+#ifdef SWSTRIPED_SSE2
+    int * B = target->data;
+    int N = target->seq->len;
+    int score = -1;
+    int j;
+
+    if( st->lanes != 0 && N > 0 )    {
+      /* too short to reach cutoff at all */
+      if( cutoff > 0 && st->hi * (N < st->len ? N : st->len) < cutoff )
+        return 0;
+      for(j=0;j<N;j++)
+        if( B[j] < 0 || B[j] >= SWSTRIPED_ALPHABET )
+          break;
+      if( j == N )   {
+#ifdef SWSTRIPED_AVX2
+        if( st->lanes == 32 )  {
+          if( st->p8 != NULL )
+            score = striped_avx2_8(st,B,N,cutoff);
+          if( score < 0 )
+            score = striped_avx2_16(st,B,N,cutoff);
+          }
+        else
+#endif
+          {
+          if( st->p8 != NULL )
+            score = striped_sse2_8(st,B,N,cutoff);
+          if( score < 0 )
+            score = striped_sse2_16(st,B,N,cutoff);
+          }
+        /* a score of 0 is only exact enough when it is below cutoff */
+        if( score > 0 || (score == 0 && cutoff > 0) )
+          return score;
+        }
+      }
+#endif
+
+    if( mat != NULL )
+      return score_only_reuse_ProteinSW(mat,st->query,target,st->comp,st->gap,st->ext,cutoff);
+    return score_only_ProteinSW(st->query,target,st->comp,st->gap,st->ext);
+}
+
+/* Function:  free_ProteinSW_Striped(obj)
+ *
+ * Descrip:    Free Function: removes the memory held by obj
+ *
+ *
+ * Arg:        obj [UNKN ] Object that is free'd [ProteinSW_Striped *]
+ *
+ * Return [UNKN ]  Undocumented return value [ProteinSW_Striped *]
+ *
+ */
+ProteinSW_Striped * free_ProteinSW_Striped(ProteinSW_Striped * obj)
+{
+
+    if( obj == NULL) {
+      warn("Attempting to free a NULL pointer to a ProteinSW_Striped obj. Should be trappable");
+      return NULL;
+      }
+
+    if( obj->dynamite_hard_link > 1)     {
+      obj->dynamite_hard_link--;
+      return NULL;
+      }
+    /* obj->query is linked in */
+    /* obj->comp is linked in */
+    free(obj->p8);
+    free(obj->p16);
+    free(obj->scratch);
+
+    ckfree(obj);
+    return NULL;
+}
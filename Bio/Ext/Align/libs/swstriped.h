@@ -0,0 +1,118 @@
+#ifndef DYNAMITEswstripedHEADERFILE
+#define DYNAMITEswstripedHEADERFILE
+#ifdef _cplusplus
+extern "C" {
+#endif
+#include "proteinsw.h"
+
+struct bp_sw_ProteinSW_Striped {
+    int dynamite_hard_link;
+    ComplexSequence* query;
+    CompMat* comp;
+    int gap;
+    int ext;
+    int len;
+    int hi;     /*  best CompMat score of a query residue, at least 0 */
+    int lanes;  /*  bytes in a vector, 16 for SSE2, 32 for AVX2, 0 if no kernel can be used */
+    int bias;   /*  added to the 8-bit scores so that none is negative */
+    int gapo8;
+    int gape8;
+    int gapo16;
+    int gape16;
+    int seg8;   /*  vectors per residue row of p8 */
+    int seg16;  /*  vectors per residue row of p16 */
+    unsigned char * p8; /*  biased 8-bit profile, NULL if it doesn't fit */
+    short * p16;    /*  16-bit profile, NULL if it doesn't fit */
+    void * scratch; /*  score rows of the kernels */
+    } ;
+/* ProteinSW_Striped defined */
+#ifndef DYNAMITE_DEFINED_ProteinSW_Striped
+typedef struct bp_sw_ProteinSW_Striped bp_sw_ProteinSW_Striped;
+#define ProteinSW_Striped bp_sw_ProteinSW_Striped
+#define DYNAMITE_DEFINED_ProteinSW_Striped
+#endif
+
+
+
+
+    /***************************************************/
+    /* Callable functions                              */
+    /* These are the functions you are expected to use */
+    /***************************************************/
+
+
+
+/* Function:  new_ProteinSW_Striped(query,comp,gap,ext)
+ *
+ * Descrip:    Makes the striped query profile used by
+ *             /score_only_striped_ProteinSW to score query
+ *             against many targets with the SSE2 or AVX2 kernel,
+ *             whichever is the best this CPU runs.
+ *
+ *             If no kernel can be used, because of the scores
+ *             of comp, positive gap penalties or a build without
+ *             them, the profile only remembers its arguments and
+ *             every score is worked out by /score_only_ProteinSW.
+ *
+ *             The profile holds the score rows of the kernels,
+ *             so it must not be used by two threads at once.
+ *
+ *
+ * Arg:        query [READ ] query data structure [ComplexSequence*]
+ * Arg:         comp [READ ] Resource [CompMat*]
+ * Arg:          gap [READ ] Resource [int]
+ * Arg:          ext [READ ] Resource [int]
+ *
+ * Return [UNKN ]  profile, NULL if out of memory [ProteinSW_Striped *]
+ *
+ */
+ProteinSW_Striped * bp_sw_new_ProteinSW_Striped(ComplexSequence* query,CompMat* comp,int gap,int ext);
+#define new_ProteinSW_Striped bp_sw_new_ProteinSW_Striped
+
+
+/* Function:  score_only_striped_ProteinSW(st,mat,target,cutoff)
+ *
+ * Descrip:    Returns the same score as /score_only_ProteinSW
+ *             for the query of st against target, with the
+ *             striped kernels where they can be used.
+ *
+ *             Scores that saturate the 8-bit kernel are redone
+ *             with the 16-bit one, and scores that saturate that,
+ *             or that aren't positive, are redone in the usual
+ *             way in mat, which may be NULL.
+ *
+ *             If cutoff is above 0, a target is given up as soon
+ *             as it can't reach cutoff, as /score_only_reuse_ProteinSW
+ *             does, and some score below cutoff is returned.
+ *
+ *
+ * Arg:            st [RW   ] striped query profile [ProteinSW_Striped *]
+ * Arg:           mat [RW   ] scoring memory for /score_only_reuse_ProteinSW [ProteinSW *]
+ * Arg:        target [READ ] target data structure [ComplexSequence*]
+ * Arg:        cutoff [READ ] lowest score that has to be exact, 0 for all [int]
+ *
+ * Return [UNKN ]  Undocumented return value [int]
+ *
+ */
+int bp_sw_score_only_striped_ProteinSW(ProteinSW_Striped * st,ProteinSW * mat,ComplexSequence* target,int cutoff);
+#define score_only_striped_ProteinSW bp_sw_score_only_striped_ProteinSW
+
+
+/* Function:  free_ProteinSW_Striped(obj)
+ *
+ * Descrip:    Free Function: removes the memory held by obj
+ *
+ *
+ * Arg:        obj [UNKN ] Object that is free'd [ProteinSW_Striped *]
+ *
+ * Return [UNKN ]  Undocumented return value [ProteinSW_Striped *]
+ *
+ */
+ProteinSW_Striped * bp_sw_free_ProteinSW_Striped(ProteinSW_Striped * obj);
+#define free_ProteinSW_Striped bp_sw_free_ProteinSW_Striped
+
+#ifdef _cplusplus
+}
+#endif
+
+#endif
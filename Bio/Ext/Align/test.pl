@@ -11,7 +11,7 @@ BEGIN {
         die "Tests require Test::More";
     }
     use Test::More;
-    plan tests => 20;
+    plan tests => 63;
     use_ok('Bio::Ext::Align');
     use_ok('Bio::Tools::dpAlign');
     use_ok('Bio::Seq');
@@ -25,6 +25,9 @@ $seq1 = &Bio::Ext::Align::new_Sequence_from_strings("one","WLGQRNLVSSTGGNLLNVWLK
 isa_ok($seq1,'Bio::Ext::Align::Sequence');
 $seq2 = &Bio::Ext::Align::new_Sequence_from_strings("two","WMGNRNVVNLLNVWFRDW");
 isa_ok($seq2,'Bio::Ext::Align::Sequence');
+my $pdb = &Bio::Ext::Align::load_ProteinDB(
+	      &Bio::Ext::Align::new_ProteinDB_from_single_seq($seq1));
+isa_ok($pdb,'Bio::Ext::Align::ProteinDB');
 
 $alb = &Bio::Ext::Align::Align_Sequences_ProteinSmithWaterman($seq1,$seq2,
 							      $cm,-12,-2);
@@ -32,6 +35,95 @@ $alb = &Bio::Ext::Align::Align_Sequences_ProteinSmithWaterman($seq1,$seq2,
 					 $seq1->seq,$seq2->name,
 					 $seq2->seq,15,50,STDERR) if $DEBUG;
 
+# the matrix filled by several threads gives the same alignment
+sub alb_columns {
+    my ($alb) = @_;
+    my @col;
+    for (my $alc = $alb->start; ; $alc = $alc->next) {
+	push @col, join(",", map { my $alu = $alc->alu($_);
+				   join(":", $alu->text_label, $alu->start, $alu->end) } 0, 1);
+	last if $alc->at_end;
+    }
+    return join(" ", @col);
+}
+my $long1 = &Bio::Ext::Align::new_Sequence_from_strings("long1", "WLGQRNLVSSTGGNLLNVWLKDW" x 12);
+my $long2 = &Bio::Ext::Align::new_Sequence_from_strings("long2", "WMGNRNVVNLLNVWFRDW" x 15);
+is(alb_columns(&Bio::Ext::Align::Align_Sequences_ProteinSmithWaterman($long1,$long2,$cm,-12,-2,3)),
+   alb_columns(&Bio::Ext::Align::Align_Sequences_ProteinSmithWaterman($long1,$long2,$cm,-12,-2)));
+
+# threaded and batched searches score the pairs as the plain one does
+sub search_scores {
+    my ($search, $targetdb, @args) = @_;
+    my $hs = Bio::Ext::Align::Hscore::level_score_Hscore(0, -1);
+    $search->($hs, &Bio::Ext::Align::single_fasta_ProteinDB('search.fa'),
+	      $targetdb || &Bio::Ext::Align::single_fasta_ProteinDB('search.fa'), $cm, -12, -2, @args);
+    return [ map { my $ds = $hs->datascore($_);
+		   [$ds->query->name, $ds->target->name, $hs->score($_)] } 0 .. $hs->length - 1 ];
+}
+open(my $sfa, '>', 'search.fa') || die "Can't open file:$!";
+print $sfa ">two\n", $seq2->seq, "\n>one\n", $seq1->seq, "\n>long2\n", $long2->seq,
+    "\n>short\nNLLNV\n>other\nMKTAYIAKQRQISFVKSHFSRQ\n";
+close $sfa;
+my $plain = search_scores(\&Bio::Ext::Align::search_ProteinSW);
+is(scalar @$plain, 25);
+is_deeply(search_scores(\&Bio::Ext::Align::thread_search_ProteinSW, undef, 3), $plain);
+is_deeply(search_scores(\&Bio::Ext::Align::batch_search_ProteinSW, undef, 2), $plain);
+# and so do searches of the targets loaded into memory
+my $loadeddb = &Bio::Ext::Align::load_ProteinDB(&Bio::Ext::Align::single_fasta_ProteinDB('search.fa'));
+is_deeply(search_scores(\&Bio::Ext::Align::search_ProteinSW, $loadeddb), $plain);
+is_deeply(search_scores(\&Bio::Ext::Align::thread_search_ProteinSW, $loadeddb, 3), $plain);
+# a search into a Hscore with a cutoff stores just the scores reaching it
+sub cutoff_scores {
+    my ($cutoff) = @_;
+    my $hs = Bio::Ext::Align::Hscore::level_score_Hscore($cutoff, -1);
+    &Bio::Ext::Align::search_ProteinSW($hs, &Bio::Ext::Align::single_fasta_ProteinDB('search.fa'),
+				       &Bio::Ext::Align::single_fasta_ProteinDB('search.fa'), $cm, -12, -2);
+    return [ map { my $ds = $hs->datascore($_);
+		   [$ds->query->name, $ds->target->name, $hs->score($_)] } 0 .. $hs->length - 1 ];
+}
+is_deeply(cutoff_scores(60), [ grep { $_->[2] >= 60 } @$plain ]);
+unlink('search.fa');
+
+# the striped kernels score as the plain ProteinSW does, also past
+# the 8 and 16 bit scores a self comparison of 3000 residues saturates
+my $cses = &Bio::Ext::Align::default_aminoacid_ComplexSequenceEvalSet();
+my $swmat = Bio::Ext::Align::ProteinSW->new;
+sub random_protein {
+    return join("", map { substr("ACDEFGHIKLMNPQRSTVWY", int(rand(20)), 1) } 1 .. $_[0]);
+}
+srand(22);
+my @pairs = map { [random_protein(1 + int(rand(300))), random_protein(1 + int(rand(300)))] } 1 .. 30;
+push @pairs, ["W" x 3000, "W" x 3000];
+my (@striped, @scalar);
+for my $pair (@pairs) {
+    my ($q, $t) = map { &Bio::Ext::Align::new_ComplexSequence(
+			    &Bio::Ext::Align::new_Sequence_from_strings("cs", $_), $cses) } @$pair;
+    for my $gaps ([-12, -2], [-10, -1], [-1, -1], [0, 0], [-30, -8]) {
+	my $st = &Bio::Ext::Align::new_ProteinSW_Striped($q, $cm, @$gaps);
+	push @striped, &Bio::Ext::Align::score_only_striped_ProteinSW($st, $swmat, $t);
+	push @scalar, &Bio::Ext::Align::score_only_ProteinSW($q, $t, $cm, @$gaps);
+    }
+}
+ok($scalar[-1] > 32767);
+is_deeply(\@striped, \@scalar);
+
+# with a cutoff, scores reaching it are exact and the others stay below it
+my @wrong;
+for my $pair (@pairs[0 .. 9]) {
+    my ($q, $t) = map { &Bio::Ext::Align::new_ComplexSequence(
+			    &Bio::Ext::Align::new_Sequence_from_strings("cs", $_), $cses) } @$pair;
+    my $st = &Bio::Ext::Align::new_ProteinSW_Striped($q, $cm, -12, -2);
+    my $true = &Bio::Ext::Align::score_only_ProteinSW($q, $t, $cm, -12, -2);
+    for my $cutoff ($true - 1, $true, $true + 1, 1 + int(rand(2 * $true + 2))) {
+	for my $got (&Bio::Ext::Align::score_only_reuse_ProteinSW($swmat, $q, $t, $cm, -12, -2, $cutoff),
+		     &Bio::Ext::Align::score_only_striped_ProteinSW($st, $swmat, $t, $cutoff)) {
+	    push @wrong, "$true cutoff $cutoff got $got"
+		unless $true >= $cutoff ? $got == $true : $got < $cutoff;
+	}
+    }
+}
+is_deeply(\@wrong, []);
+
 warn( "Testing Local Alignment case...\n") if $DEBUG;
 
 $alnout = Bio::AlignIO->new(-format => 'pfam', -fh => \*STDERR);
@@ -90,6 +182,103 @@ $factory->align_and_show($s1, $s2) if $DEBUG;
 warn(sprintf "Optimal Alignment Score = %d\n", $aln->score) if $DEBUG;
 ok(1);
 
+# banded global alignment gives the same optimal score
+is(Bio::Ext::Align::Align_DNA_Sequences("AATGCCATTGACGG", "CAGCCTCGCTTAG",
+					3, -1, 3, 1, 4)->score,
+   Bio::Ext::Align::Align_DNA_Sequences("AATGCCATTGACGG", "CAGCCTCGCTTAG",
+					3, -1, 3, 1, 2)->score);
+# also on sequences long enough for the band, one with scattered short
+# indels and one with a shift of 40 bases, which the band has to double
+# to take in
+sub random_dna {
+    return join("", map { substr("ACGT", int(rand(4)), 1) } 1 .. $_[0]);
+}
+srand(3);
+my $bandseq = random_dna(1500);
+my $scattered = $bandseq;
+for my $pos (map { 100 * $_ } reverse 1 .. 14) {
+    if ($pos % 200) {
+	substr($scattered, $pos, 1 + $pos % 3) = "";
+    } else {
+	substr($scattered, $pos, 0) = random_dna(1 + $pos % 3);
+    }
+}
+my $shifted = substr($bandseq, 0, 300) . substr($bandseq, 340, 900) . random_dna(40)
+    . substr($bandseq, 1240);
+for my $other ($scattered, $shifted) {
+    my $banded = Bio::Ext::Align::Align_DNA_Sequences($bandseq, $other, 3, -1, 3, 1, 4);
+    my $full = Bio::Ext::Align::Align_DNA_Sequences($bandseq, $other, 3, -1, 3, 1, 2);
+    is_deeply([$banded->score, $banded->aln1, $banded->aln2],
+	      [$full->score, $full->aln1, $full->aln2]);
+}
+
+# X-drop extension of a seed finds the local alignment unless X is too small
+my $xd = Bio::Ext::Align::XDrop_DNA_Sequences("AATGCCATTGACGG", "CAGCCTCGCTTAG",
+					      4, 3, 3, -1, 3, 1, 100);
+is_deeply([$xd->score, $xd->aln1, $xd->aln2], [10, "GCCATTG", "GCC-TCG"]);
+$xd = Bio::Ext::Align::XDrop_DNA_Sequences("AATGCCATTGACGG", "CAGCCTCGCTTAG",
+					   4, 3, 3, -1, 3, 1, 2);
+is_deeply([$xd->score, $xd->aln1, $xd->aln2], [9, "GCC", "GCC"]);
+
+# unit cost alignment of a primer anywhere in a read
+my $ed = Bio::Ext::Align::Align_DNA_Sequences("ACGTTGCA", "GGGACGTAGCATTT", 0, 0, 0, 0, 6);
+is_deeply([$ed->score, $ed->aln2, $ed->start2, $ed->end2], [-1, "ACGTAGCA", 4, 11]);
+
+# the threaded alignment is the same as the serial one
+my ($a1, $a2) = ("ACGT" x 600, "ACGGT" x 500);
+my $serial = Bio::Ext::Align::Align_DNA_Sequences($a1, $a2, 3, -1, 3, 1, 2);
+Bio::Ext::Align::set_threads(2);
+my $threaded = Bio::Ext::Align::Align_DNA_Sequences($a1, $a2, 3, -1, 3, 1, 2);
+Bio::Ext::Align::set_threads(1);
+is($threaded->aln1 . $threaded->aln2, $serial->aln1 . $serial->aln2);
+$threaded = Bio::Ext::Align::Align_DNA_Sequences($a1, $a2, 3, -1, 3, 1, 2, 2);
+is($threaded->aln1 . $threaded->aln2, $serial->aln1 . $serial->aln2);
+
+# dividing small problems all the way down scores the same as filling them
+Bio::Ext::Align::set_quadratic_cells(0);
+my $divided = Bio::Ext::Align::Align_DNA_Sequences($a1, $a2, 3, -1, 3, 1, 2);
+Bio::Ext::Align::set_quadratic_cells(1 << 20);
+is($divided->score, $serial->score);
+
+# a matrix of our own scores the same as the built in one
+my $own = Bio::Ext::Align::ScoringMatrix->new("ACGT", 3, 1);
+for my $r (qw(A C G T)) {
+    for my $c (qw(A C G T)) {
+	Bio::Ext::Align::ScoringMatrix->set_entry($own, $r, $c, $r eq $c ? 3 : -1);
+    }
+}
+is(Bio::Ext::Align::Align_Protein_Sequences("AATGCCATTGACGG", "CAGCCTCGCTTAG", $own, 2)->score,
+   Bio::Ext::Align::Align_DNA_Sequences("AATGCCATTGACGG", "CAGCCTCGCTTAG", 3, -1, 3, 1, 2)->score);
+
+# sequences encoded once align as the strings do, which are left alone
+my $lower = "aatgccattgacgg";
+my $enc = Bio::Ext::Align::EncodedSequence->dna_new($lower);
+my $raw = Bio::Ext::Align::Align_DNA_Sequences($lower, "CAGCCTCGCTTAG", 3, -1, 3, 1, 1);
+is($lower, "aatgccattgacgg");
+is(Bio::Ext::Align::Align_DNA_Sequences($enc, "CAGCCTCGCTTAG", 3, -1, 3, 1, 1)->aln1, $raw->aln1);
+
+# a batch of pairs aligns as the pairs do one by one, threaded or not
+my $bws = Bio::Ext::Align::Workspace->new;
+$bws->set_output(3);
+my $one = Bio::Ext::Align::Align_DNA_Sequences($a1, $a2, 3, -1, 3, 1, 1, 1, $bws);
+my $batch = Bio::Ext::Align::Align_DNA_Sequences_batch([[$enc, "CAGCCTCGCTTAG"], [$a1, $a2]],
+						    3, -1, 3, 1, 1, 2, 3);
+is_deeply([$batch->{score}, $batch->{aln1}[0], $batch->{cigar}[1]],
+	  [[$raw->score, $one->score], $raw->aln1, $one->cigar]);
+eval { Bio::Ext::Align::Align_DNA_Sequences_batch([[$a1, $a2], ["", $a2]], 3, -1, 3, 1, 1) };
+like($@, qr/Pair 1 of the batch has an empty sequence/);
+
+# a submitted job aligns in the background as the call would
+my $job = Bio::Ext::Align::Submit_DNA_Sequences($a1, $a2, 3, -1, 3, 1, 1, 3);
+$job->wait;
+ok($job->ready);
+is($job->result->cigar, $one->cigar);
+eval { Bio::Ext::Align::Submit_DNA_Sequences("", $a2, 3, -1, 3, 1, 1)->wait };
+like($@, qr/Can't submit an empty sequence/);
+
+# no pair of residues scores above zero, so the local alignment is empty
+is(Bio::Ext::Align::Align_Protein_Sequences("D", "AGYAYRLH", undef, 1)->aln1, "");
+
 warn( "Testing Ends-Free Alignment case...\n") if $DEBUG;
 
 $factory = Bio::Tools::dpAlign->new('-alg' => Bio::Tools::dpAlign::DPALIGN_ENDSFREE_MILLER_MYERS);
@@ -111,6 +300,10 @@ $factory->align_and_show($s1, $s2) if $DEBUG;
 warn(sprintf "Optimal Alignment Score = %d\n", $aln->score) if $DEBUG;
 ok(1);
 
+# the ends-free alignment is optimal
+is(Bio::Ext::Align::Align_Protein_Sequences("ILPEVIKFLKQYCRFFFCWDLKQSADV", "MNMHNY",
+					    undef, 3)->score, 4);
+
 warn( "Testing IUPAC DNA support...\n") if $DEBUG;
 
 $s1 = Bio::Seq->new(-id => "one", -seq => "WGRNVSSTGGNNVWKDW", 
@@ -133,6 +326,69 @@ $prof = $factory->sequence_profile($s1);
 warn(sprintf "Optimal Alignment Score = %d\n", $factory->pairwise_alignment_score($prof, $s2)) if $DEBUG;
 
 is($factory->pairwise_alignment_score($prof,$s2),77);
+# the profile must survive being scored against
+is($factory->pairwise_alignment_score($prof,$s2),77);
+is_deeply([Bio::Ext::Align::Score_Protein_Sequences_batch($prof, [$s2->seq, $s1->seq])], [77, 131]);
+# and a protein profile can't be scored as DNA
+eval { Bio::Ext::Align::Score_DNA_Sequences_batch($prof, [$s2->seq]) };
+like($@, qr/Score_DNA_Sequences_batch needs a DNA profile/);
+
+open(my $fa, '>', 'scan.fa') || die "Can't open file:$!";
+print $fa ">two\n", $s2->seq, "\n>one first\n", substr($s1->seq, 0, 10), "\n",
+    substr($s1->seq, 10), "\n";
+close $fa;
+is_deeply([Bio::Ext::Align::Scan_Fasta($prof, 'scan.fa', 5, 2)],
+	  [['one', 131], ['two', 77]]);
+# more hits than a worker's heap starts with room for
+my @scanseqs = map { substr($s1->seq x 3, $_ % 23, 10 + $_ % 37) } 0..149;
+open($fa, '>', 'scan.fa') || die "Can't open file:$!";
+print $fa map { ">s$_\n$scanseqs[$_]\n" } 0..$#scanseqs;
+close $fa;
+my @scanscores = Bio::Ext::Align::Score_Protein_Sequences_batch($prof, \@scanseqs);
+my @scanbest = (sort { $b->[1] <=> $a->[1] || substr($a->[0], 1) <=> substr($b->[0], 1) }
+		map { ["s$_", $scanscores[$_]] } 0..$#scanseqs)[0..99];
+is_deeply([Bio::Ext::Align::Scan_Fasta($prof, 'scan.fa', 100, 2)], \@scanbest);
+unlink('scan.fa');
+
+# a saved profile maps back in and scores the same
+$prof->save('profile.bin');
+my $loaded = Bio::Ext::Align::SequenceProfile->load('profile.bin');
+is(Bio::Ext::Align::Score_Protein_Sequences($loaded, $s2->seq), 77);
+# but not one whose alphabet or type is out of range
+open(my $pf, '<:raw', 'profile.bin') || die "Can't open file:$!";
+my $saved = do { local $/; <$pf> };
+close $pf;
+for my $bad ([36 + 4*ord('W'), 24], [16, 3]) {
+    my $corrupt = $saved;
+    substr($corrupt, $bad->[0], 4) = pack("i", $bad->[1]);
+    open($pf, '>:raw', 'profile.bin') || die "Can't open file:$!";
+    print $pf $corrupt;
+    close $pf;
+    eval { Bio::Ext::Align::SequenceProfile->load('profile.bin') };
+    like($@, qr/Can't load sequence profile/);
+}
+my $dnaprof = Bio::Ext::Align::SequenceProfile->dna_new("AATGCCATTGACGG", 3, -1, 3, 1);
+$dnaprof->save('profile.bin');
+is(Bio::Ext::Align::Score_DNA_Sequences(Bio::Ext::Align::SequenceProfile->load('profile.bin'),
+					"CAGCCTCGCTTAG"),
+   Bio::Ext::Align::Score_DNA_Sequences($dnaprof, "CAGCCTCGCTTAG"));
+unlink('profile.bin');
+
+# CIGAR and statistics instead of the gapped strings
+my $cigws = Bio::Ext::Align::Workspace->new;
+$cigws->set_output(2);
+my $cig = Bio::Ext::Align::Align_DNA_Sequences("AATGCCATTGACGG", "CAGCCTCGCTTAG",
+					       3, -1, 3, 1, 2, 1, $cigws);
+is($cig->cigar, "2M1I3M1I3M1D4M");
+is_deeply([$cig->aln1, $cig->matches, $cig->mismatches, $cig->gap_opens, $cig->gap_exts],
+	  [undef, 7, 5, 3, 3]);
+
+# a workspace reused across calls changes nothing
+my $ws = Bio::Ext::Align::Workspace->new;
+is(Bio::Ext::Align::Score_Protein_Sequences($prof, $s2->seq, $ws), 77);
+my $wsaln = Bio::Ext::Align::Align_DNA_Sequences($a1, $a2, 3, -1, 3, 1, 2, 1, $ws);
+$wsaln = Bio::Ext::Align::Align_DNA_Sequences($a1, $a2, 3, -1, 3, 1, 2, 1, $ws);
+is($wsaln->aln1 . $wsaln->aln2, $serial->aln1 . $serial->aln2);
 
 open(my $list, '<', 'scores.lst') || die "Can't open file:$!";
 